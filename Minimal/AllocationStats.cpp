@@ -0,0 +1,96 @@
+#include "AllocationStats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+static std::atomic<bool> counting(false);
+static std::atomic<uint64_t> allocations(0), allocatedBytes(0);
+static std::atomic<uint64_t> liveBytes(0), peakBytes(0);
+
+void countAllocations(bool on)
+{
+	counting.store(on, std::memory_order_relaxed);
+}
+
+void resetPeakBytes()
+{
+	peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+AllocationStats allocationStats()
+{
+	AllocationStats stats;
+	stats.count = allocations.load(std::memory_order_relaxed);
+	stats.bytes = allocatedBytes.load(std::memory_order_relaxed);
+	stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = peakBytes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+// The heap's own size of each block, so a free takes off what its allocation added
+static void track(void* memory)
+{
+	uint64_t live = liveBytes.fetch_add(_msize(memory), std::memory_order_relaxed) + _msize(memory);
+	if (!counting.load(std::memory_order_relaxed))
+		return;
+	uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+static void untrack(void* memory)
+{
+	if (memory)
+		liveBytes.fetch_sub(_msize(memory), std::memory_order_relaxed);
+}
+
+// The global operator new and delete, replaced so every allocation in the program can be
+// counted. Beyond the count they do what the library's do.
+void* operator new(size_t size)
+{
+	if (counting.load(std::memory_order_relaxed)) {
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+	if (size == 0)
+		size = 1;
+	void* memory;
+	while (!(memory = malloc(size))) {
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+	track(memory);
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	untrack(memory);
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	untrack(memory);
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	untrack(memory);
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	untrack(memory);
+	free(memory);
+}
\ No newline at end of file
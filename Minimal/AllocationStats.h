@@ -0,0 +1,20 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+
+// Heap allocations made through operator new, for the benchmarks. Counting is off unless
+// turned on, and then costs two relaxed atomic adds an allocation. The bytes live are kept
+// always, so frees of what was allocated before counting began balance out.
+struct AllocationStats {
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+	// Bytes allocated and not yet freed, and the most there were since resetPeakBytes
+	uint64_t liveBytes = 0;
+	uint64_t peakBytes = 0;
+};
+
+void countAllocations(bool on);
+// Starts the peak over from the bytes live now; it only rises while counting is on
+void resetPeakBytes();
+// Totals since counting was first turned on
+AllocationStats allocationStats();
\ No newline at end of file
@@ -0,0 +1,316 @@
+#define NOMINMAX
+#include <Windows.h>
+
+#include "AssetArchive.h"
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <thread>
+
+const uint32_t AssetArchive::MAGIC;
+const uint32_t AssetArchive::VERSION;
+const uint64_t AssetArchive::ALIGNMENT;
+const size_t AssetArchive::BLOCK_SIZE;
+const AssetArchive* AssetArchive::current = nullptr;
+
+// Reads of at least this many blocks are split over threads
+static const size_t PARALLEL_BLOCKS = 8;
+
+// At the start of the file, padded out to ALIGNMENT
+struct ArchiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t reserved;
+	uint64_t tocOffset;
+	uint64_t tocSize;
+};
+
+// Table of contents, per entry: name length, name, offset, size, compressed flag, block
+// count, then the stored size of each block
+template <typename T> static void append(vector<char>& out, const T& value)
+{
+	const char* bytes = (const char*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+AssetArchive::~AssetArchive()
+{
+	this->close();
+}
+
+bool AssetArchive::open(const string& path)
+{
+	this->close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	this->file = file;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(this->file, &size) || size.QuadPart < (long long)sizeof(ArchiveHeader)) {
+		this->close();
+		return false;
+	}
+	this->viewSize = (uint64_t)size.QuadPart;
+	this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (this->mapping)
+		this->view = (const char*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!this->view) {
+		cout << "Could not map " << path << endl;
+		this->close();
+		return false;
+	}
+
+	ArchiveHeader header;
+	memcpy(&header, this->view, sizeof(header));
+	if (header.magic != MAGIC || header.version != VERSION || header.tocOffset > this->viewSize || header.tocSize > this->viewSize - header.tocOffset) {
+		cout << path << " is not an asset archive of this version, cook it again" << endl;
+		this->close();
+		return false;
+	}
+
+	// Every field is checked against the end of the table, so a truncated file fails here and not in a read
+	const char* cursor = this->view + header.tocOffset;
+	const char* end = cursor + header.tocSize;
+	auto take = [&cursor, end](void* value, size_t size) {
+		if ((size_t)(end - cursor) < size)
+			return false;
+		memcpy(value, cursor, size);
+		cursor += size;
+		return true;
+	};
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		Entry entry;
+		uint32_t nameLength, compressed, blockCount;
+		if (!take(&nameLength, sizeof(nameLength)) || (size_t)(end - cursor) < nameLength) {
+			this->close();
+			return false;
+		}
+		entry.name.assign(cursor, nameLength);
+		cursor += nameLength;
+		if (!take(&entry.offset, sizeof(entry.offset)) || !take(&entry.size, sizeof(entry.size))
+			|| !take(&compressed, sizeof(compressed)) || !take(&blockCount, sizeof(blockCount))) {
+			this->close();
+			return false;
+		}
+		entry.compressed = compressed != 0;
+		uint64_t stored = entry.size;
+		if (entry.compressed) {
+			entry.blocks.push_back(entry.offset);
+			for (uint32_t b = 0; b < blockCount; b++) {
+				uint32_t blockSize;
+				if (!take(&blockSize, sizeof(blockSize))) {
+					this->close();
+					return false;
+				}
+				entry.blocks.push_back(entry.blocks.back() + blockSize);
+			}
+			stored = entry.blocks.back() - entry.offset;
+		}
+		bool blocksMatch = !entry.compressed || blockCount == (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		if (!blocksMatch || entry.offset > this->viewSize || stored > this->viewSize - entry.offset) {
+			cout << path << " is damaged at " << entry.name << endl;
+			this->close();
+			return false;
+		}
+		this->order.push_back(entry.name);
+		this->entries[entry.name] = std::move(entry);
+	}
+	return true;
+}
+
+void AssetArchive::close()
+{
+	if (this->view)
+		UnmapViewOfFile(this->view);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	if (this->file)
+		CloseHandle(this->file);
+	this->view = nullptr;
+	this->mapping = nullptr;
+	this->file = nullptr;
+	this->viewSize = 0;
+	this->entries.clear();
+	this->order.clear();
+}
+
+const AssetArchive::Entry* AssetArchive::find(const string& name) const
+{
+	auto found = this->entries.find(name);
+	return found == this->entries.end() ? nullptr : &found->second;
+}
+
+bool AssetArchive::read(const Entry& entry, uint64_t offset, size_t size, char* destination) const
+{
+	if (offset > entry.size || size > entry.size - offset)
+		return false;
+	if (size == 0)
+		return true;
+	if (!entry.compressed) {
+		memcpy(destination, this->view + entry.offset + offset, size);
+		return true;
+	}
+
+	size_t first = (size_t)(offset / BLOCK_SIZE);
+	size_t last = (size_t)((offset + size + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	size_t threads = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), (last - first) / (PARALLEL_BLOCKS / 2));
+	if (last - first < PARALLEL_BLOCKS || threads < 2)
+		return this->readBlocks(entry, first, last, offset, size, destination);
+
+	// Blocks decompress independently, so each thread takes a run of them
+	vector<future<bool>> parts;
+	size_t per = (last - first + threads - 1) / threads;
+	for (size_t from = first; from < last; from += per) {
+		size_t to = std::min(last, from + per);
+		parts.push_back(std::async(std::launch::async, [=, &entry] {
+			return this->readBlocks(entry, from, to, offset, size, destination);
+		}));
+	}
+	bool ok = true;
+	for (future<bool>& part : parts)
+		ok = part.get() && ok;
+	return ok;
+}
+
+// The part of blocks [first, last) that falls in [offset, offset + size), at its place in destination
+bool AssetArchive::readBlocks(const Entry& entry, size_t first, size_t last, uint64_t offset, size_t size, char* destination) const
+{
+	vector<char> partial;
+	for (size_t b = first; b < last; b++) {
+		uint64_t blockStart = (uint64_t)b * BLOCK_SIZE;
+		size_t blockSize = (size_t)std::min((uint64_t)BLOCK_SIZE, entry.size - blockStart);
+		const char* stored = this->view + entry.blocks[b];
+		size_t storedSize = (size_t)(entry.blocks[b + 1] - entry.blocks[b]);
+		uint64_t from = std::max(offset, blockStart);
+		uint64_t to = std::min(offset + size, blockStart + blockSize);
+		char* target = destination + (from - offset);
+
+		if (storedSize == blockSize) {
+			memcpy(target, stored + (from - blockStart), (size_t)(to - from));
+		}
+		else if (from == blockStart && to == blockStart + blockSize) {
+			// The whole block is wanted, so it goes straight into place
+			if (!lz4Decompress(stored, storedSize, target, blockSize))
+				return false;
+		}
+		else {
+			partial.resize(blockSize);
+			if (!lz4Decompress(stored, storedSize, &partial[0], blockSize))
+				return false;
+			memcpy(target, &partial[(size_t)(from - blockStart)], (size_t)(to - from));
+		}
+	}
+	return true;
+}
+
+bool AssetArchive::read(const Entry& entry, string& contents) const
+{
+	contents.resize((size_t)entry.size);
+	return entry.size == 0 || this->read(entry, 0, (size_t)entry.size, &contents[0]);
+}
+
+void AssetArchive::prefetch(const vector<string>& names) const
+{
+	// PrefetchVirtualMemory is the Windows 8 madvise(WILLNEED); on 7 the reads page the file in as they go
+	struct Range {
+		PVOID address;
+		SIZE_T bytes;
+	};
+	typedef BOOL(WINAPI *PrefetchFunction)(HANDLE, ULONG_PTR, Range*, ULONG);
+	static PrefetchFunction prefetchVirtualMemory = (PrefetchFunction)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	if (!prefetchVirtualMemory || !this->view)
+		return;
+
+	vector<Range> ranges;
+	for (const string& name : names) {
+		const Entry* entry = this->find(name);
+		if (!entry)
+			continue;
+		uint64_t stored = entry->compressed ? entry->blocks.back() - entry->offset : entry->size;
+		if (stored == 0)
+			continue;
+		Range range = { (PVOID)(this->view + entry->offset), (SIZE_T)stored };
+		ranges.push_back(range);
+	}
+	if (!ranges.empty())
+		prefetchVirtualMemory(GetCurrentProcess(), ranges.size(), &ranges[0], 0);
+}
+
+void ArchiveWriter::add(const string& name, vector<char> blob)
+{
+	this->blobs.emplace_back(name, std::move(blob));
+}
+
+bool ArchiveWriter::addFile(const string& name, const string& path)
+{
+	ifstream file(path, ios::binary);
+	if (!file.is_open())
+		return false;
+	this->add(name, vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>()));
+	return true;
+}
+
+size_t ArchiveWriter::rawBytes() const
+{
+	size_t bytes = 0;
+	for (const auto& blob : this->blobs)
+		bytes += blob.second.size();
+	return bytes;
+}
+
+bool ArchiveWriter::write(const string& path, bool compress) const
+{
+	ofstream out(path, ios::binary | ios::trunc);
+	if (!out.is_open())
+		return false;
+	vector<char> padding(AssetArchive::ALIGNMENT, 0);
+	out.write(&padding[0], padding.size());
+
+	vector<char> toc;
+	vector<char> packed(lz4Bound(AssetArchive::BLOCK_SIZE));
+	for (const auto& blob : this->blobs) {
+		uint64_t offset = (uint64_t)out.tellp();
+		uint64_t aligned = (offset + AssetArchive::ALIGNMENT - 1) / AssetArchive::ALIGNMENT * AssetArchive::ALIGNMENT;
+		out.write(&padding[0], aligned - offset);
+
+		const vector<char>& data = blob.second;
+		vector<uint32_t> blockSizes;
+		if (compress) {
+			for (size_t start = 0; start < data.size(); start += AssetArchive::BLOCK_SIZE) {
+				size_t size = std::min(AssetArchive::BLOCK_SIZE, data.size() - start);
+				// Only kept when smaller, so a block of its raw size is always a raw one
+				size_t stored = lz4Compress(&data[start], size, &packed[0], size - 1);
+				if (stored)
+					out.write(&packed[0], stored);
+				else
+					out.write(&data[start], size);
+				blockSizes.push_back((uint32_t)(stored ? stored : size));
+			}
+		}
+		else if (!data.empty()) {
+			out.write(&data[0], data.size());
+		}
+
+		append(toc, (uint32_t)blob.first.size());
+		toc.insert(toc.end(), blob.first.begin(), blob.first.end());
+		append(toc, aligned);
+		append(toc, (uint64_t)data.size());
+		append(toc, (uint32_t)(compress ? 1 : 0));
+		append(toc, (uint32_t)blockSizes.size());
+		for (uint32_t size : blockSizes)
+			append(toc, size);
+	}
+
+	ArchiveHeader header = { AssetArchive::MAGIC, AssetArchive::VERSION, (uint32_t)this->blobs.size(), 0, (uint64_t)out.tellp(), toc.size() };
+	if (!toc.empty())
+		out.write(&toc[0], toc.size());
+	out.seekp(0);
+	out.write((const char*)&header, sizeof(header));
+	return (bool)out;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Every asset the game loads, cooked offline into one file: models as meshes in the layout
+// they are uploaded in, with their materials, and shader sources as text. A table of
+// contents at the end names each blob; blobs start on 4 KB boundaries and are cut into
+// 64 KB blocks, each LZ4 compressed or stored raw when that doesn't pay.
+//
+// At runtime the file is mapped once. Reads go straight from the mapping, decompressing
+// into the caller's memory (the vectors a mesh uploads from), spread over worker threads
+// for large ones. Mounted, Model and ReadShaderSource look every path up here first and
+// only go to loose files for what the archive doesn't have.
+class AssetArchive {
+public:
+	static const uint32_t MAGIC = 0x4b415043; // "CPAK"
+	// Bump whenever the header, the table of contents or a blob layout changes
+	static const uint32_t VERSION = 1;
+	static const uint64_t ALIGNMENT = 4096;
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	struct Entry {
+		string name;
+		// Where the blob starts in the file, and its size once decompressed
+		uint64_t offset;
+		uint64_t size;
+		bool compressed;
+		// For compressed blobs, where each block starts in the file and one past the last;
+		// a block is stored raw when it takes BLOCK_SIZE (or the rest of the blob)
+		vector<uint64_t> blocks;
+	};
+
+	AssetArchive() {}
+	~AssetArchive();
+	AssetArchive(const AssetArchive&) = delete;
+	AssetArchive& operator=(const AssetArchive&) = delete;
+
+	// Maps the archive and reads its table of contents. False if it is missing or from another version.
+	bool open(const string& path);
+	void close();
+	bool isOpen() const { return this->view != nullptr; }
+
+	const Entry* find(const string& name) const;
+	size_t count() const { return this->order.size(); }
+
+	// size bytes of the blob from offset on into destination. Thread safe.
+	bool read(const Entry& entry, uint64_t offset, size_t size, char* destination) const;
+	bool read(const Entry& entry, string& contents) const;
+
+	// Asks the OS to start paging in the named blobs, in the order given, before anyone
+	// reads them. Names the archive doesn't have are skipped.
+	void prefetch(const vector<string>& names) const;
+
+	// The archive Model and ReadShaderSource read from, or null for loose files only
+	static const AssetArchive* mounted() { return current; }
+	static void mount(const AssetArchive* archive) { current = archive; }
+
+private:
+	// Windows handles of the file and its mapping, kept as void* to leave Windows.h out of the header
+	void* file = nullptr;
+	void* mapping = nullptr;
+	const char* view = nullptr;
+	uint64_t viewSize = 0;
+	map<string, Entry> entries;
+	// Names in file order
+	vector<string> order;
+
+	static const AssetArchive* current;
+
+	bool readBlocks(const Entry& entry, size_t first, size_t last, uint64_t offset, size_t size, char* destination) const;
+};
+
+// Builds an archive, for the cooker. Blobs are laid out in the order they are added, which
+// should be the order the game loads them in so prefetching reads the file front to back.
+class ArchiveWriter {
+public:
+	void add(const string& name, vector<char> blob);
+	// Adds a loose file as is. False if it can't be read.
+	bool addFile(const string& name, const string& path);
+	bool write(const string& path, bool compress) const;
+
+	size_t count() const { return this->blobs.size(); }
+	size_t rawBytes() const;
+
+private:
+	vector<pair<string, vector<char>>> blobs;
+};
\ No newline at end of file
@@ -0,0 +1,208 @@
+#define NOMINMAX
+#include <Windows.h>
+
+#include "AssetBench.h"
+#include "AllocationStats.h"
+#include "AssetArchive.h"
+#include "GeometryPool.h"
+#include "Model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+
+// The sources each model is loaded from, and the archives cooked for them
+static const char* SOURCES[] = { "file", "archive", "archive-lz4" };
+static const char* ARCHIVES[] = { "", "asset-bench-raw.pak", "asset-bench-lz4.pak" };
+static const double MB = 1024.0 * 1024.0;
+
+static double median(vector<double> values)
+{
+	if (values.empty())
+		return -1.0;
+	sort(values.begin(), values.end());
+	return values[values.size() / 2];
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static uint64_t fileSize(const string& path)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	return file.is_open() ? (uint64_t)file.tellg() : 0;
+}
+
+bool writeSyntheticModel(const string& path, size_t triangles)
+{
+	ofstream out(path);
+	if (!out.is_open())
+		return false;
+	size_t side = max((size_t)1, (size_t)sqrt(triangles / 2.0));
+	out << "# " << side * side * 2 << " triangle grid for the asset benchmark" << "\n";
+	for (size_t i = 0; i <= side; i++) {
+		for (size_t j = 0; j <= side; j++) {
+			float u = (float)j / side, v = (float)i / side;
+			out << "v " << u - 0.5f << " 0 " << v - 0.5f << "\n" << "vt " << u << " " << v << "\n" << "vn 0 1 0\n";
+		}
+	}
+	for (size_t i = 0; i < side; i++) {
+		for (size_t j = 0; j < side; j++) {
+			size_t a = i * (side + 1) + j + 1, b = a + 1, c = a + side + 1, d = c + 1;
+			out << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << b << "/" << b << "/" << b << "\n";
+			out << "f " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+		}
+	}
+	return (bool)out;
+}
+
+// Loads the model runs times the way the mounted archive (or its absence) says, timing each stage
+static AssetBenchResult benchmarkModel(const string& path, int source, int runs, bool gl)
+{
+	AssetBenchResult result;
+	result.model = path;
+	result.source = SOURCES[source];
+	vector<double> imports, converts, uploads, pools;
+	vector<double> allocations, allocatedBytes, peakBytes;
+	for (int run = 0; run < runs; run++) {
+		resetPeakBytes();
+		AllocationStats before = allocationStats();
+		// Retained, so the same CPU copy can go to a pool and to buffers of its own
+		unique_ptr<Model> model(new Model(path, false, RETAIN_REUPLOAD));
+		AllocationStats after = allocationStats();
+		imports.push_back(model->loadTimes().import);
+		converts.push_back(model->loadTimes().convert);
+		allocations.push_back((double)(after.count - before.count));
+		allocatedBytes.push_back((double)(after.bytes - before.bytes));
+		peakBytes.push_back((double)(after.peakBytes - before.liveBytes));
+
+		size_t vertices = 0, indices = 0;
+		result.triangles = 0;
+		for (const Mesh& mesh : model->getMeshes()) {
+			vertices += mesh.vertexCount;
+			indices += mesh.indexCount;
+			result.triangles += mesh.indexCount / 3;
+		}
+		result.meshes = model->getMeshes().size();
+		result.gpuBytes = model->gpuBytes();
+		if (!gl || result.meshes == 0)
+			continue;
+
+		// The pool first: setupMesh after it gives each mesh its own VAO back
+		GeometryPool pool;
+		auto start = chrono::steady_clock::now();
+		pool.init(vertices, indices);
+		for (Mesh& mesh : model->getMeshes())
+			pool.add(mesh);
+		glFinish();
+		pools.push_back(secondsSince(start));
+		pool.release();
+
+		start = chrono::steady_clock::now();
+		model->upload();
+		glFinish();
+		uploads.push_back(secondsSince(start));
+		model->releaseBuffers();
+	}
+	result.importSeconds = median(imports);
+	result.convertSeconds = median(converts);
+	result.uploadSeconds = median(uploads);
+	result.poolSeconds = median(pools);
+	result.allocations = (uint64_t)median(allocations);
+	result.allocatedBytes = (uint64_t)median(allocatedBytes);
+	result.peakBytes = (uint64_t)median(peakBytes);
+	return result;
+}
+
+vector<AssetBenchResult> benchmarkAssets(const vector<string>& paths, int runs, bool gl)
+{
+	// Cooked under the paths they were loaded from, so a mounted archive answers for them
+	ArchiveWriter writer;
+	for (const string& path : paths) {
+		Model model(path, false);
+		writer.add(path, model.cook());
+	}
+	bool cooked = writer.write(ARCHIVES[1], false) && writer.write(ARCHIVES[2], true);
+	if (!cooked)
+		cout << "Could not write the benchmark archives, timing the files only" << endl;
+
+	vector<AssetBenchResult> results;
+	countAllocations(true);
+	for (int source = 0; source < (cooked ? 3 : 1); source++) {
+		AssetArchive archive;
+		if (source > 0) {
+			if (!archive.open(ARCHIVES[source]))
+				continue;
+			AssetArchive::mount(&archive);
+		}
+		for (const string& path : paths) {
+			AssetBenchResult result = benchmarkModel(path, source, runs, gl);
+			const AssetArchive::Entry* entry = source > 0 ? archive.find(path) : NULL;
+			if (entry)
+				result.sourceBytes = entry->compressed ? entry->blocks.back() - entry->offset : entry->size;
+			else
+				result.sourceBytes = fileSize(path);
+			results.push_back(result);
+			cout << "." << flush;
+		}
+		AssetArchive::mount(NULL);
+	}
+	countAllocations(false);
+	cout << endl;
+	for (int source = 1; source < 3; source++)
+		remove(ARCHIVES[source]);
+	return results;
+}
+
+void printAssetBench(ostream& out, const vector<AssetBenchResult>& results)
+{
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1);
+	out << left << setw(44) << "Model" << setw(12) << "source" << right << setw(10) << "triangles"
+		<< setw(10) << "import ms" << setw(11) << "convert ms" << setw(8) << "MB/s" << setw(9) << "Mtri/s"
+		<< setw(10) << "upload ms" << setw(9) << "pool ms" << setw(11) << "upload MB/s"
+		<< setw(8) << "allocs" << setw(10) << "alloc MB" << setw(9) << "peak MB" << endl;
+	for (const AssetBenchResult& r : results) {
+		double load = r.importSeconds + r.convertSeconds;
+		string name = r.model.size() > 42 ? "..." + r.model.substr(r.model.size() - 39) : r.model;
+		out << left << setw(44) << name << setw(12) << r.source << right << setw(10) << r.triangles
+			<< setw(10) << r.importSeconds * 1000.0 << setw(11) << r.convertSeconds * 1000.0
+			<< setw(8) << (load > 0.0 ? r.sourceBytes / MB / load : 0.0)
+			<< setw(9) << (load > 0.0 ? r.triangles / load / 1e6 : 0.0);
+		if (r.uploadSeconds >= 0.0)
+			out << setw(10) << r.uploadSeconds * 1000.0 << setw(9) << r.poolSeconds * 1000.0
+				<< setw(11) << (r.uploadSeconds > 0.0 ? r.gpuBytes / MB / r.uploadSeconds : 0.0);
+		else
+			out << setw(10) << "-" << setw(9) << "-" << setw(11) << "-";
+		out << setw(8) << r.allocations << setw(10) << r.allocatedBytes / MB << setw(9) << r.peakBytes / MB << endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool writeAssetBench(const string& path, const vector<AssetBenchResult>& results)
+{
+	ofstream out(path, ios::trunc);
+	if (!out.is_open())
+		return false;
+	out << "model,source,source_bytes,meshes,triangles,gpu_bytes,import_ms,convert_ms,upload_ms,pool_ms,"
+		<< "load_mb_per_s,triangles_per_s,upload_mb_per_s,allocations,allocated_bytes,peak_bytes" << "\n";
+	out << setprecision(6);
+	for (const AssetBenchResult& r : results) {
+		double load = r.importSeconds + r.convertSeconds;
+		out << r.model << "," << r.source << "," << r.sourceBytes << "," << r.meshes << "," << r.triangles << "," << r.gpuBytes << ","
+			<< r.importSeconds * 1000.0 << "," << r.convertSeconds * 1000.0 << ","
+			<< (r.uploadSeconds >= 0.0 ? r.uploadSeconds * 1000.0 : -1.0) << "," << (r.poolSeconds >= 0.0 ? r.poolSeconds * 1000.0 : -1.0) << ","
+			<< (load > 0.0 ? r.sourceBytes / MB / load : 0.0) << "," << (load > 0.0 ? r.triangles / load : 0.0) << ","
+			<< (r.uploadSeconds > 0.0 ? r.gpuBytes / MB / r.uploadSeconds : 0.0) << ","
+			<< r.allocations << "," << r.allocatedBytes << "," << r.peakBytes << "\n";
+	}
+	return (bool)out;
+}
\ No newline at end of file
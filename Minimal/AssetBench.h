@@ -0,0 +1,37 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// One model loaded one way, with each stage of the load timed (medians over the runs)
+struct AssetBenchResult {
+	string model;
+	// "file" for Assimp on the loose file, "archive" or "archive-lz4" for a cooked copy
+	string source;
+	// Bytes read for it: the .obj, or its blob in the archive as stored
+	uint64_t sourceBytes = 0;
+	size_t meshes = 0, triangles = 0;
+	size_t gpuBytes = 0;
+	double importSeconds = 0.0, convertSeconds = 0.0;
+	// Into buffers of each mesh's own and into one GeometryPool, to glFinish; negative without GL
+	double uploadSeconds = -1.0, poolSeconds = -1.0;
+	// Heap allocations in one load, and the most heap it held at once beyond what was live
+	// before it began (medians over the runs too)
+	uint64_t allocations = 0, allocatedBytes = 0;
+	uint64_t peakBytes = 0;
+};
+
+// Writes a flat grid of about the given number of triangles as an .obj, to stand in for the
+// big meshes the assets don't have yet
+bool writeSyntheticModel(const string& path, size_t triangles);
+
+// Loads every model runs times from each source: the file, then a raw and an LZ4 archive
+// cooked from it. With gl the uploads are timed too, on the context current on this thread.
+vector<AssetBenchResult> benchmarkAssets(const vector<string>& paths, int runs, bool gl);
+
+// A table for people, and CSV (a header and a line per result) for tracking regressions
+void printAssetBench(ostream& out, const vector<AssetBenchResult>& results);
+bool writeAssetBench(const string& path, const vector<AssetBenchResult>& results);
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "AtomSpheres.h"
+#include "ParticleGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_map>
+
+constexpr VertexAttribute VertexLayout<AtomInstance>::attributes[];
+
+// Corners closer than this share a vertex, as a fraction of the model's diagonal
+static const float WELD_FRACTION = 1e-5f;
+// How far a round part's corners may be from its radius, as a fraction of it
+static const float ROUND_TOLERANCE = 0.1f;
+// Fewest triangles a round part has; anything coarser is a box or a prism
+static const size_t ROUND_TRIANGLES = 16;
+
+AtomSpheres::AtomSpheres(const ShaderSource& source)
+{
+	this->shader = CompileShaders(source, vertexInputs<AtomInstance>());
+	glGenVertexArrays(1, &this->VAO);
+	glGenBuffers(1, &this->VBO);
+}
+
+AtomSpheres::~AtomSpheres()
+{
+	glDeleteBuffers(1, &this->VBO);
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteProgram(this->shader);
+}
+
+static GLuint findPart(vector<GLuint>& parent, GLuint t)
+{
+	while (parent[t] != t) {
+		parent[t] = parent[parent[t]];
+		t = parent[t];
+	}
+	return t;
+}
+
+vector<AtomSphere> AtomSpheres::fitAtoms(const Model& model)
+{
+	vector<AtomSphere> atoms;
+	glm::vec3 origin = model.boundsMin();
+	float weld = std::max(glm::length(model.boundsMax() - origin) * WELD_FRACTION, 1e-12f);
+	for (const Mesh& mesh : model.getMeshes()) {
+		// The BVH keeps the triangles after the vertices are dropped, as corner and two edges
+		const vector<BVHTriangle>& triangles = mesh.bvh.triangles;
+		auto corner = [&](size_t t, int c) {
+			const BVHTriangle& tri = triangles[t];
+			return c == 0 ? tri.v0 : c == 1 ? tri.v0 + tri.e1 : tri.v0 + tri.e2;
+		};
+
+		// Triangles that share a welded corner are one part
+		vector<GLuint> parent(triangles.size());
+		std::iota(parent.begin(), parent.end(), 0);
+		unordered_map<uint64_t, GLuint> owner;
+		for (size_t t = 0; t < triangles.size(); t++) {
+			for (int c = 0; c < 3; c++) {
+				glm::vec3 q = (corner(t, c) - origin) / weld + glm::vec3(0.5f);
+				uint64_t key = ((uint64_t)(uint32_t)q.x & 0x1fffff) | (((uint64_t)(uint32_t)q.y & 0x1fffff) << 21) | (((uint64_t)(uint32_t)q.z & 0x1fffff) << 42);
+				auto found = owner.emplace(key, (GLuint)t);
+				if (!found.second)
+					parent[findPart(parent, (GLuint)t)] = findPart(parent, found.first->second);
+			}
+		}
+
+		// Bounds and size of each part, then whether its corners all lie on the sphere in those bounds
+		unordered_map<GLuint, size_t> partIndex;
+		vector<glm::vec3> partMin, partMax;
+		vector<size_t> partTriangles;
+		vector<GLuint> part(triangles.size());
+		for (size_t t = 0; t < triangles.size(); t++) {
+			GLuint root = findPart(parent, (GLuint)t);
+			auto found = partIndex.emplace(root, partMin.size());
+			if (found.second) {
+				partMin.push_back(glm::vec3(INFINITY));
+				partMax.push_back(glm::vec3(-INFINITY));
+				partTriangles.push_back(0);
+			}
+			size_t p = found.first->second;
+			part[t] = (GLuint)p;
+			partTriangles[p]++;
+			for (int c = 0; c < 3; c++) {
+				partMin[p] = glm::min(partMin[p], corner(t, c));
+				partMax[p] = glm::max(partMax[p], corner(t, c));
+			}
+		}
+		vector<unsigned char> round(partMin.size(), 1);
+		for (size_t t = 0; t < triangles.size(); t++) {
+			size_t p = part[t];
+			glm::vec3 center = 0.5f * (partMin[p] + partMax[p]);
+			glm::vec3 half = 0.5f * (partMax[p] - partMin[p]);
+			float radius = (half.x + half.y + half.z) / 3.0f;
+			for (int c = 0; c < 3; c++) {
+				if (std::fabs(glm::length(corner(t, c) - center) - radius) > ROUND_TOLERANCE * radius)
+					round[p] = 0;
+			}
+		}
+		for (size_t p = 0; p < partMin.size(); p++) {
+			if (!round[p] || partTriangles[p] < ROUND_TRIANGLES)
+				continue;
+			AtomSphere atom;
+			atom.offset = 0.5f * (partMin[p] + partMax[p]);
+			glm::vec3 half = 0.5f * (partMax[p] - partMin[p]);
+			atom.radius = (half.x + half.y + half.z) / 3.0f;
+			glm::vec3 color = glm::clamp(mesh.mtl.diffuse, 0.0f, 1.0f) * 255.0f;
+			atom.color = glm::u8vec4((GLubyte)color.x, (GLubyte)color.y, (GLubyte)color.z, 255);
+			atoms.push_back(atom);
+		}
+	}
+	return atoms;
+}
+
+void AtomSpheres::update(const ParticleSystem& particles, const vector<unsigned char>& detail)
+{
+	this->instances.clear();
+	if (!this->enabled)
+		return;
+	// detail lags the particles by a frame, and a reset or rewind can leave it longer
+	size_t count = std::min(detail.size(), particles.size());
+	for (size_t i = 0; i < count; i++) {
+		if (detail[i] != DETAIL_MESH || this->atoms[particles.kind[i]].empty())
+			continue;
+		glm::mat4 transform = particles.transform(i);
+		for (const AtomSphere& atom : this->atoms[particles.kind[i]]) {
+			AtomInstance instance;
+			instance.Center = glm::vec3(transform * glm::vec4(atom.offset, 1.0f));
+			instance.Radius = atom.radius * particles.scale;
+			instance.Color = atom.color;
+			this->instances.push_back(instance);
+		}
+	}
+	if (this->instances.empty())
+		return;
+
+	glBindVertexArray(this->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+	// Grown in doubling steps and orphaned every frame, so the driver never waits on the last draw
+	if (this->instances.size() > this->capacity) {
+		this->capacity = std::max(this->instances.size(), this->capacity * 2);
+		setVertexLayout<AtomInstance>();
+	}
+	glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(AtomInstance), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, this->instances.size() * sizeof(AtomInstance), &this->instances[0]);
+	glBindVertexArray(0);
+}
+
+void AtomSpheres::draw(const glm::mat4& projection, const glm::mat4& view)
+{
+	if (!this->enabled || this->instances.empty())
+		return;
+	glUseProgram(this->shader);
+	glm::mat4 inverseView = glm::inverse(view);
+	glUniformMatrix4fv(glGetUniformLocation(this->shader, "projection"), 1, GL_FALSE, &projection[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(this->shader, "view"), 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(this->shader, "inverseView"), 1, GL_FALSE, &inverseView[0][0]);
+
+	glBindVertexArray(this->VAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)this->instances.size());
+	glBindVertexArray(0);
+}
\ No newline at end of file
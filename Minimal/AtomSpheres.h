@@ -0,0 +1,72 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "ParticleSystem.h"
+#include "Shader.h"
+#include "VertexLayout.h"
+
+// One atom of a molecule model: a sphere around offset in the model's own units
+struct AtomSphere {
+	glm::vec3 offset;
+	float radius;
+	// Packed as the instances take it
+	glm::u8vec4 color;
+};
+
+// One atom placed in the world, an instance of the quad atom.vert draws
+struct AtomInstance {
+	glm::vec3 Center;
+	float Radius;
+	glm::u8vec4 Color;
+};
+
+template <> struct VertexLayout<AtomInstance> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(AtomInstance, Center, "center", 0, GL_FALSE, 1),
+		VERTEX_ATTRIBUTE(AtomInstance, Radius, "radius", 1, GL_FALSE, 1),
+		VERTEX_ATTRIBUTE(AtomInstance, Color, "color", 2, GL_TRUE, 1),
+	};
+};
+static_assert(checkVertexLayout<AtomInstance>(true), "AtomInstance attributes don't cover AtomInstance exactly");
+
+// Draws the molecules the ParticleGovernor keeps at full detail as the spheres of their atoms,
+// every atom of every molecule in one instanced call per eye. Each atom is a quad facing the
+// eye that atom.frag ray-traces the sphere in, writing its depth, so it is exact at any
+// distance and a molecule costs four vertices an atom however close it is.
+class AtomSpheres {
+public:
+	// Molecules are drawn as meshes instead while this is off
+	bool enabled = true;
+	// The atoms of each ParticleKind; a kind with none is left to its mesh
+	vector<AtomSphere> atoms[2];
+
+	// source is atom.vert and atom.frag, read with ReadShaderSource
+	explicit AtomSpheres(const ShaderSource& source);
+	~AtomSpheres();
+
+	// The round parts of model as atoms, each in its mesh's diffuse color. A part is triangles
+	// joined by their corners, and is round when every corner is about as far from the middle
+	// of its bounds; bonds and anything else that isn't are left out.
+	static vector<AtomSphere> fitAtoms(const Model& model);
+
+	// Refills the instances from the particles whose detail is DETAIL_MESH
+	void update(const ParticleSystem& particles, const vector<unsigned char>& detail);
+	// Draws them into the bound framebuffer with the camera of the eye being rendered
+	void draw(const glm::mat4& projection, const glm::mat4& view);
+	// Whether molecules of kind are drawn here rather than as meshes
+	bool draws(unsigned char kind) const { return this->enabled && !this->atoms[kind].empty(); }
+	size_t size() const { return this->instances.size(); }
+
+private:
+	GLuint shader = 0;
+	// atom.vert reads only instance attributes; the quad's corners come from gl_VertexID
+	GLuint VAO = 0, VBO = 0;
+	size_t capacity = 0;
+	vector<AtomInstance> instances;
+};
\ No newline at end of file
@@ -0,0 +1,349 @@
+// OVR_CAPI_Audio.h brings in Windows.h itself, without the min and max macros
+#include <OVR_CAPI_Audio.h>
+#include <Extras/OVR_CAPI_Util.h>
+#include <mmsystem.h>
+
+#include "Audio.h"
+
+#include <algorithm>
+#include <cmath>
+
+const int AudioMixer::SAMPLE_RATE;
+const int AudioMixer::BLOCK_FRAMES;
+const int AudioMixer::MAX_VOICES;
+
+static const float PI = 3.14159265f;
+
+bool AudioClip::loadWav(const string& path)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file)
+		return false;
+	vector<char> bytes((size_t)file.tellg());
+	file.seekg(0);
+	if (bytes.empty() || !file.read(&bytes[0], bytes.size()))
+		return false;
+
+	ovrAudioChannelData channel;
+	if (!OVR_SUCCESS(ovr_ReadWavFromBuffer(&channel, &bytes[0], (int)bytes.size(), 0)))
+		return false;
+	samples.assign(channel.Samples, channel.Samples + channel.SamplesCount);
+	sampleRate = channel.Frequency;
+	ovr_ReleaseAudioChannelData(&channel);
+	return !samples.empty() && sampleRate > 0;
+}
+
+AudioClip AudioClip::tone(float startHz, float endHz, float seconds, int sampleRate)
+{
+	AudioClip clip;
+	clip.sampleRate = sampleRate;
+	clip.samples.resize((size_t)(seconds * sampleRate));
+	float phase = 0.0f;
+	for (size_t i = 0; i < clip.samples.size(); i++) {
+		float t = float(i) / clip.samples.size();
+		phase += 2.0f * PI * (startHz + (endHz - startHz) * t) / sampleRate;
+		// Short attack so it doesn't click, then an exponential fade
+		float envelope = std::min(1.0f, i / (0.005f * sampleRate)) * expf(-4.0f * t);
+		clip.samples[i] = sinf(phase) * envelope;
+	}
+	return clip;
+}
+
+bool NullAudioDevice::open(int sampleRate, int blockFrames)
+{
+	this->sampleRate = sampleRate;
+	framesWritten = 0;
+	start = std::chrono::steady_clock::now();
+	return true;
+}
+
+void NullAudioDevice::write(const float* samples, int frames)
+{
+	// Keep one block ahead of the clock, as a sound card's buffer would
+	std::this_thread::sleep_until(start + std::chrono::microseconds(framesWritten * 1000000 / sampleRate));
+	framesWritten += frames;
+}
+
+bool FileAudioDevice::open(int sampleRate, int blockFrames)
+{
+	file.open(path, ios::binary | ios::trunc);
+	if (!file)
+		return false;
+	// Sizes are filled in on close
+	uint32_t zero = 0, formatSize = 16, rate = sampleRate, byteRate = sampleRate * 4;
+	uint16_t pcmFormat = 1, channels = 2, blockAlign = 4, bits = 16;
+	file.write("RIFF", 4);
+	file.write((const char*)&zero, 4);
+	file.write("WAVEfmt ", 8);
+	file.write((const char*)&formatSize, 4);
+	file.write((const char*)&pcmFormat, 2);
+	file.write((const char*)&channels, 2);
+	file.write((const char*)&rate, 4);
+	file.write((const char*)&byteRate, 4);
+	file.write((const char*)&blockAlign, 2);
+	file.write((const char*)&bits, 2);
+	file.write("data", 4);
+	file.write((const char*)&zero, 4);
+	pcm.resize(blockFrames * 2);
+	return NullAudioDevice::open(sampleRate, blockFrames);
+}
+
+void FileAudioDevice::write(const float* samples, int frames)
+{
+	pcm.resize(frames * 2);
+	for (int i = 0; i < frames * 2; i++)
+		pcm[i] = (int16_t)(std::max(-1.0f, std::min(1.0f, samples[i])) * 32767.0f);
+	file.write((const char*)&pcm[0], pcm.size() * sizeof(int16_t));
+	NullAudioDevice::write(samples, frames);
+}
+
+void FileAudioDevice::close()
+{
+	if (!file.is_open())
+		return;
+	uint32_t dataSize = (uint32_t)(framesWritten * 4), riffSize = dataSize + 36;
+	file.seekp(4);
+	file.write((const char*)&riffSize, 4);
+	file.seekp(40);
+	file.write((const char*)&dataSize, 4);
+	file.close();
+}
+
+// A ring of blocks queued on a waveOut device. write fills the next block once the device has
+// played it, waiting on the event waveOut signals whenever a block finishes.
+class WaveOutAudioDevice : public AudioDevice {
+public:
+	bool open(int sampleRate, int blockFrames) override
+	{
+		UINT id = WAVE_MAPPER;
+		if (!OVR_SUCCESS(ovr_GetAudioDeviceOutWaveId(&id)))
+			id = WAVE_MAPPER;
+
+		WAVEFORMATEX format = {};
+		format.wFormatTag = WAVE_FORMAT_PCM;
+		format.nChannels = 2;
+		format.nSamplesPerSec = sampleRate;
+		format.wBitsPerSample = 16;
+		format.nBlockAlign = 4;
+		format.nAvgBytesPerSec = sampleRate * 4;
+		done = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (waveOutOpen(&handle, id, &format, (DWORD_PTR)done, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+			CloseHandle(done);
+			return false;
+		}
+
+		pcm.assign(BUFFERS * blockFrames * 2, 0);
+		for (int i = 0; i < BUFFERS; i++) {
+			headers[i] = {};
+			headers[i].lpData = (LPSTR)&pcm[i * blockFrames * 2];
+			headers[i].dwBufferLength = blockFrames * 4;
+			waveOutPrepareHeader(handle, &headers[i], sizeof(WAVEHDR));
+		}
+		next = 0;
+		return true;
+	}
+
+	void write(const float* samples, int frames) override
+	{
+		WAVEHDR& header = headers[next];
+		while (header.dwFlags & WHDR_INQUEUE)
+			WaitForSingleObject(done, 100);
+		int16_t* out = (int16_t*)header.lpData;
+		frames = std::min(frames, (int)header.dwBufferLength / 4);
+		for (int i = 0; i < frames * 2; i++)
+			out[i] = (int16_t)(std::max(-1.0f, std::min(1.0f, samples[i])) * 32767.0f);
+		waveOutWrite(handle, &header, sizeof(WAVEHDR));
+		next = (next + 1) % BUFFERS;
+	}
+
+	void close() override
+	{
+		waveOutReset(handle);
+		for (int i = 0; i < BUFFERS; i++)
+			waveOutUnprepareHeader(handle, &headers[i], sizeof(WAVEHDR));
+		waveOutClose(handle);
+		CloseHandle(done);
+	}
+
+private:
+	// Blocks in flight: the output latency, and the slack the mixer thread has to be late
+	static const int BUFFERS = 3;
+	HWAVEOUT handle = nullptr;
+	HANDLE done = nullptr;
+	WAVEHDR headers[BUFFERS];
+	vector<int16_t> pcm;
+	int next = 0;
+};
+
+unique_ptr<AudioDevice> createWaveOutDevice()
+{
+	return unique_ptr<AudioDevice>(new WaveOutAudioDevice());
+}
+
+AudioMixer::~AudioMixer()
+{
+	stop();
+}
+
+int AudioMixer::addClip(AudioClip clip)
+{
+	// The mixer thread reads clips without locking, so they're fixed once it runs
+	if (running() || clip.samples.empty())
+		return -1;
+	clips.push_back(std::move(clip));
+	return (int)clips.size() - 1;
+}
+
+int AudioMixer::loadClip(const string& path)
+{
+	AudioClip clip;
+	if (!clip.loadWav(path))
+		return -1;
+	return addClip(std::move(clip));
+}
+
+bool AudioMixer::start(unique_ptr<AudioDevice> device)
+{
+	if (running() || !device->open(SAMPLE_RATE, BLOCK_FRAMES))
+		return false;
+	this->device = std::move(device);
+	block.assign(BLOCK_FRAMES * 2, 0.0f);
+	quit = false;
+	worker = thread(&AudioMixer::run, this);
+	return true;
+}
+
+void AudioMixer::stop()
+{
+	if (!running())
+		return;
+	quit = true;
+	worker.join();
+	device->close();
+	device.reset();
+}
+
+void AudioMixer::play(int clip, const glm::vec3& position, float gain)
+{
+	if (clip < 0 || !running())
+		return;
+	PlayCommand command = { clip, position, gain, true };
+	if (!plays.push(command))
+		droppedCommands++;
+}
+
+void AudioMixer::play(int clip, float gain)
+{
+	if (clip < 0 || !running())
+		return;
+	PlayCommand command = { clip, glm::vec3(0.0f), gain, false };
+	if (!plays.push(command))
+		droppedCommands++;
+}
+
+void AudioMixer::setListener(const glm::vec3& position, const glm::vec3& right)
+{
+	if (!running())
+		return;
+	Listener pose = { position, right };
+	// The mixer only wants the latest, an update lost to a full queue is superseded next frame anyway
+	listeners.push(pose);
+}
+
+void AudioMixer::run()
+{
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+	while (!quit) {
+		Listener pose;
+		while (listeners.pop(pose))
+			listener = pose;
+		PlayCommand command;
+		while (plays.pop(command))
+			startVoice(command);
+
+		mix();
+		device->write(&block[0], BLOCK_FRAMES);
+	}
+}
+
+void AudioMixer::earGains(const Voice& voice, float& left, float& right) const
+{
+	if (!voice.positional) {
+		// Equal power centre
+		left = right = voice.gain * 0.7071f;
+		return;
+	}
+	glm::vec3 offset = voice.position - listener.position;
+	float distance = glm::length(offset);
+	float gain = voice.gain * referenceDistance / std::max(distance, referenceDistance);
+	// Equal power pan from how far toward the right ear the sound is
+	float side = distance > 1e-4f ? glm::dot(offset / distance, listener.right) : 0.0f;
+	float angle = (std::max(-1.0f, std::min(1.0f, side)) + 1.0f) * PI * 0.25f;
+	left = gain * cosf(angle);
+	right = gain * sinf(angle);
+}
+
+void AudioMixer::startVoice(const PlayCommand& command)
+{
+	if (command.clip < 0 || command.clip >= (int)clips.size())
+		return;
+	Voice voice;
+	voice.clip = &clips[command.clip];
+	voice.step = double(voice.clip->sampleRate) / SAMPLE_RATE;
+	voice.position = command.position;
+	voice.gain = command.gain;
+	voice.positional = command.positional;
+	earGains(voice, voice.left, voice.right);
+
+	// A free slot, else the quietest voice if the new one is louder
+	int slot = -1;
+	float quietest = voice.left + voice.right;
+	for (int i = 0; i < MAX_VOICES; i++) {
+		if (!voiceSlots[i].clip) {
+			slot = i;
+			break;
+		}
+		float loudness = voiceSlots[i].left + voiceSlots[i].right;
+		if (loudness < quietest) {
+			quietest = loudness;
+			slot = i;
+		}
+	}
+	if (slot >= 0)
+		voiceSlots[slot] = voice;
+}
+
+void AudioMixer::mix()
+{
+	std::fill(block.begin(), block.end(), 0.0f);
+	int active = 0;
+	for (Voice& voice : voiceSlots) {
+		if (!voice.clip) continue;
+		const vector<float>& samples = voice.clip->samples;
+		double end = double(samples.size() - 1);
+
+		// Ramp the ear gains across the block toward where the listener is now
+		float left, right;
+		earGains(voice, left, right);
+		float dLeft = (left - voice.left) / BLOCK_FRAMES, dRight = (right - voice.right) / BLOCK_FRAMES;
+		float l = voice.left, r = voice.right;
+
+		for (int i = 0; i < BLOCK_FRAMES && voice.cursor < end; i++) {
+			size_t index = (size_t)voice.cursor;
+			float frac = float(voice.cursor - index);
+			float sample = samples[index] + (samples[index + 1] - samples[index]) * frac;
+			l += dLeft;
+			r += dRight;
+			block[i * 2] += sample * l * masterGain;
+			block[i * 2 + 1] += sample * r * masterGain;
+			voice.cursor += voice.step;
+		}
+		voice.left = left;
+		voice.right = right;
+		if (voice.cursor >= end)
+			voice.clip = nullptr;
+		else
+			active++;
+	}
+	activeVoices.store(active, memory_order_relaxed);
+}
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+// Std. Includes
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "SpscQueue.h"
+
+// A decoded mono sound, kept in memory for the whole session
+struct AudioClip {
+	vector<float> samples;
+	int sampleRate = 0;
+
+	// Reads one channel of a WAV file (PCM or float) through the LibOVR reader
+	bool loadWav(const string& path);
+	// A sine sweeping from startHz to endHz over seconds, fading out; stands in for missing files
+	static AudioClip tone(float startHz, float endHz, float seconds, int sampleRate);
+};
+
+// Where the mix goes. Blocks are interleaved stereo floats. write is called from the mixer
+// thread only and waits until the device can take the block, which is what paces the mixer.
+class AudioDevice {
+public:
+	virtual ~AudioDevice() {}
+	virtual bool open(int sampleRate, int blockFrames) = 0;
+	virtual void write(const float* samples, int frames) = 0;
+	virtual void close() {}
+};
+
+// Throws the mix away in real time, for running without sound hardware
+class NullAudioDevice : public AudioDevice {
+public:
+	bool open(int sampleRate, int blockFrames) override;
+	void write(const float* samples, int frames) override;
+
+protected:
+	int sampleRate = 0;
+	int64_t framesWritten = 0;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Records the mix to a 16 bit stereo WAV file, in real time like a sound card would take it
+class FileAudioDevice : public NullAudioDevice {
+public:
+	explicit FileAudioDevice(const string& path) : path(path) {}
+	bool open(int sampleRate, int blockFrames) override;
+	void write(const float* samples, int frames) override;
+	void close() override;
+
+private:
+	string path;
+	ofstream file;
+	vector<int16_t> pcm;
+};
+
+// The headset's headphones (or the default output when the runtime has no preference), through waveOut
+unique_ptr<AudioDevice> createWaveOutDevice();
+
+// Mixes one-shot sounds on a real-time thread of its own. The game thread hands over plays and
+// the listener's pose through lock-free single producer queues, so it never waits on audio; when a
+// queue is full the command is dropped and counted. Positional sounds fall off with distance and
+// pan between the ears by where they are relative to the head. At most MAX_VOICES play at once; a
+// new sound takes the place of the quietest one if it would be louder, else it is dropped.
+// Everything public is for one game thread only.
+class AudioMixer {
+public:
+	static const int SAMPLE_RATE = 48000;
+	// About 11 ms at SAMPLE_RATE, the latency a device adds per block it buffers
+	static const int BLOCK_FRAMES = 512;
+	static const int MAX_VOICES = 24;
+
+	~AudioMixer();
+
+	// Clips can only be added before start. Returns the clip's id, or -1 if it can't be read.
+	int addClip(AudioClip clip);
+	int loadClip(const string& path);
+
+	// Starts mixing into device; false (and nothing started) if the device doesn't open
+	bool start(unique_ptr<AudioDevice> device);
+	void stop();
+	bool running() const { return worker.joinable(); }
+
+	// A sound at a point in the world
+	void play(int clip, const glm::vec3& position, float gain = 1.0f);
+	// A sound in the middle of the head, for the game's own announcements
+	void play(int clip, float gain = 1.0f);
+	// Where the head is and which way its right ear points, once a frame
+	void setListener(const glm::vec3& position, const glm::vec3& right);
+
+	// Voices playing as of the last mixed block, and commands lost to full queues
+	int voices() const { return activeVoices.load(memory_order_relaxed); }
+	unsigned dropped() const { return droppedCommands; }
+
+	// Set before start. Distance up to which a sound plays at full gain; it halves with every doubling beyond.
+	float referenceDistance = 1.0f;
+	float masterGain = 0.5f;
+
+private:
+	struct PlayCommand {
+		int clip;
+		glm::vec3 position;
+		float gain;
+		bool positional;
+	};
+	struct Listener {
+		glm::vec3 position;
+		glm::vec3 right;
+	};
+	struct Voice {
+		const AudioClip* clip = nullptr;
+		// Read position in clip samples, and samples per output frame
+		double cursor = 0.0;
+		double step = 1.0;
+		glm::vec3 position;
+		float gain = 1.0f;
+		bool positional = false;
+		// Ear gains reached at the end of the last block, ramped from to avoid clicks
+		float left = 0.0f, right = 0.0f;
+	};
+
+	vector<AudioClip> clips;
+	unique_ptr<AudioDevice> device;
+	thread worker;
+	atomic<bool> quit{ false };
+
+	// Game thread to mixer thread
+	SpscQueue<PlayCommand, 256> plays;
+	SpscQueue<Listener, 16> listeners;
+	unsigned droppedCommands = 0;
+
+	// Mixer thread only
+	Listener listener = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+	Voice voiceSlots[MAX_VOICES];
+	vector<float> block;
+	atomic<int> activeVoices{ 0 };
+
+	void run();
+	void startVoice(const PlayCommand& command);
+	void earGains(const Voice& voice, float& left, float& right) const;
+	void mix();
+};
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <emmintrin.h>
+
+// Number of centroid bins tried per axis when looking for a split
+static const int SAH_BINS = 12;
+// Leaves never split below this many triangles
+static const GLuint MAX_LEAF_TRIANGLES = 2;
+// From this depth on, nodes are split at their median instead. SAH splits of skewed geometry can
+// peel a few primitives off per level; halving reaches BVH_MAX_DEPTH only past 2^16 per node.
+static const int SAH_MAX_DEPTH = 32;
+
+static inline float horizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+	return _mm_cvtss_f32(v);
+}
+
+RayPacket::RayPacket()
+{
+	for (int lane = 0; lane < 4; lane++) {
+		ox[lane] = oy[lane] = oz[lane] = 0.0f;
+		dx[lane] = dy[lane] = dz[lane] = 1.0f;
+		// A negative range keeps the lane from ever hitting anything
+		tMax[lane] = t[lane] = -1.0f;
+	}
+}
+
+void RayPacket::set(int lane, const Ray& ray, const glm::mat4& toObject)
+{
+	// The direction is not renormalized, so t means the same thing in both spaces
+	glm::vec4 o = toObject * glm::vec4(ray.origin, 1.0f);
+	glm::vec4 d = toObject * glm::vec4(ray.direction, 0.0f);
+	ox[lane] = o.x; oy[lane] = o.y; oz[lane] = o.z;
+	dx[lane] = d.x; dy[lane] = d.y; dz[lane] = d.z;
+	tMax[lane] = t[lane] = ray.tMax;
+}
+
+static float surfaceArea(const glm::vec3& lo, const glm::vec3& hi)
+{
+	glm::vec3 e = hi - lo;
+	return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Recursive binned SAH splitting shared by buildHierarchy
+struct HierarchyBuilder {
+	vector<BVHNode>& nodes;
+	vector<GLuint>& order;
+	const vector<glm::vec3>& primMin;
+	const vector<glm::vec3>& primMax;
+	vector<glm::vec3> centroids;
+	GLuint maxLeafSize;
+
+	HierarchyBuilder(vector<BVHNode>& nodes, vector<GLuint>& order, const vector<glm::vec3>& primMin, const vector<glm::vec3>& primMax, GLuint maxLeafSize)
+		: nodes(nodes), order(order), primMin(primMin), primMax(primMax), maxLeafSize(maxLeafSize)
+	{
+		centroids.resize(primMin.size());
+		for (size_t i = 0; i < primMin.size(); i++) {
+			centroids[i] = (primMin[i] + primMax[i]) * 0.5f;
+		}
+	}
+
+	void subdivide(GLuint nodeIndex, int depth)
+	{
+		const GLuint first = nodes[nodeIndex].leftFirst;
+		const GLuint count = nodes[nodeIndex].count;
+		// At the deepest level a node stays a leaf however many it holds
+		if (count <= maxLeafSize || depth >= BVH_MAX_DEPTH) {
+			return;
+		}
+
+		glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+		for (GLuint i = first; i < first + count; i++) {
+			cmin = glm::min(cmin, centroids[order[i]]);
+			cmax = glm::max(cmax, centroids[order[i]]);
+		}
+		if (depth >= SAH_MAX_DEPTH) {
+			splitMedian(nodeIndex, first, count, cmin, cmax, depth);
+			return;
+		}
+
+		// Find the cheapest bin boundary over all three axes
+		int bestAxis = -1, bestSplit = 0;
+		float bestCost = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++) {
+			float extent = cmax[axis] - cmin[axis];
+			if (extent <= 0.0f) continue;
+			float binScale = SAH_BINS / extent;
+
+			GLuint binCount[SAH_BINS] = { 0 };
+			glm::vec3 binMin[SAH_BINS], binMax[SAH_BINS];
+			for (int b = 0; b < SAH_BINS; b++) {
+				binMin[b] = glm::vec3(FLT_MAX);
+				binMax[b] = glm::vec3(-FLT_MAX);
+			}
+			for (GLuint i = first; i < first + count; i++) {
+				GLuint prim = order[i];
+				int b = std::min(SAH_BINS - 1, (int)((centroids[prim][axis] - cmin[axis]) * binScale));
+				binCount[b]++;
+				binMin[b] = glm::min(binMin[b], primMin[prim]);
+				binMax[b] = glm::max(binMax[b], primMax[prim]);
+			}
+
+			// Sweep from both ends to get the area and count on each side of every boundary
+			float leftArea[SAH_BINS - 1], rightArea[SAH_BINS - 1];
+			GLuint leftCount[SAH_BINS - 1], rightCount[SAH_BINS - 1];
+			glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+			GLuint lsum = 0, rsum = 0;
+			for (int b = 0; b < SAH_BINS - 1; b++) {
+				lsum += binCount[b];
+				lmin = glm::min(lmin, binMin[b]);
+				lmax = glm::max(lmax, binMax[b]);
+				leftCount[b] = lsum;
+				leftArea[b] = lsum ? surfaceArea(lmin, lmax) : 0.0f;
+
+				int r = SAH_BINS - 1 - b;
+				rsum += binCount[r];
+				rmin = glm::min(rmin, binMin[r]);
+				rmax = glm::max(rmax, binMax[r]);
+				rightCount[r - 1] = rsum;
+				rightArea[r - 1] = rsum ? surfaceArea(rmin, rmax) : 0.0f;
+			}
+			for (int b = 0; b < SAH_BINS - 1; b++) {
+				float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+				if (leftCount[b] && rightCount[b] && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b + 1;
+				}
+			}
+		}
+
+		// Stop when no split beats testing every primitive in this node
+		const BVHNode& node = nodes[nodeIndex];
+		float leafCost = count * surfaceArea(glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]),
+			glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]));
+		if (bestAxis < 0 || bestCost >= leafCost) {
+			return;
+		}
+
+		float binScale = SAH_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+		GLuint* middle = std::partition(&order[first], &order[first] + count, [&](GLuint prim) {
+			return std::min(SAH_BINS - 1, (int)((centroids[prim][bestAxis] - cmin[bestAxis]) * binScale)) < bestSplit;
+		});
+		split(nodeIndex, first, count, (GLuint)(middle - &order[first]), depth);
+	}
+
+	// Halves the node along its centroids' longest axis
+	void splitMedian(GLuint nodeIndex, GLuint first, GLuint count, const glm::vec3& cmin, const glm::vec3& cmax, int depth)
+	{
+		glm::vec3 extent = cmax - cmin;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+		GLuint* begin = &order[first];
+		std::nth_element(begin, begin + count / 2, begin + count, [&](GLuint a, GLuint b) {
+			return centroids[a][axis] < centroids[b][axis];
+		});
+		split(nodeIndex, first, count, count / 2, depth);
+	}
+
+	// Makes the node's first leftCount primitives its left child and the rest its right, then subdivides both
+	void split(GLuint nodeIndex, GLuint first, GLuint count, GLuint leftCount, int depth)
+	{
+		GLuint leftIndex = (GLuint)nodes.size();
+		BVHNode left, right;
+		left.leftFirst = first;
+		left.count = leftCount;
+		right.leftFirst = first + leftCount;
+		right.count = count - leftCount;
+		nodes.push_back(left);
+		nodes.push_back(right);
+		nodes[nodeIndex].leftFirst = leftIndex;
+		nodes[nodeIndex].count = 0;
+
+		updateLeafBounds(leftIndex);
+		updateLeafBounds(leftIndex + 1);
+		subdivide(leftIndex, depth + 1);
+		subdivide(leftIndex + 1, depth + 1);
+	}
+
+	void updateLeafBounds(GLuint nodeIndex)
+	{
+		BVHNode& node = nodes[nodeIndex];
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		for (GLuint i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+			lo = glm::min(lo, primMin[order[i]]);
+			hi = glm::max(hi, primMax[order[i]]);
+		}
+		for (int a = 0; a < 3; a++) {
+			node.boundsMin[a] = lo[a];
+			node.boundsMax[a] = hi[a];
+		}
+	}
+};
+
+void buildHierarchy(vector<BVHNode>& nodes, vector<GLuint>& order, const vector<glm::vec3>& primMin, const vector<glm::vec3>& primMax, GLuint maxLeafSize)
+{
+	nodes.clear();
+	const GLuint primCount = (GLuint)primMin.size();
+	order.resize(primCount);
+	for (GLuint i = 0; i < primCount; i++) {
+		order[i] = i;
+	}
+	if (primCount == 0) {
+		return;
+	}
+
+	// A binary tree over n leaves never needs more than 2n - 1 nodes
+	nodes.reserve(2 * primCount);
+	BVHNode root;
+	root.leftFirst = 0;
+	root.count = primCount;
+	nodes.push_back(root);
+
+	HierarchyBuilder builder(nodes, order, primMin, primMax, maxLeafSize);
+	builder.updateLeafBounds(0);
+	builder.subdivide(0, 0);
+	nodes.shrink_to_fit();
+}
+
+void refitHierarchy(vector<BVHNode>& nodes, const vector<GLuint>& order, const vector<glm::vec3>& primMin, const vector<glm::vec3>& primMax)
+{
+	// Children are always stored after their parent, so a reverse walk sees them first
+	for (size_t n = nodes.size(); n-- > 0;) {
+		BVHNode& node = nodes[n];
+		glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+		if (node.isLeaf()) {
+			for (GLuint i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+				lo = glm::min(lo, primMin[order[i]]);
+				hi = glm::max(hi, primMax[order[i]]);
+			}
+		}
+		else {
+			for (GLuint c = node.leftFirst; c < node.leftFirst + 2; c++) {
+				lo = glm::min(lo, glm::vec3(nodes[c].boundsMin[0], nodes[c].boundsMin[1], nodes[c].boundsMin[2]));
+				hi = glm::max(hi, glm::vec3(nodes[c].boundsMax[0], nodes[c].boundsMax[1], nodes[c].boundsMax[2]));
+			}
+		}
+		for (int a = 0; a < 3; a++) {
+			node.boundsMin[a] = lo[a];
+			node.boundsMax[a] = hi[a];
+		}
+	}
+}
+
+void MeshBVH::build(const void* positions, size_t stride, const GLuint* indices, size_t indexCount)
+{
+	nodes.clear();
+	triangles.clear();
+	const GLuint triCount = (GLuint)(indexCount / 3);
+	if (triCount == 0) {
+		return;
+	}
+
+	const unsigned char* base = (const unsigned char*)positions;
+	vector<BVHTriangle> source(triCount);
+	vector<glm::vec3> triMin(triCount), triMax(triCount);
+	for (GLuint i = 0; i < triCount; i++) {
+		glm::vec3 a = *(const glm::vec3*)(base + indices[3 * i] * stride);
+		glm::vec3 b = *(const glm::vec3*)(base + indices[3 * i + 1] * stride);
+		glm::vec3 c = *(const glm::vec3*)(base + indices[3 * i + 2] * stride);
+		source[i].v0 = a;
+		source[i].e1 = b - a;
+		source[i].e2 = c - a;
+		triMin[i] = glm::min(a, glm::min(b, c));
+		triMax[i] = glm::max(a, glm::max(b, c));
+	}
+
+	vector<GLuint> order;
+	buildHierarchy(nodes, order, triMin, triMax, MAX_LEAF_TRIANGLES);
+
+	triangles.resize(triCount);
+	for (GLuint i = 0; i < triCount; i++) {
+		triangles[i] = source[order[i]];
+	}
+}
+
+bool MeshBVH::intersect(const Ray& ray, float& t) const
+{
+	RayPacket packet;
+	packet.set(0, ray);
+	packet.t[0] = std::min(t, ray.tMax);
+	intersect(packet);
+	if (packet.t[0] < t) {
+		t = packet.t[0];
+		return true;
+	}
+	return false;
+}
+
+void MeshBVH::intersect(RayPacket& packet) const
+{
+	if (empty()) {
+		return;
+	}
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 eps = _mm_set1_ps(1e-7f);
+	const __m128 ox = _mm_load_ps(packet.ox), oy = _mm_load_ps(packet.oy), oz = _mm_load_ps(packet.oz);
+	const __m128 dx = _mm_load_ps(packet.dx), dy = _mm_load_ps(packet.dy), dz = _mm_load_ps(packet.dz);
+	const __m128 rx = _mm_div_ps(one, dx), ry = _mm_div_ps(one, dy), rz = _mm_div_ps(one, dz);
+	__m128 tHit = _mm_load_ps(packet.t);
+
+	// Slab test of all four rays against a node, returns the lanes that enter it
+	auto enter = [&](const BVHNode& node, __m128& tEnter) {
+		__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[0]), ox), rx);
+		__m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[0]), ox), rx);
+		__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[1]), oy), ry);
+		__m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[1]), oy), ry);
+		__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMin[2]), oz), rz);
+		__m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.boundsMax[2]), oz), rz);
+		__m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), zero));
+		__m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), tHit));
+		__m128 mask = _mm_cmple_ps(tmin, tmax);
+		tEnter = _mm_or_ps(_mm_and_ps(mask, tmin), _mm_andnot_ps(mask, _mm_set1_ps(FLT_MAX)));
+		return _mm_movemask_ps(mask);
+	};
+
+	GLuint stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	__m128 rootEnter;
+	if (!enter(nodes[0], rootEnter)) {
+		return;
+	}
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BVHNode& node = nodes[stack[--stackSize]];
+		if (node.isLeaf()) {
+			for (GLuint i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+				const BVHTriangle& tri = triangles[i];
+				__m128 e1x = _mm_set1_ps(tri.e1.x), e1y = _mm_set1_ps(tri.e1.y), e1z = _mm_set1_ps(tri.e1.z);
+				__m128 e2x = _mm_set1_ps(tri.e2.x), e2y = _mm_set1_ps(tri.e2.y), e2z = _mm_set1_ps(tri.e2.z);
+				// p = d x e2
+				__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+				__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+				__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+				__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+				__m128 absDet = _mm_max_ps(det, _mm_sub_ps(zero, det));
+				__m128 invDet = _mm_div_ps(one, det);
+				// s = o - v0
+				__m128 sx = _mm_sub_ps(ox, _mm_set1_ps(tri.v0.x));
+				__m128 sy = _mm_sub_ps(oy, _mm_set1_ps(tri.v0.y));
+				__m128 sz = _mm_sub_ps(oz, _mm_set1_ps(tri.v0.z));
+				__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+				// q = s x e1
+				__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+				__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+				__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+				__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+				__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+
+				__m128 mask = _mm_and_ps(_mm_cmpgt_ps(absDet, eps), _mm_cmpge_ps(u, zero));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+				mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmplt_ps(t, tHit)));
+				tHit = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, tHit));
+			}
+			continue;
+		}
+
+		// Visit the child the packet reaches first, so later boxes are culled by closer hits
+		__m128 tLeft, tRight;
+		int hitLeft = enter(nodes[node.leftFirst], tLeft);
+		int hitRight = enter(nodes[node.leftFirst + 1], tRight);
+		assert(stackSize + 2 <= BVH_STACK_SIZE);
+		if (hitLeft && hitRight) {
+			bool leftFirst = horizontalMin(tLeft) <= horizontalMin(tRight);
+			stack[stackSize++] = leftFirst ? node.leftFirst + 1 : node.leftFirst;
+			stack[stackSize++] = leftFirst ? node.leftFirst : node.leftFirst + 1;
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = node.leftFirst;
+		}
+		else if (hitRight) {
+			stack[stackSize++] = node.leftFirst + 1;
+		}
+	}
+	_mm_store_ps(packet.t, tHit);
+}
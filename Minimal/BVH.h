@@ -0,0 +1,79 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// A ray segment: points origin + t * direction for t in [0, tMax]
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMax;
+};
+
+// Up to four rays traced together, one per SSE lane. Lanes that aren't set stay
+// inactive. The rays are usually world rays moved into one object's space.
+struct RayPacket {
+	alignas(16) float ox[4], oy[4], oz[4];
+	alignas(16) float dx[4], dy[4], dz[4];
+	alignas(16) float tMax[4];
+	// Nearest hit distance per lane, tMax if nothing was hit
+	alignas(16) float t[4];
+
+	RayPacket();
+	void set(int lane, const Ray& ray, const glm::mat4& toObject = glm::mat4(1.0f));
+	bool hit(int lane) const { return t[lane] < tMax[lane]; }
+};
+
+// 32 byte node, two per cache line. Interior nodes keep their two children side by
+// side starting at leftFirst, leaves store count triangles starting at leftFirst.
+struct BVHNode {
+	float boundsMin[3];
+	GLuint leftFirst;
+	float boundsMax[3];
+	GLuint count;
+
+	bool isLeaf() const { return count > 0; }
+};
+
+// One corner and two edges, ready for the Moller-Trumbore test
+struct BVHTriangle {
+	glm::vec3 v0, e1, e2;
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, built with the binned
+// surface area heuristic and stored flat in depth-first order.
+class MeshBVH {
+public:
+	/*  Hierarchy Data  */
+	vector<BVHNode> nodes;
+	// Triangles reordered so every leaf covers a contiguous range
+	vector<BVHTriangle> triangles;
+
+	/*  Functions  */
+	// Builds over indexed triangles. positions points at the first vertex position and
+	// consecutive positions are stride bytes apart.
+	void build(const void* positions, size_t stride, const GLuint* indices, size_t indexCount);
+	bool empty() const { return nodes.empty(); }
+
+	glm::vec3 boundsMin() const { return glm::vec3(nodes[0].boundsMin[0], nodes[0].boundsMin[1], nodes[0].boundsMin[2]); }
+	glm::vec3 boundsMax() const { return glm::vec3(nodes[0].boundsMax[0], nodes[0].boundsMax[1], nodes[0].boundsMax[2]); }
+
+	// Nearest hit along a single ray, t is updated only when something closer is found
+	bool intersect(const Ray& ray, float& t) const;
+	// Traces all active lanes of the packet together, updating packet.t
+	void intersect(RayPacket& packet) const;
+};
+
+// Deepest level a hierarchy is built to, the root being 0. A depth-first traversal keeps at
+// most one sibling per level waiting, so BVH_STACK_SIZE entries always hold it.
+const int BVH_MAX_DEPTH = 48;
+const int BVH_STACK_SIZE = BVH_MAX_DEPTH + 2;
+
+// Builds a binned SAH hierarchy over primitive bounding boxes. order receives the
+// primitive indices in leaf order. Shared by the mesh and scene hierarchies.
+void buildHierarchy(vector<BVHNode>& nodes, vector<GLuint>& order, const vector<glm::vec3>& primMin, const vector<glm::vec3>& primMax, GLuint maxLeafSize);
+// Recomputes every node's bounds after the primitives moved, keeping the topology
+void refitHierarchy(vector<BVHNode>& nodes, const vector<GLuint>& order, const vector<glm::vec3>& primMin, const vector<glm::vec3>& primMax);
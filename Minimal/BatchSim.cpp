@@ -0,0 +1,296 @@
+#include "BatchSim.h"
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+const size_t BatchSim::CAPACITY;
+const int BatchSim::REFRESH_RATE;
+const int BatchSim::TICK_RATE;
+
+// Where empty slots wait: outside every field and hit by no beam, so the kernels can sweep them harmlessly
+static const glm::vec3 PARKED = glm::vec3(0.0f, 1e6f, 0.0f);
+// Length of a laser, the z scale of its transform in the game
+static const float BEAM_LENGTH = 20.0f;
+
+void ScriptedController::prepare(int environments)
+{
+	randoms.resize(environments);
+	for (int i = 0; i < environments; i++)
+		randoms[i].state = 1000u + i;
+}
+
+void ScriptedController::control(const BatchSim& sim, int env, SimInput& input)
+{
+	size_t first, count;
+	const ParticleSystem& particles = sim.particles(env, first, count);
+	glm::vec3 eye = (sim.hand(0) + sim.hand(1)) * 0.5f;
+
+	// Nearest CO2 molecule to the hands
+	size_t target = first + count;
+	float nearest = 1e30f;
+	for (size_t i = first; i < first + count; i++) {
+		if (particles.kind[i] != PARTICLE_CO2) continue;
+		glm::vec3 d = particles.position(i) - eye;
+		float d2 = glm::dot(d, d);
+		if (d2 < nearest) {
+			nearest = d2;
+			target = i;
+		}
+	}
+
+	Random& random = randoms[env];
+	for (int side = 0; side < 2; side++) {
+		Ray& beam = input.beams[side];
+		beam.origin = sim.hand(side);
+		beam.tMax = 1.0f;
+		if (target == first + count) {
+			beam.direction = glm::vec3(0.0f, 0.0f, -BEAM_LENGTH);
+			input.trigger[side] = false;
+			continue;
+		}
+		glm::vec3 error = glm::vec3(random.next(), random.next(), random.next()) / float(0x7fff) * 2.0f - glm::vec3(1.0f);
+		glm::vec3 aim = particles.position(target) + error * aimError * sqrtf(nearest);
+		beam.direction = glm::normalize(aim - beam.origin) * BEAM_LENGTH;
+		input.trigger[side] = true;
+	}
+}
+
+bool ReplayController::load(const string& path)
+{
+	Snapshot replay;
+	return replay.loadFile(path) && replay.open() && replay.getArray(frames);
+}
+
+bool ReplayController::save(const string& path, const vector<ReplayFrame>& frames)
+{
+	Snapshot replay;
+	replay.begin();
+	replay.putArray(frames);
+	return replay.saveFile(path);
+}
+
+void ReplayController::control(const BatchSim& sim, int env, SimInput& input)
+{
+	if (frames.empty()) {
+		for (int side = 0; side < 2; side++) {
+			input.beams[side].origin = sim.hand(side);
+			input.beams[side].direction = glm::vec3(0.0f, 0.0f, -BEAM_LENGTH);
+			input.beams[side].tMax = 1.0f;
+			input.trigger[side] = false;
+		}
+		return;
+	}
+	const ReplayFrame& frame = frames[sim.stepCount(env) % frames.size()];
+	for (int side = 0; side < 2; side++) {
+		input.beams[side].origin = glm::vec3(frame.origin[side][0], frame.origin[side][1], frame.origin[side][2]);
+		input.beams[side].direction = glm::vec3(frame.direction[side][0], frame.direction[side][1], frame.direction[side][2]);
+		input.beams[side].tMax = 1.0f;
+		input.trigger[side] = frame.trigger[side] != 0;
+	}
+}
+
+BatchSim::BatchSim(int environments, int threads, SimController& controller)
+	: controller(controller)
+{
+	envs.resize(environments);
+	threads = std::max(1, std::min(threads, environments));
+	for (int t = 0; t < threads; t++) {
+		Batch batch;
+		batch.firstEnv = environments * t / threads;
+		batch.envCount = environments * (t + 1) / threads - batch.firstEnv;
+		batches.push_back(batch);
+	}
+}
+
+void BatchSim::init(const string& assets)
+{
+	// Nothing is drawn, only the picking hierarchies are needed past loading
+	co2.reset(new Model(assets + "/co2/co2.obj", false));
+	co2->releaseCpuCopies();
+
+	// Same layout as the game, which generates the world before anything else draws a random number
+	Random layout;
+	world.generate(home, 3, 1.0f, 4, 2, layout);
+	factoryScale = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f));
+	factoryModels.resize(4);
+	fields.resize(4);
+
+	// The player stands still at the origin, so the active cells never change
+	for (int c = 0; c < (int)world.cells.size(); c++) {
+		if (world.distance(c, glm::vec3(0.0f)) >= world.loadRadius) continue;
+		for (const FactoryInstance& factory : world.cells[c].factories) {
+			if (factoryModels[factory.variant]) continue;
+			string name = "factory" + to_string(factory.variant + 1);
+			factoryModels[factory.variant].reset(new Model(assets + "/" + name + "/" + name + ".obj", false));
+			fields[factory.variant].addModel(*factoryModels[factory.variant], factoryScale);
+			fields[factory.variant].build();
+			factoryModels[factory.variant]->releaseCpuCopies();
+		}
+		// The round is the home cell's; the far cells' molecules never count toward it
+		for (const Emitter& emitter : world.cells[c].emitters) {
+			if (c != world.homeCell) break;
+			ActiveEmitter active = { (int)activeCells.size(), emitter.position, (uint64_t)(emitter.interval * TICK_RATE) };
+			emitters.push_back(active);
+		}
+		activeCells.push_back(c);
+	}
+
+	for (int b = 0; b < (int)batches.size(); b++) {
+		Batch& batch = batches[b];
+		batch.pool.clear();
+		batch.pool.reserve(batch.envCount * CAPACITY);
+		for (size_t i = 0; i < batch.envCount * CAPACITY; i++)
+			batch.pool.spawn(PARKED, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), PARTICLE_O2);
+		for (int e = batch.firstEnv; e < batch.firstEnv + batch.envCount; e++) {
+			Environment& env = envs[e];
+			env.batch = b;
+			env.first = (e - batch.firstEnv) * CAPACITY;
+			env.random.state = 1u + e;
+			startRound(env, batch);
+		}
+	}
+	controller.prepare(environments());
+}
+
+void BatchSim::startRound(Environment& env, Batch& batch)
+{
+	for (size_t i = env.first; i < env.first + CAPACITY; i++)
+		batch.pool.place(i, PARKED, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), PARTICLE_O2);
+	env.count = 0;
+	env.co2Count = 0;
+	for (int i = 0; i < 5; i++)
+		spawn(env, batch, home);
+
+	env.nextEmit.resize(emitters.size());
+	for (size_t e = 0; e < emitters.size(); e++)
+		env.nextEmit[e] = env.step + emitters[e].interval;
+	env.spawned.assign(activeCells.size(), 0);
+	env.roundStart = env.step;
+}
+
+void BatchSim::spawn(Environment& env, Batch& batch, const glm::vec3& position)
+{
+	size_t slot = env.first + env.count;
+	if (env.count < CAPACITY) {
+		env.count++;
+	}
+	else {
+		// Full: an O2 molecule no longer matters to the round, so it gives up its slot
+		for (slot = env.first; slot < env.first + CAPACITY && batch.pool.kind[slot] != PARTICLE_O2; slot++);
+		if (slot == env.first + CAPACITY) return;
+	}
+	ParticleEmitters::initialize(puff, batch.pool, slot, 1, env.random, &position);
+	env.co2Count++;
+}
+
+void BatchSim::step(Batch& batch)
+{
+	// Every environment of the batch at once
+	batch.pool.integrate();
+	for (int c : activeCells) {
+		for (const FactoryInstance& factory : world.cells[c].factories)
+			fields[factory.variant].collide(batch.pool, particleRadius, factory.position);
+	}
+	for (int e = batch.firstEnv; e < batch.firstEnv + batch.envCount; e++)
+		stepEnvironment(envs[e], batch);
+}
+
+void BatchSim::stepEnvironment(Environment& env, Batch& batch)
+{
+	SimInput input;
+	controller.control(*this, (int)(&env - &envs[0]), input);
+
+	// The same two-level picking the game does
+	size_t factoryCount = 0;
+	for (int c : activeCells)
+		factoryCount += world.cells[c].factories.size();
+	env.scene.resize(factoryCount + env.count);
+	size_t instance = 0;
+	for (int c : activeCells) {
+		for (const FactoryInstance& factory : world.cells[c].factories)
+			env.scene.setInstance(instance++, factoryModels[factory.variant].get(), glm::translate(glm::mat4(1.0f), factory.position) * factoryScale, INSTANCE_STATIC, -1);
+	}
+	for (size_t i = env.first; i < env.first + env.count; i++) {
+		// O2 is never hit, so it doesn't need the real model
+		bool isCo2 = batch.pool.kind[i] == PARTICLE_CO2;
+		env.scene.setInstance(instance++, co2.get(), batch.pool.transform(i), isCo2 ? INSTANCE_CO2 : INSTANCE_O2, (int)i);
+	}
+	env.scene.update();
+
+	for (int side = 0; side < 2; side++) {
+		SceneHit hit;
+		if (env.scene.intersect(input.beams[side], INSTANCE_STATIC, hit))
+			input.beams[side].tMax = hit.t;
+	}
+	if (input.trigger[0] && input.trigger[1]) {
+		env.scene.intersectAll(input.beams[0], INSTANCE_CO2, env.hits[0]);
+		env.scene.intersectAll(input.beams[1], INSTANCE_CO2, env.hits[1]);
+		for (const SceneHit& l : env.hits[0]) {
+			for (const SceneHit& r : env.hits[1]) {
+				int i = env.scene.instances[l.instance].id;
+				if (l.instance != r.instance || batch.pool.kind[i] != PARTICLE_CO2) continue;
+				batch.pool.kind[i] = PARTICLE_O2;
+				env.co2Count--;
+			}
+		}
+	}
+
+	env.step++;
+	for (size_t e = 0; e < emitters.size(); e++) {
+		if (env.step < env.nextEmit[e]) continue;
+		env.nextEmit[e] += emitters[e].interval;
+		const WorldCell& cell = world.cells[activeCells[emitters[e].cell]];
+		if (cell.particleBudget >= 0 && env.spawned[emitters[e].cell] >= cell.particleBudget) continue;
+		env.spawned[emitters[e].cell]++;
+		spawn(env, batch, emitters[e].position);
+	}
+
+	env.stats.steps++;
+	bool lost = env.co2Count > 10;
+	bool won = env.co2Count == 0;
+	if (won || lost) {
+		env.stats.rounds++;
+		env.stats.wins += won;
+		env.stats.losses += lost;
+		env.stats.roundSteps += env.step - env.roundStart;
+		startRound(env, batch);
+	}
+}
+
+void BatchSim::run(uint64_t steps)
+{
+	auto start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (Batch& batch : batches) {
+		Batch* b = &batch;
+		workers.push_back(thread([this, b, steps] {
+			for (uint64_t s = 0; s < steps; s++)
+				step(*b);
+		}));
+	}
+	for (thread& worker : workers)
+		worker.join();
+	seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+SimStats BatchSim::stats() const
+{
+	SimStats total;
+	for (const Environment& env : envs) {
+		total.steps += env.stats.steps;
+		total.rounds += env.stats.rounds;
+		total.wins += env.stats.wins;
+		total.losses += env.stats.losses;
+		total.roundSteps += env.stats.roundSteps;
+	}
+	total.seconds = seconds;
+	return total;
+}
+
+const ParticleSystem& BatchSim::particles(int env, size_t& first, size_t& count) const
+{
+	first = envs[env].first;
+	count = envs[env].count;
+	return batches[envs[env].batch].pool;
+}
\ No newline at end of file
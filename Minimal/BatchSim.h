@@ -0,0 +1,156 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "BVH.h"
+#include "DistanceField.h"
+#include "Model.h"
+#include "ParticleEmitter.h"
+#include "ParticleSystem.h"
+#include "Random.h"
+#include "SceneBVH.h"
+#include "Snapshot.h"
+#include "World.h"
+
+// What a player does in one step: where the two lasers point and whether they're red.
+// Beams are segments as ColorCubeScene::laserRay builds them, t in [0, 1].
+struct SimInput {
+	Ray beams[2];
+	bool trigger[2];
+};
+
+// One step of recorded input as stored in a replay file
+struct ReplayFrame {
+	float origin[2][3];
+	float direction[2][3];
+	uint8_t trigger[2];
+};
+
+class BatchSim;
+
+// Plays the lasers of headless environments. control is called from the sim's worker
+// threads, concurrently for different environments.
+class SimController {
+public:
+	virtual ~SimController() {}
+	// Called once before the run with the number of environments
+	virtual void prepare(int environments) {}
+	virtual void control(const BatchSim& sim, int env, SimInput& input) = 0;
+};
+
+// Aims both lasers at the nearest CO2 molecule, missing by up to aimError of the distance
+class ScriptedController : public SimController {
+public:
+	float aimError = 0.02f;
+
+	void prepare(int environments) override;
+	void control(const BatchSim& sim, int env, SimInput& input) override;
+
+private:
+	vector<Random> randoms;
+};
+
+// Plays back a recording, looping, the same in every environment
+class ReplayController : public SimController {
+public:
+	vector<ReplayFrame> frames;
+
+	// Replay files are snapshots holding one array of frames
+	bool load(const string& path);
+	static bool save(const string& path, const vector<ReplayFrame>& frames);
+	void control(const BatchSim& sim, int env, SimInput& input) override;
+};
+
+// Totals over every environment of a run
+struct SimStats {
+	uint64_t steps = 0;
+	uint64_t rounds = 0, wins = 0, losses = 0;
+	// Steps spent in finished rounds
+	uint64_t roundSteps = 0;
+	double seconds = 0.0;
+};
+
+// Steps many independent games without a window or GL, for playtesting and tuning. The
+// rules are the game's: five CO2 to start, emitters in the cells near the player, a
+// molecule turns to O2 when both red lasers hit it, win at no CO2, lose past ten.
+// Environments are split into one batch per thread, and each batch keeps the particles
+// of all its environments in one ParticleSystem, a fixed run of slots per environment,
+// so integration and distance field collision sweep every environment at once.
+class BatchSim {
+public:
+	// Particle slots per environment; when full, spawns reuse O2 slots
+	static const size_t CAPACITY = 64;
+	// The headset's refresh rate
+	static const int REFRESH_RATE = 90;
+	// Steps per simulated second. The game's update(), which integrates, converts hits and
+	// records a replay frame, runs once per eye, so it steps twice a frame.
+	static const int TICK_RATE = 2 * REFRESH_RATE;
+
+	BatchSim(int environments, int threads, SimController& controller);
+	// Loads every model GL-free and lays out the world as the game does
+	void init(const string& assets);
+	// Steps every environment steps times, batches in parallel
+	void run(uint64_t steps);
+	SimStats stats() const;
+
+	int environments() const { return (int)envs.size(); }
+	// The particles of one environment are the slots [first, first + count) of pool
+	const ParticleSystem& particles(int env, size_t& first, size_t& count) const;
+	uint64_t stepCount(int env) const { return envs[env].step; }
+	glm::vec3 hand(int side) const { return glm::vec3(side == 0 ? -0.2f : 0.2f, -0.3f, -0.3f); }
+
+	float particleRadius = 0.3f;
+
+private:
+	struct Environment {
+		int batch;
+		size_t first, count = 0;
+		Random random;
+		int co2Count = 0;
+		uint64_t step = 0, roundStart = 0;
+		// Per emitter of the active cells: next step it fires; per active cell: molecules emitted
+		vector<uint64_t> nextEmit;
+		vector<int> spawned;
+		SceneBVH scene;
+		vector<SceneHit> hits[2];
+		SimStats stats;
+	};
+	struct Batch {
+		ParticleSystem pool;
+		int firstEnv, envCount;
+	};
+	// A factory the sim collides with and the emitter that goes with it
+	struct ActiveEmitter {
+		int cell;
+		glm::vec3 position;
+		uint64_t interval;
+	};
+
+	SimController& controller;
+	vector<Environment> envs;
+	vector<Batch> batches;
+	double seconds = 0.0;
+
+	World world;
+	glm::vec3 home = glm::vec3(0.0f, -1.0f, -15.0f);
+	vector<int> activeCells;
+	vector<ActiveEmitter> emitters;
+	// How every chimney puffs, the game's own
+	EmitterDesc puff;
+	// Indexed by variant, only the variants the active cells use are loaded
+	vector<unique_ptr<Model>> factoryModels;
+	vector<DistanceField> fields;
+	glm::mat4 factoryScale;
+	unique_ptr<Model> co2;
+
+	void step(Batch& batch);
+	void stepEnvironment(Environment& env, Batch& batch);
+	void startRound(Environment& env, Batch& batch);
+	void spawn(Environment& env, Batch& batch, const glm::vec3& position);
+};
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include "DistanceField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+
+// Distance reported for points that fall outside the voxel grid
+static const float FAR_DISTANCE = 1e30f;
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+static glm::vec3 closestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Orientation of the 2D edge with a consistent tie break, so that a ray through a
+// shared edge or vertex is counted by exactly one of the triangles touching it.
+static int orientation(double x1, double y1, double x2, double y2, double& twiceSignedArea)
+{
+	twiceSignedArea = y1 * x2 - x1 * y2;
+	if (twiceSignedArea > 0) return 1;
+	else if (twiceSignedArea < 0) return -1;
+	else if (y2 > y1) return 1;
+	else if (y2 < y1) return -1;
+	else if (x1 > x2) return 1;
+	else if (x1 < x2) return -1;
+	else return 0;
+}
+
+// Is (x0,y0) inside the 2D triangle? Also returns its barycentric coordinates.
+static bool pointInTriangle2D(double x0, double y0, double x1, double y1, double x2, double y2, double x3, double y3, double& a, double& b, double& c)
+{
+	x1 -= x0; x2 -= x0; x3 -= x0;
+	y1 -= y0; y2 -= y0; y3 -= y0;
+	int signa = orientation(x2, y2, x3, y3, a);
+	if (signa == 0) return false;
+	int signb = orientation(x3, y3, x1, y1, b);
+	if (signb != signa) return false;
+	int signc = orientation(x1, y1, x2, y2, c);
+	if (signc != signa) return false;
+	double sum = a + b + c;
+	if (sum == 0) return false;
+	a /= sum; b /= sum; c /= sum;
+	return true;
+}
+
+void DistanceField::addModel(const Model& model, const glm::mat4& transform)
+{
+	for (const Mesh& mesh : model.getMeshes()) {
+		for (GLuint index : mesh.indices) {
+			glm::vec4 p = transform * glm::vec4(mesh.vertices[index].Position, 1.0f);
+			triangles.push_back(glm::vec3(p));
+		}
+	}
+}
+
+// Builds the field following Bridson's makelevelset3: exact distances in a narrow band
+// around every triangle, fast sweeping to carry the closest triangle to the rest of the
+// grid, and the sign from the parity of triangle crossings along grid rows in x.
+void DistanceField::build(int resolution, int margin)
+{
+	phi.clear();
+	const int triCount = (int)(triangles.size() / 3);
+	if (triCount == 0) {
+		return;
+	}
+
+	glm::vec3 lo = triangles[0], hi = triangles[0];
+	for (const glm::vec3& p : triangles) {
+		lo = glm::min(lo, p);
+		hi = glm::max(hi, p);
+	}
+	glm::vec3 extent = hi - lo;
+	float longest = std::max(extent.x, std::max(extent.y, extent.z));
+	cellSize = longest > 0.0f ? longest / resolution : 1.0f;
+	origin = lo - glm::vec3(margin * cellSize);
+	dims = glm::ivec3(extent / cellSize) + glm::ivec3(2 * margin + 2);
+
+	const int voxelCount = dims.x * dims.y * dims.z;
+	phi.assign(voxelCount, (dims.x + dims.y + dims.z) * cellSize);
+	vector<int> closest(voxelCount, -1);
+	vector<int> crossings(voxelCount, 0);
+	auto index = [&](int i, int j, int k) { return (k * dims.y + j) * dims.x + i; };
+	auto voxelCenter = [&](int i, int j, int k) { return origin + glm::vec3((float)i, (float)j, (float)k) * cellSize; };
+	auto triangleDistance = [&](const glm::vec3& p, int t) {
+		const glm::vec3* v = &triangles[3 * t];
+		return glm::length(p - closestPointOnTriangle(p, v[0], v[1], v[2]));
+	};
+
+	for (int t = 0; t < triCount; t++) {
+		// Triangle corners in grid coordinates
+		glm::vec3 a = (triangles[3 * t] - origin) / cellSize;
+		glm::vec3 b = (triangles[3 * t + 1] - origin) / cellSize;
+		glm::vec3 c = (triangles[3 * t + 2] - origin) / cellSize;
+		glm::vec3 tmin = glm::min(a, glm::min(b, c));
+		glm::vec3 tmax = glm::max(a, glm::max(b, c));
+
+		// Exact distances for voxels within one cell of the triangle
+		int i0 = std::max(0, (int)tmin.x - 1), i1 = std::min(dims.x - 1, (int)tmax.x + 2);
+		int j0 = std::max(0, (int)tmin.y - 1), j1 = std::min(dims.y - 1, (int)tmax.y + 2);
+		int k0 = std::max(0, (int)tmin.z - 1), k1 = std::min(dims.z - 1, (int)tmax.z + 2);
+		for (int k = k0; k <= k1; k++) for (int j = j0; j <= j1; j++) for (int i = i0; i <= i1; i++) {
+			float d = triangleDistance(voxelCenter(i, j, k), t);
+			if (d < phi[index(i, j, k)]) {
+				phi[index(i, j, k)] = d;
+				closest[index(i, j, k)] = t;
+			}
+		}
+
+		// Count where rows of voxels along x cross the triangle
+		j0 = std::max(0, (int)std::ceil(tmin.y)); j1 = std::min(dims.y - 1, (int)std::floor(tmax.y));
+		k0 = std::max(0, (int)std::ceil(tmin.z)); k1 = std::min(dims.z - 1, (int)std::floor(tmax.z));
+		for (int k = k0; k <= k1; k++) for (int j = j0; j <= j1; j++) {
+			double wa, wb, wc;
+			if (pointInTriangle2D(j, k, a.y, a.z, b.y, b.z, c.y, c.z, wa, wb, wc)) {
+				int i = (int)std::ceil(wa * a.x + wb * b.x + wc * c.x);
+				if (i < 0) crossings[index(0, j, k)]++;
+				else if (i < dims.x) crossings[index(i, j, k)]++;
+			}
+		}
+	}
+
+	// Propagate the closest triangle outward from the band
+	auto check = [&](int i, int j, int k, int ni, int nj, int nk, const glm::vec3& p) {
+		int t = closest[index(ni, nj, nk)];
+		if (t < 0) return;
+		float d = triangleDistance(p, t);
+		if (d < phi[index(i, j, k)]) {
+			phi[index(i, j, k)] = d;
+			closest[index(i, j, k)] = t;
+		}
+	};
+	auto sweep = [&](int di, int dj, int dk) {
+		int i0 = di > 0 ? 1 : dims.x - 2, i1 = di > 0 ? dims.x : -1;
+		int j0 = dj > 0 ? 1 : dims.y - 2, j1 = dj > 0 ? dims.y : -1;
+		int k0 = dk > 0 ? 1 : dims.z - 2, k1 = dk > 0 ? dims.z : -1;
+		for (int k = k0; k != k1; k += dk) for (int j = j0; j != j1; j += dj) for (int i = i0; i != i1; i += di) {
+			glm::vec3 p = voxelCenter(i, j, k);
+			check(i, j, k, i - di, j, k, p);
+			check(i, j, k, i, j - dj, k, p);
+			check(i, j, k, i - di, j - dj, k, p);
+			check(i, j, k, i, j, k - dk, p);
+			check(i, j, k, i - di, j, k - dk, p);
+			check(i, j, k, i, j - dj, k - dk, p);
+			check(i, j, k, i - di, j - dj, k - dk, p);
+		}
+	};
+	for (int pass = 0; pass < 2; pass++) {
+		sweep(+1, +1, +1); sweep(-1, -1, -1);
+		sweep(+1, +1, -1); sweep(-1, -1, +1);
+		sweep(+1, -1, +1); sweep(-1, +1, -1);
+		sweep(+1, -1, -1); sweep(-1, +1, +1);
+	}
+
+	// An odd number of crossings before a voxel means it is inside
+	for (int k = 0; k < dims.z; k++) for (int j = 0; j < dims.y; j++) {
+		int total = 0;
+		for (int i = 0; i < dims.x; i++) {
+			total += crossings[index(i, j, k)];
+			if (total % 2 == 1) phi[index(i, j, k)] = -phi[index(i, j, k)];
+		}
+	}
+
+	// The triangles are baked into the grid now
+	vector<glm::vec3>().swap(triangles);
+}
+
+float DistanceField::sample(glm::vec3 p, glm::vec3* gradient) const
+{
+	glm::vec3 g = (p - origin) / cellSize;
+	if (empty() || g.x < 0 || g.y < 0 || g.z < 0 || g.x >= dims.x - 1 || g.y >= dims.y - 1 || g.z >= dims.z - 1) {
+		if (gradient) *gradient = glm::vec3(0.0f);
+		return FAR_DISTANCE;
+	}
+	int i = (int)g.x, j = (int)g.y, k = (int)g.z;
+	float fx = g.x - i, fy = g.y - j, fz = g.z - k;
+
+	float c000 = at(i, j, k), c100 = at(i + 1, j, k), c010 = at(i, j + 1, k), c110 = at(i + 1, j + 1, k);
+	float c001 = at(i, j, k + 1), c101 = at(i + 1, j, k + 1), c011 = at(i, j + 1, k + 1), c111 = at(i + 1, j + 1, k + 1);
+
+	float x00 = c000 + (c100 - c000) * fx, x10 = c010 + (c110 - c010) * fx;
+	float x01 = c001 + (c101 - c001) * fx, x11 = c011 + (c111 - c011) * fx;
+	float y0 = x00 + (x10 - x00) * fy, y1 = x01 + (x11 - x01) * fy;
+
+	if (gradient) {
+		// Derivative of the trilinear interpolant, the normal of the surface near p
+		float dx0 = (c100 - c000) + ((c110 - c010) - (c100 - c000)) * fy;
+		float dx1 = (c101 - c001) + ((c111 - c011) - (c101 - c001)) * fy;
+		gradient->x = (dx0 + (dx1 - dx0) * fz) / cellSize;
+		gradient->y = ((x10 - x00) + ((x11 - x01) - (x10 - x00)) * fz) / cellSize;
+		gradient->z = (y1 - y0) / cellSize;
+	}
+	return y0 + (y1 - y0) * fz;
+}
+
+void DistanceField::collideScalar(ParticleSystem& particles, size_t i, float radius, const glm::vec3& offset) const
+{
+	glm::vec3 grad;
+	float d = sample(particles.position(i) - offset, &grad);
+	float len = glm::length(grad);
+	if (d >= radius || len <= 1e-6f) return;
+
+	glm::vec3 n = grad / len;
+	float push = radius - d;
+	particles.posX[i] += n.x * push;
+	particles.posY[i] += n.y * push;
+	particles.posZ[i] += n.z * push;
+
+	float vn = particles.velX[i] * n.x + particles.velY[i] * n.y + particles.velZ[i] * n.z;
+	if (vn < 0.0f) {
+		particles.velX[i] -= 2.0f * vn * n.x;
+		particles.velY[i] -= 2.0f * vn * n.y;
+		particles.velZ[i] -= 2.0f * vn * n.z;
+	}
+}
+
+// Selects a where mask is set, b elsewhere
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+void DistanceField::collide(ParticleSystem& particles, float radius, const glm::vec3& offset) const
+{
+	if (empty()) {
+		return;
+	}
+	const size_t n = particles.size();
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 invCell = _mm_set1_ps(1.0f / cellSize);
+	const __m128 ox = _mm_set1_ps(origin.x + offset.x), oy = _mm_set1_ps(origin.y + offset.y), oz = _mm_set1_ps(origin.z + offset.z);
+	const __m128 limX = _mm_set1_ps((float)(dims.x - 1)), limY = _mm_set1_ps((float)(dims.y - 1)), limZ = _mm_set1_ps((float)(dims.z - 1));
+	const __m128 vRadius = _mm_set1_ps(radius);
+
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		__m128 px = _mm_loadu_ps(&particles.posX[i]);
+		__m128 py = _mm_loadu_ps(&particles.posY[i]);
+		__m128 pz = _mm_loadu_ps(&particles.posZ[i]);
+		__m128 gx = _mm_mul_ps(_mm_sub_ps(px, ox), invCell);
+		__m128 gy = _mm_mul_ps(_mm_sub_ps(py, oy), invCell);
+		__m128 gz = _mm_mul_ps(_mm_sub_ps(pz, oz), invCell);
+
+		// Lanes outside the grid can't be touching anything
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(gx, zero), _mm_cmplt_ps(gx, limX)),
+			_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(gy, zero), _mm_cmplt_ps(gy, limY)),
+				_mm_and_ps(_mm_cmpge_ps(gz, zero), _mm_cmplt_ps(gz, limZ))));
+		if (_mm_movemask_ps(inside) == 0) {
+			continue;
+		}
+		gx = select(inside, gx, zero);
+		gy = select(inside, gy, zero);
+		gz = select(inside, gz, zero);
+
+		__m128i ix = _mm_cvttps_epi32(gx), iy = _mm_cvttps_epi32(gy), iz = _mm_cvttps_epi32(gz);
+		__m128 fx = _mm_sub_ps(gx, _mm_cvtepi32_ps(ix));
+		__m128 fy = _mm_sub_ps(gy, _mm_cvtepi32_ps(iy));
+		__m128 fz = _mm_sub_ps(gz, _mm_cvtepi32_ps(iz));
+
+		// Gather the eight corners of each lane's voxel
+		alignas(16) int cx[4], cy[4], cz[4];
+		alignas(16) float c[8][4];
+		_mm_store_si128((__m128i*)cx, ix);
+		_mm_store_si128((__m128i*)cy, iy);
+		_mm_store_si128((__m128i*)cz, iz);
+		for (int lane = 0; lane < 4; lane++) {
+			const float* base = &phi[(cz[lane] * dims.y + cy[lane]) * dims.x + cx[lane]];
+			const int sy = dims.x, sz = dims.x * dims.y;
+			c[0][lane] = base[0];       c[1][lane] = base[1];
+			c[2][lane] = base[sy];      c[3][lane] = base[sy + 1];
+			c[4][lane] = base[sz];      c[5][lane] = base[sz + 1];
+			c[6][lane] = base[sz + sy]; c[7][lane] = base[sz + sy + 1];
+		}
+		__m128 c000 = _mm_load_ps(c[0]), c100 = _mm_load_ps(c[1]), c010 = _mm_load_ps(c[2]), c110 = _mm_load_ps(c[3]);
+		__m128 c001 = _mm_load_ps(c[4]), c101 = _mm_load_ps(c[5]), c011 = _mm_load_ps(c[6]), c111 = _mm_load_ps(c[7]);
+
+		__m128 x00 = lerp(c000, c100, fx), x10 = lerp(c010, c110, fx);
+		__m128 x01 = lerp(c001, c101, fx), x11 = lerp(c011, c111, fx);
+		__m128 y0 = lerp(x00, x10, fy), y1 = lerp(x01, x11, fy);
+		__m128 d = lerp(y0, y1, fz);
+
+		__m128 hit = _mm_and_ps(inside, _mm_cmplt_ps(d, vRadius));
+		if (_mm_movemask_ps(hit) == 0) {
+			continue;
+		}
+
+		// Gradient of the interpolant gives the surface normal; cellSize cancels on normalizing
+		__m128 dx0 = lerp(_mm_sub_ps(c100, c000), _mm_sub_ps(c110, c010), fy);
+		__m128 dx1 = lerp(_mm_sub_ps(c101, c001), _mm_sub_ps(c111, c011), fy);
+		__m128 nx = lerp(dx0, dx1, fz);
+		__m128 ny = lerp(_mm_sub_ps(x10, x00), _mm_sub_ps(x11, x01), fz);
+		__m128 nz = _mm_sub_ps(y1, y0);
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+		hit = _mm_and_ps(hit, _mm_cmpgt_ps(len2, _mm_set1_ps(1e-12f)));
+		__m128 invLen = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(len2, _mm_set1_ps(1e-12f))));
+		nx = _mm_mul_ps(nx, invLen);
+		ny = _mm_mul_ps(ny, invLen);
+		nz = _mm_mul_ps(nz, invLen);
+
+		// Push out of the surface
+		__m128 push = _mm_and_ps(hit, _mm_sub_ps(vRadius, d));
+		_mm_storeu_ps(&particles.posX[i], _mm_add_ps(px, _mm_mul_ps(nx, push)));
+		_mm_storeu_ps(&particles.posY[i], _mm_add_ps(py, _mm_mul_ps(ny, push)));
+		_mm_storeu_ps(&particles.posZ[i], _mm_add_ps(pz, _mm_mul_ps(nz, push)));
+
+		// Reflect velocities that still point into the surface
+		__m128 vx = _mm_loadu_ps(&particles.velX[i]);
+		__m128 vy = _mm_loadu_ps(&particles.velY[i]);
+		__m128 vz = _mm_loadu_ps(&particles.velZ[i]);
+		__m128 vn = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny)), _mm_mul_ps(vz, nz));
+		__m128 twoVn = _mm_and_ps(_mm_and_ps(hit, _mm_cmplt_ps(vn, zero)), _mm_add_ps(vn, vn));
+		_mm_storeu_ps(&particles.velX[i], _mm_sub_ps(vx, _mm_mul_ps(twoVn, nx)));
+		_mm_storeu_ps(&particles.velY[i], _mm_sub_ps(vy, _mm_mul_ps(twoVn, ny)));
+		_mm_storeu_ps(&particles.velZ[i], _mm_sub_ps(vz, _mm_mul_ps(twoVn, nz)));
+	}
+	for (; i < n; i++) {
+		collideScalar(particles, i, radius, offset);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "ParticleSystem.h"
+
+// A voxelized signed distance field of static geometry. It is built once at load
+// time from the triangles of one or more models, after which a particle only ever
+// needs a trilinear lookup (distance plus gradient) to know whether it touches the
+// geometry, no matter how many triangles went into the field.
+class DistanceField {
+public:
+	/*  Field Data  */
+	// World position of voxel (0,0,0), edge length of a voxel, and voxel counts
+	glm::vec3 origin;
+	float cellSize = 1.0f;
+	glm::ivec3 dims;
+	// Signed distances, negative inside the geometry. Indexed x fastest.
+	vector<float> phi;
+
+	/*  Functions  */
+	// Adds the triangles of a model, placed in the world by transform. Reads the meshes' CPU
+	// copies, so load the model with upload off or RETAIN_COLLISION.
+	void addModel(const Model& model, const glm::mat4& transform);
+	// Voxelizes everything added so far. resolution is the number of voxels along
+	// the longest side of the bounds, margin pads the bounds by that many voxels.
+	void build(int resolution = 64, int margin = 3);
+	bool empty() const { return phi.empty(); }
+
+	// Trilinearly interpolated distance and its gradient (unnormalized) at p.
+	// Points outside the field report a large positive distance.
+	float sample(glm::vec3 p, glm::vec3* gradient = nullptr) const;
+
+	// Pushes every particle closer than radius back out along the field normal
+	// and reflects its velocity. Runs four particles per iteration with SSE.
+	// offset moves the field, so one field serves every placement of its model.
+	void collide(ParticleSystem& particles, float radius, const glm::vec3& offset = glm::vec3(0.0f)) const;
+
+private:
+	// World space triangle soup, three points per triangle
+	vector<glm::vec3> triangles;
+
+	float at(int i, int j, int k) const { return phi[(k * dims.y + j) * dims.x + i]; }
+	void collideScalar(ParticleSystem& particles, size_t i, float radius, const glm::vec3& offset) const;
+};
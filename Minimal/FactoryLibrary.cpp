@@ -0,0 +1,203 @@
+#include "FactoryLibrary.h"
+
+FactoryLibrary::FactoryLibrary(const vector<string>& paths, const glm::mat4& transform, size_t gpuBudgetBytes, Scheduler& scheduler)
+	: scheduler(scheduler)
+{
+	this->transform = transform;
+	this->gpuBudget = gpuBudgetBytes;
+	for (const string& path : paths) {
+		this->variants.emplace_back(new FactoryVariant());
+		this->variants.back()->path = path;
+	}
+}
+
+FactoryLibrary::~FactoryLibrary()
+{
+	// Jobs still out point back at the library
+	this->scheduler.runUntil([this] { return this->loading == 0; });
+	this->pool.release();
+}
+
+void FactoryLibrary::parse(const string& path, const glm::mat4& transform, unique_ptr<Model>& model, DistanceField& field)
+{
+	model.reset(new Model(path, false));
+	// Reloaded after an eviction, the field from the first load still holds
+	if (field.empty()) {
+		field.addModel(*model, transform);
+		field.build();
+	}
+}
+
+// Parses the model and builds its field. Touches no GL state, so it runs on a worker.
+void FactoryLibrary::load(FactoryVariant& variant)
+{
+	parse(variant.path, this->transform, variant.model, variant.field);
+}
+
+void FactoryLibrary::preload(int variant)
+{
+	FactoryVariant& v = *this->variants[variant];
+	if (!v.queued) {
+		v.queued = true;
+		this->load(v);
+		v.loaded = true;
+	}
+	// Already with a worker, which won't be long compared to loading it again
+	this->scheduler.runUntil([&v] { return v.loaded; });
+	if (!v.resident) {
+		// Finish an upload already under way rather than adding its meshes twice
+		size_t first = 0;
+		vector<Mesh>& meshes = v.model->getMeshes();
+		if (this->uploadVariant == variant) {
+			first = this->uploadMesh;
+			if (this->uploadReserved) {
+				Mesh& partial = meshes[first++];
+				this->pool.copy(partial, this->uploadOffset, GeometryPool::uploadBytes(partial));
+				this->pool.finish(partial);
+			}
+			this->uploadVariant = -1;
+			this->uploadOffset = 0;
+			this->uploadReserved = false;
+		}
+		else {
+			this->makeRoom(v.model->gpuBytes());
+		}
+		for (size_t i = first; i < meshes.size(); i++)
+			this->pool.add(meshes[i]);
+		v.resident = true;
+	}
+	v.lastUsed = this->frame;
+}
+
+void FactoryLibrary::preload(int variant, unique_ptr<Model> model, DistanceField field)
+{
+	FactoryVariant& v = *this->variants[variant];
+	if (!v.queued) {
+		v.model = std::move(model);
+		v.field = std::move(field);
+		v.queued = true;
+		v.loaded = true;
+	}
+	this->preload(variant);
+}
+
+void FactoryLibrary::request(int variant)
+{
+	FactoryVariant& v = *this->variants[variant];
+	if (!v.queued) {
+		v.queued = true;
+		this->loading++;
+		FactoryVariant* loadingVariant = &v;
+		this->scheduler.async([this, loadingVariant] { this->load(*loadingVariant); },
+			[this, loadingVariant] { loadingVariant->loaded = true; this->loading--; });
+	}
+	if (!v.resident && !v.uploadWanted) {
+		v.uploadWanted = true;
+		this->uploads.push_back(variant);
+	}
+}
+
+void FactoryLibrary::pump(size_t uploadBudgetBytes)
+{
+	// Start on the oldest request that has finished loading
+	if (this->uploadVariant < 0) {
+		for (size_t i = 0; i < this->uploads.size(); i++) {
+			FactoryVariant& v = *this->variants[this->uploads[i]];
+			if (v.resident) {
+				// Preloaded in the meantime
+				v.uploadWanted = false;
+				this->uploads.erase(this->uploads.begin() + i--);
+			}
+			else if (v.loaded) {
+				this->uploadVariant = this->uploads[i];
+				this->uploadMesh = 0;
+				this->uploadOffset = 0;
+				this->uploadReserved = false;
+				this->uploads.erase(this->uploads.begin() + i);
+				this->makeRoom(v.model->gpuBytes());
+				break;
+			}
+		}
+	}
+
+	// Copy until the budget is spent, stopping inside a mesh if that is where it runs out
+	if (this->uploadVariant >= 0) {
+		FactoryVariant& v = *this->variants[this->uploadVariant];
+		vector<Mesh>& meshes = v.model->getMeshes();
+		size_t budget = uploadBudgetBytes;
+		while (this->uploadMesh < meshes.size()) {
+			Mesh& mesh = meshes[this->uploadMesh];
+			if (!this->uploadReserved) {
+				this->pool.reserve(mesh);
+				this->uploadReserved = true;
+			}
+			size_t copied = this->pool.copy(mesh, this->uploadOffset, budget);
+			this->uploadOffset += copied;
+			budget -= copied;
+			if (this->uploadOffset < GeometryPool::uploadBytes(mesh))
+				break;
+			this->pool.finish(mesh);
+			this->uploadMesh++;
+			this->uploadOffset = 0;
+			this->uploadReserved = false;
+		}
+		if (this->uploadMesh == meshes.size()) {
+			v.resident = true;
+			v.uploadWanted = false;
+			this->uploadVariant = -1;
+		}
+	}
+	this->frame++;
+}
+
+void FactoryLibrary::evict(int variant)
+{
+	FactoryVariant& v = *this->variants[variant];
+	vector<Mesh>& meshes = v.model->getMeshes();
+	for (Mesh& mesh : meshes)
+		this->pool.remove(mesh);
+	v.resident = false;
+	// The meshes gave their CPU copies up on upload, so coming back means parsing again; the
+	// hierarchies go with the model rather than sit in memory for something not drawn
+	v.model.reset();
+	v.loaded = false;
+	v.queued = false;
+}
+
+void FactoryLibrary::makeRoom(size_t bytes)
+{
+	while (this->pool.usedBytes() + bytes > this->gpuBudget) {
+		// Least recently drawn, never one drawn this frame or last
+		int victim = -1;
+		for (int i = 0; i < this->count(); i++) {
+			const FactoryVariant& v = *this->variants[i];
+			if (!v.resident || v.lastUsed + 1 >= this->frame)
+				continue;
+			if (victim < 0 || v.lastUsed < this->variants[victim]->lastUsed)
+				victim = i;
+		}
+		// Everything resident is in view, so go over budget rather than pop
+		if (victim < 0)
+			return;
+		this->evict(victim);
+	}
+}
+
+void FactoryLibrary::reportMemory(ostream& out) const
+{
+	size_t gpuTotal = 0, cpuTotal = 0, fieldTotal = 0;
+	for (int i = 0; i < this->count(); i++) {
+		const FactoryVariant& variant = *this->variants[i];
+		if (!variant.resident)
+			continue;
+		size_t gpu = variant.model->gpuBytes();
+		size_t cpu = variant.model->cpuBytes();
+		size_t field = variant.field.phi.size() * sizeof(float);
+		gpuTotal += gpu;
+		cpuTotal += cpu;
+		fieldTotal += field;
+		out << (variant.lastUsed + 1 >= this->frame ? "* " : "  ") << variant.path << ": " << gpu / 1024 << " KB geometry, " << cpu / 1024 << " KB CPU, " << field / 1024 << " KB distance field" << endl;
+	}
+	out << "Resident factories: " << gpuTotal / 1024 << " KB geometry, " << cpuTotal / 1024 << " KB CPU, " << fieldTotal / 1024 << " KB distance fields" << endl;
+	out << "Geometry pool: " << this->pool.usedBytes() / 1024 << " KB used of " << this->pool.capacityBytes() / 1024 << " KB, budget " << this->gpuBudget / 1024 << " KB" << endl;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+// Std. Includes
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "GeometryPool.h"
+#include "DistanceField.h"
+#include "Scheduler.h"
+
+// One of the interchangeable factory models, with everything derived from it
+struct FactoryVariant {
+	string path;
+	// Parsed model with its picking hierarchies, null until loaded and again once evicted
+	unique_ptr<Model> model;
+	// Collision field in the space of the library transform, built alongside the model
+	DistanceField field;
+	// GL thread only: handed to a worker, model and field complete, waiting for upload,
+	// in the shared pool
+	bool queued = false;
+	bool loaded = false;
+	bool uploadWanted = false;
+	bool resident = false;
+	// Frame the variant was last drawn, for eviction
+	size_t lastUsed = 0;
+};
+
+// Streams factory models in and out of GPU memory on demand. Requested variants are
+// parsed (Assimp, BVH, distance field) as scheduler jobs on worker threads, uploaded
+// into one shared GeometryPool a bounded number of bytes per frame, and once the pool
+// passes its budget the least recently drawn variants are evicted to make room for new
+// ones. Uploaded meshes keep no CPU copy, so an evicted variant is parsed again when next
+// requested; its distance field is kept. A variant is only ever drawn once it is fully
+// resident, so nothing waits on a load.
+class FactoryLibrary {
+public:
+	// transform places each model relative to its instance position (scale, orientation)
+	FactoryLibrary(const vector<string>& paths, const glm::mat4& transform, size_t gpuBudgetBytes, Scheduler& scheduler);
+	~FactoryLibrary();
+
+	// Loads and uploads a variant right away, blocking; for what's needed before the first frame
+	void preload(int variant);
+	// The same with the model and field already parsed (by parse), for loads started before
+	// the library existed
+	void preload(int variant, unique_ptr<Model> model, DistanceField field);
+	// Parses a model and builds its field the way the library does. Touches no GL state.
+	static void parse(const string& path, const glm::mat4& transform, unique_ptr<Model>& model, DistanceField& field);
+	// Asks for a variant to be made resident soon. Cheap to repeat every frame.
+	void request(int variant);
+	bool resident(int variant) const { return variants[variant]->resident; }
+	// Marks a variant as drawn this frame so it isn't evicted
+	void touch(int variant) { variants[variant]->lastUsed = frame; }
+	// GL thread, once a frame: evicts over budget, uploads at most uploadBudgetBytes
+	void pump(size_t uploadBudgetBytes);
+
+	int count() const { return (int)variants.size(); }
+	Model* model(int variant) { return variants[variant]->model.get(); }
+	const DistanceField& field(int variant) const { return variants[variant]->field; }
+
+	// GPU and CPU bytes of each resident variant and of the shared pool
+	void reportMemory(ostream& out) const;
+
+	GeometryPool pool;
+	glm::mat4 transform;
+	size_t gpuBudget;
+
+private:
+	vector<unique_ptr<FactoryVariant>> variants;
+	size_t frame = 1;
+	// Variants waiting to be uploaded, oldest request first
+	deque<int> uploads;
+	// Next mesh of the variant being uploaded and the bytes of it already copied, so uploads
+	// can span frames and split a mesh between them; uploadReserved once it has its space
+	int uploadVariant = -1;
+	size_t uploadMesh = 0;
+	size_t uploadOffset = 0;
+	bool uploadReserved = false;
+
+	Scheduler& scheduler;
+	// Loads handed to the scheduler that haven't come back yet
+	int loading = 0;
+
+	void load(FactoryVariant& variant);
+	void evict(int variant);
+	// Evicts least recently used variants until bytes more fit in the budget
+	void makeRoom(size_t bytes);
+};
\ No newline at end of file
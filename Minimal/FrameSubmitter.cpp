@@ -0,0 +1,169 @@
+#include "FrameSubmitter.h"
+
+#include <chrono>
+#include <cstring>
+
+FrameSubmitter::~FrameSubmitter()
+{
+	stop();
+}
+
+void FrameSubmitter::start(ovrSession session, ovrTextureSwapChain chain, GLFWwindow* shared)
+{
+	stop();
+	this->session = session;
+	this->chain = chain;
+	context = shared;
+	quit = false;
+	handed = committed = 0;
+	worker = thread(&FrameSubmitter::run, this);
+}
+
+void FrameSubmitter::stop()
+{
+	if (!running())
+		return;
+	{
+		lock_guard<mutex> guard(lock);
+		quit = true;
+	}
+	changed.notify_all();
+	worker.join();
+}
+
+double FrameSubmitter::waitForChain()
+{
+	auto start = chrono::steady_clock::now();
+	unique_lock<mutex> guard(lock);
+	changed.wait(guard, [this] { return committed == handed; });
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double FrameSubmitter::submit(long long frameIndex, const ovrLayerEyeFov& layer, const ovrViewScaleDesc& viewScale)
+{
+	// Flushed so the submit thread's context can see the fence
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	auto start = chrono::steady_clock::now();
+	{
+		unique_lock<mutex> guard(lock);
+		changed.wait(guard, [this] { return !hasPending; });
+		pending.frameIndex = frameIndex;
+		pending.layer = layer;
+		pending.viewScale = viewScale;
+		pending.fence = fence;
+		hasPending = true;
+		handed++;
+	}
+	changed.notify_all();
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+double FrameSubmitter::takeSubmitSeconds()
+{
+	lock_guard<mutex> guard(lock);
+	double seconds = submitSeconds;
+	submitSeconds = 0.0;
+	return seconds;
+}
+
+void FrameSubmitter::run()
+{
+	glfwMakeContextCurrent(context);
+	for (;;) {
+		Job job;
+		{
+			unique_lock<mutex> guard(lock);
+			changed.wait(guard, [this] { return quit || hasPending; });
+			if (!hasPending)
+				break;
+			job = pending;
+			hasPending = false;
+		}
+		changed.notify_all();
+
+		// The eye texture has to be finished before the compositor gets it
+		glClientWaitSync(job.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(job.fence);
+		commitChain(session, chain);
+		{
+			lock_guard<mutex> guard(lock);
+			committed++;
+		}
+		changed.notify_all();
+
+		auto start = chrono::steady_clock::now();
+		ovrLayerHeader* headerList = &job.layer.Header;
+		submitFrame(session, job.frameIndex, &job.viewScale, &headerList, 1);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		{
+			lock_guard<mutex> guard(lock);
+			submitSeconds += seconds;
+		}
+	}
+	glfwMakeContextCurrent(nullptr);
+}
+
+// How long the stand-in compositor blocks each submit
+static double standInSubmitMs = 0.0;
+
+static ovrResult OVR_CDECL standInCommit(ovrSession session, ovrTextureSwapChain chain)
+{
+	return ovrSuccess;
+}
+
+static ovrResult OVR_CDECL standInSubmit(ovrSession session, long long frameIndex, const ovrViewScaleDesc* viewScaleDesc,
+	ovrLayerHeader const * const * layerPtrList, unsigned int layerCount)
+{
+	this_thread::sleep_for(chrono::duration<double, milli>(standInSubmitMs));
+	return ovrSuccess;
+}
+
+// Keeps the calling thread busy for ms, as work on it would
+static void spin(double ms)
+{
+	auto end = chrono::steady_clock::now() + chrono::duration<double, milli>(ms);
+	while (chrono::steady_clock::now() < end) {}
+}
+
+SubmitBenchResult benchmarkSubmit(GLFWwindow* shared, bool async, int frames, double submitMs, double renderMs, double otherMs)
+{
+	standInSubmitMs = submitMs;
+	FrameSubmitter submitter;
+	submitter.commitChain = standInCommit;
+	submitter.submitFrame = standInSubmit;
+	if (async)
+		submitter.start(nullptr, nullptr, shared);
+
+	ovrLayerEyeFov layer;
+	memset(&layer, 0, sizeof(layer));
+	layer.Header.Type = ovrLayerType_EyeFov;
+	ovrViewScaleDesc viewScale;
+	memset(&viewScale, 0, sizeof(viewScale));
+	double blocked = 0.0;
+	auto start = chrono::steady_clock::now();
+	for (long long frame = 0; frame < frames; frame++) {
+		spin(otherMs);
+		if (async)
+			blocked += submitter.waitForChain();
+		spin(renderMs);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (async) {
+			blocked += submitter.submit(frame, layer, viewScale);
+		}
+		else {
+			auto submitStart = chrono::steady_clock::now();
+			ovrLayerHeader* headerList = &layer.Header;
+			standInCommit(nullptr, nullptr);
+			standInSubmit(nullptr, frame, &viewScale, &headerList, 1);
+			blocked += chrono::duration<double>(chrono::steady_clock::now() - submitStart).count();
+		}
+	}
+
+	SubmitBenchResult result;
+	result.frameMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / frames;
+	result.blockedMs = blocked * 1000.0 / frames;
+	submitter.stop();
+	return result;
+}
\ No newline at end of file
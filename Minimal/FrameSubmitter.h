@@ -0,0 +1,83 @@
+#pragma once
+// Std. Includes
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <OVR_CAPI.h>
+
+// Commits the eye swap chain and submits frames to the compositor on a thread of its own, so
+// the GL thread doesn't sit in ovr_SubmitFrame while the compositor paces it. The submit thread
+// runs a hidden window's context that shares objects with the GL thread's; a rendered frame is
+// handed over with a fence the submit thread waits on before committing. One frame is in flight:
+// the GL thread can update and render the next one while the last is being submitted, but only
+// starts rendering into the chain once the last frame's texture has been committed.
+class FrameSubmitter {
+public:
+	typedef ovrResult (OVR_CDECL *CommitFunction)(ovrSession session, ovrTextureSwapChain chain);
+	typedef ovrResult (OVR_CDECL *SubmitFunction)(ovrSession session, long long frameIndex, const ovrViewScaleDesc* viewScaleDesc,
+		ovrLayerHeader const * const * layerPtrList, unsigned int layerCount);
+
+	// The compositor's calls the submit thread makes; benchmarkSubmit swaps in stand-ins
+	CommitFunction commitChain = ovr_CommitTextureSwapChain;
+	SubmitFunction submitFrame = ovr_SubmitFrame;
+
+	~FrameSubmitter();
+
+	// shared is a context sharing objects with the one the chain's textures were made in
+	void start(ovrSession session, ovrTextureSwapChain chain, GLFWwindow* shared);
+	// Submits what was handed over, then stops
+	void stop();
+	bool running() const { return worker.joinable(); }
+
+	// GL thread, before rendering into the chain: waits until every frame handed over has been
+	// committed, so the chain's current texture is free. Returns the seconds waited.
+	double waitForChain();
+	// GL thread, after rendering: hands the frame over. frameIndex is the one its eye poses were
+	// predicted for. Waits while the previous frame hasn't been picked up; returns seconds waited.
+	double submit(long long frameIndex, const ovrLayerEyeFov& layer, const ovrViewScaleDesc& viewScale);
+
+	// Seconds the submit thread spent blocked in ovr_SubmitFrame since last asked
+	double takeSubmitSeconds();
+
+private:
+	struct Job {
+		long long frameIndex;
+		ovrLayerEyeFov layer;
+		ovrViewScaleDesc viewScale;
+		GLsync fence;
+	};
+
+	ovrSession session = nullptr;
+	ovrTextureSwapChain chain = nullptr;
+	GLFWwindow* context = nullptr;
+
+	mutex lock;
+	condition_variable changed;
+	Job pending;
+	bool hasPending = false;
+	// Frames handed over and frames committed, counted alike
+	long long handed = 0;
+	long long committed = 0;
+	double submitSeconds = 0.0;
+	bool quit = false;
+	thread worker;
+
+	void run();
+};
+
+// Frame time, and the part of it the GL thread was held up by submission, in milliseconds
+struct SubmitBenchResult {
+	double frameMs = 0.0;
+	double blockedMs = 0.0;
+};
+
+// Runs frames frames as RiftApp draws them, against a stand-in compositor whose submit blocks
+// for submitMs: otherMs of update on the GL thread, then renderMs of rendering ending in a
+// clear of the current context's framebuffer, then commit and submit. async submits through a
+// FrameSubmitter whose thread runs shared, a context sharing objects with the current one.
+SubmitBenchResult benchmarkSubmit(GLFWwindow* shared, bool async, int frames, double submitMs, double renderMs, double otherMs);
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+
+void GeometryPool::init(size_t vertexCapacity, size_t indexCapacity)
+{
+	this->vertexCapacity = std::max<size_t>(vertexCapacity, 1);
+	this->indexCapacity = std::max<size_t>(indexCapacity, 1);
+	glGenVertexArrays(1, &this->VAO);
+	glGenBuffers(1, &this->VBO);
+	glGenBuffers(1, &this->EBO);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->VBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, this->vertexCapacity * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBO);
+	glBufferData(GL_COPY_WRITE_BUFFER, this->indexCapacity * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	this->bindBuffers();
+}
+
+void GeometryPool::add(Mesh& mesh)
+{
+	this->reserve(mesh);
+	this->copy(mesh, 0, uploadBytes(mesh));
+	this->finish(mesh);
+}
+
+void GeometryPool::reserve(Mesh& mesh)
+{
+	if (this->VAO == 0)
+		this->init(mesh.vertexCount, mesh.indexCount);
+	if (uploadBytes(mesh) == 0) {
+		mesh.setupShared(this->VAO, 0, 0);
+		return;
+	}
+
+	size_t firstVertex = this->allocate(this->freeVertices, this->vertexEnd, this->vertexCapacity, mesh.vertices.size());
+	if (firstVertex == this->vertexCapacity) {
+		// Double on overflow so a run of adds only copies a logarithmic number of times
+		size_t capacity = std::max(this->vertexCapacity * 2, this->vertexEnd + mesh.vertices.size());
+		this->grow(this->VBO, this->vertexEnd * sizeof(Vertex), capacity * sizeof(Vertex));
+		this->vertexCapacity = capacity;
+		this->bindBuffers();
+		firstVertex = this->allocate(this->freeVertices, this->vertexEnd, this->vertexCapacity, mesh.vertices.size());
+	}
+	size_t firstIndex = this->allocate(this->freeIndices, this->indexEnd, this->indexCapacity, mesh.indices.size());
+	if (firstIndex == this->indexCapacity) {
+		size_t capacity = std::max(this->indexCapacity * 2, this->indexEnd + mesh.indices.size());
+		this->grow(this->EBO, this->indexEnd * sizeof(GLuint), capacity * sizeof(GLuint));
+		this->indexCapacity = capacity;
+		this->bindBuffers();
+		firstIndex = this->allocate(this->freeIndices, this->indexEnd, this->indexCapacity, mesh.indices.size());
+	}
+
+	mesh.setupShared(this->VAO, (GLint)firstVertex, (GLuint)firstIndex);
+	this->vertexCount += mesh.vertexCount;
+	this->indexCount += mesh.indexCount;
+}
+
+size_t GeometryPool::copy(const Mesh& mesh, size_t offset, size_t maxBytes)
+{
+	const size_t vertexBytes = mesh.vertices.size() * sizeof(Vertex);
+	const size_t end = std::min(offset + maxBytes, uploadBytes(mesh));
+	const size_t start = offset;
+	if (offset < end && offset < vertexBytes) {
+		size_t bytes = std::min(end, vertexBytes) - offset;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->VBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.baseVertex * sizeof(Vertex) + offset, bytes, (const char*)&mesh.vertices[0] + offset);
+		offset += bytes;
+	}
+	if (offset < end) {
+		size_t at = offset - vertexBytes;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstIndex * sizeof(GLuint) + at, end - offset, (const char*)&mesh.indices[0] + at);
+		offset = end;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return offset - start;
+}
+
+void GeometryPool::finish(Mesh& mesh)
+{
+	mesh.releaseCpuCopy();
+}
+
+void GeometryPool::remove(Mesh& mesh)
+{
+	if (uploadBytes(mesh) == 0) {
+		mesh.setupShared(0, 0, 0);
+		return;
+	}
+	this->deallocate(this->freeVertices, this->vertexEnd, mesh.baseVertex, mesh.vertexCount);
+	this->deallocate(this->freeIndices, this->indexEnd, mesh.firstIndex, mesh.indexCount);
+	this->vertexCount -= mesh.vertexCount;
+	this->indexCount -= mesh.indexCount;
+	mesh.setupShared(0, 0, 0);
+}
+
+void GeometryPool::release()
+{
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteBuffers(1, &this->VBO);
+	glDeleteBuffers(1, &this->EBO);
+	this->VAO = this->VBO = this->EBO = 0;
+	this->vertexCount = this->vertexEnd = this->vertexCapacity = 0;
+	this->indexCount = this->indexEnd = this->indexCapacity = 0;
+	this->freeVertices.clear();
+	this->freeIndices.clear();
+}
+
+size_t GeometryPool::allocate(vector<Range>& free, size_t& end, size_t capacity, size_t count)
+{
+	for (size_t i = 0; i < free.size(); i++) {
+		if (free[i].count < count)
+			continue;
+		size_t first = free[i].first;
+		free[i].first += count;
+		free[i].count -= count;
+		if (free[i].count == 0)
+			free.erase(free.begin() + i);
+		return first;
+	}
+	if (end + count > capacity)
+		return capacity;
+	end += count;
+	return end - count;
+}
+
+void GeometryPool::deallocate(vector<Range>& free, size_t& end, size_t first, size_t count)
+{
+	// Keep the holes sorted and merged with their neighbours
+	auto next = std::lower_bound(free.begin(), free.end(), first, [](const Range& r, size_t f) { return r.first < f; });
+	if (next != free.end() && first + count == next->first) {
+		next->first = first;
+		next->count += count;
+	}
+	else {
+		Range range = { first, count };
+		next = free.insert(next, range);
+	}
+	if (next != free.begin()) {
+		auto prev = next - 1;
+		if (prev->first + prev->count == next->first) {
+			prev->count += next->count;
+			next = free.erase(next) - 1;
+		}
+	}
+	// A hole at the end just gives the space back
+	if (next->first + next->count == end) {
+		end = next->first;
+		free.erase(next);
+	}
+}
+
+// Replaces buffer with a bigger one holding the same first usedBytes, copied on the GPU
+void GeometryPool::grow(GLuint& buffer, size_t usedBytes, size_t newBytes)
+{
+	GLuint bigger;
+	glGenBuffers(1, &bigger);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+	glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
+	buffer = bigger;
+}
+
+void GeometryPool::bindBuffers()
+{
+	glBindVertexArray(this->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+	setVertexLayout<Vertex>();
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
+	glBindVertexArray(0);
+}
\ No newline at end of file
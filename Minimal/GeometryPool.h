@@ -0,0 +1,56 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+
+#include "Mesh.h"
+
+// One vertex buffer and one index buffer that many meshes are packed into, all drawn
+// through a single VAO with base vertex offsets. Removed meshes leave holes that later
+// adds reuse first fit, so streaming models in and out doesn't grow the buffers forever.
+class GeometryPool {
+public:
+	GLuint VAO = 0;
+
+	// Creates the buffers with room for the given number of vertices and indices
+	void init(size_t vertexCapacity, size_t indexCapacity);
+	// Copies a mesh into the pool, growing it if needed, and points the mesh at it. The mesh
+	// needs its CPU copy, which is released afterwards unless retained.
+	void add(Mesh& mesh);
+	// add in steps, for uploads spread over frames: reserve makes room and points the mesh at
+	// it, copy writes up to maxBytes of its vertices then indices from byte offset and returns
+	// how many it wrote, and finish, once all uploadBytes are written, releases the CPU copy.
+	// The mesh must not be drawn before it is finished.
+	void reserve(Mesh& mesh);
+	size_t copy(const Mesh& mesh, size_t offset, size_t maxBytes);
+	void finish(Mesh& mesh);
+	// Bytes copy writes for a mesh in all; a mesh without vertices or indices takes no space
+	static size_t uploadBytes(const Mesh& mesh) { return mesh.vertexCount && mesh.indexCount ? mesh.gpuBytes() : 0; }
+	// Frees the space of a mesh added earlier. It must not be drawn until added again, which
+	// takes a CPU copy it may no longer have.
+	void remove(Mesh& mesh);
+	void release();
+
+	size_t usedBytes() const { return vertexCount * sizeof(Vertex) + indexCount * sizeof(GLuint); }
+	size_t capacityBytes() const { return vertexCapacity * sizeof(Vertex) + indexCapacity * sizeof(GLuint); }
+
+private:
+	// A run of free elements
+	struct Range {
+		size_t first, count;
+	};
+
+	GLuint VBO = 0, EBO = 0;
+	// Elements in use, and one past the last element ever handed out
+	size_t vertexCount = 0, vertexEnd = 0, vertexCapacity = 0;
+	size_t indexCount = 0, indexEnd = 0, indexCapacity = 0;
+	vector<Range> freeVertices, freeIndices;
+
+	// First fit out of the holes, else off the end. Returns capacity if the end is too short.
+	size_t allocate(vector<Range>& free, size_t& end, size_t capacity, size_t count);
+	void deallocate(vector<Range>& free, size_t& end, size_t first, size_t count);
+	void grow(GLuint& buffer, size_t usedBytes, size_t newBytes);
+	void bindBuffers();
+};
\ No newline at end of file
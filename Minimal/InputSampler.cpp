@@ -0,0 +1,166 @@
+#define NOMINMAX
+#include <Windows.h>
+#include <mmsystem.h>
+
+#include "InputSampler.h"
+
+#include <chrono>
+#include <cmath>
+
+const size_t InputSampler::HISTORY;
+
+InputSampler::~InputSampler()
+{
+	stop();
+}
+
+void InputSampler::start(ovrSession session, int rateHz)
+{
+	stop();
+	this->session = session;
+	this->rateHz = rateHz;
+	quit = false;
+	worker = thread(&InputSampler::run, this);
+}
+
+void InputSampler::stop()
+{
+	if (!worker.joinable())
+		return;
+	quit = true;
+	worker.join();
+}
+
+void InputSampler::run()
+{
+	// Sleeps are only as fine as the system timer, 15.6 ms unless asked for better
+	timeBeginPeriod(1);
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+	auto period = std::chrono::microseconds(1000000 / rateHz);
+	auto next = std::chrono::steady_clock::now();
+	InputSample sample;
+	while (!quit) {
+		sample.time = ovr_GetTimeInSeconds();
+		ovrTrackingState tracking = ovr_GetTrackingState(session, sample.time, ovrFalse);
+		sample.hands[ovrHand_Left] = tracking.HandPoses[ovrHand_Left].ThePose;
+		sample.hands[ovrHand_Right] = tracking.HandPoses[ovrHand_Right].ThePose;
+		// On failure the buttons stay as last read
+		ovrInputState input;
+		if (OVR_SUCCESS(ovr_GetInputState(session, ovrControllerType_Touch, &input))) {
+			sample.indexTrigger[ovrHand_Left] = input.IndexTrigger[ovrHand_Left];
+			sample.indexTrigger[ovrHand_Right] = input.IndexTrigger[ovrHand_Right];
+			sample.buttons = input.Buttons;
+		}
+
+		uint64_t n = written.load(memory_order_relaxed);
+		ring[n % HISTORY] = sample;
+		written.store(n + 1, memory_order_release);
+
+		// Fall behind by more than a period (a stall, a breakpoint) and the schedule restarts from now
+		next += period;
+		auto now = std::chrono::steady_clock::now();
+		if (next < now - period)
+			next = now;
+		std::this_thread::sleep_until(next);
+	}
+	timeEndPeriod(1);
+}
+
+bool InputSampler::read(uint64_t n, InputSample& out) const
+{
+	uint64_t count = written.load(memory_order_acquire);
+	if (n >= count || count - n > HISTORY)
+		return false;
+	out = ring[n % HISTORY];
+	// The writer fills ring[n % HISTORY] again as sample n + HISTORY, which it starts once
+	// n + HISTORY samples are written; if that's reached during the copy, the copy is torn
+	atomic_thread_fence(memory_order_acquire);
+	return written.load(memory_order_relaxed) < n + HISTORY;
+}
+
+bool InputSampler::latest(InputSample& out) const
+{
+	uint64_t count = written.load(memory_order_acquire);
+	return count > 0 && read(count - 1, out);
+}
+
+// Linear for positions, normalized linear for orientations, which barely turn in a millisecond
+static ovrPosef interpolate(const ovrPosef& a, const ovrPosef& b, float t)
+{
+	ovrPosef pose;
+	pose.Position.x = a.Position.x + (b.Position.x - a.Position.x) * t;
+	pose.Position.y = a.Position.y + (b.Position.y - a.Position.y) * t;
+	pose.Position.z = a.Position.z + (b.Position.z - a.Position.z) * t;
+	const ovrQuatf& p = a.Orientation;
+	ovrQuatf q = b.Orientation;
+	// Same hemisphere, or it goes the long way round
+	if (p.x * q.x + p.y * q.y + p.z * q.z + p.w * q.w < 0.0f) {
+		q.x = -q.x;
+		q.y = -q.y;
+		q.z = -q.z;
+		q.w = -q.w;
+	}
+	ovrQuatf r;
+	r.x = p.x + (q.x - p.x) * t;
+	r.y = p.y + (q.y - p.y) * t;
+	r.z = p.z + (q.z - p.z) * t;
+	r.w = p.w + (q.w - p.w) * t;
+	float length = sqrtf(r.x * r.x + r.y * r.y + r.z * r.z + r.w * r.w);
+	r.x /= length;
+	r.y /= length;
+	r.z /= length;
+	r.w /= length;
+	pose.Orientation = r;
+	return pose;
+}
+
+bool InputSampler::at(double time, InputSample& out) const
+{
+	uint64_t count = written.load(memory_order_acquire);
+	InputSample newer;
+	if (count == 0 || !read(count - 1, newer))
+		return false;
+	if (time >= newer.time) {
+		out = newer;
+		return true;
+	}
+	// Recent times are what's asked for, so walk back from the newest
+	for (uint64_t n = count - 1; n-- > 0;) {
+		InputSample older;
+		if (!read(n, older))
+			break;
+		if (older.time <= time) {
+			float t = float((time - older.time) / (newer.time - older.time));
+			out = older;
+			out.time = time;
+			for (int hand = 0; hand < 2; hand++) {
+				out.hands[hand] = interpolate(older.hands[hand], newer.hands[hand], t);
+				out.indexTrigger[hand] = older.indexTrigger[hand] + (newer.indexTrigger[hand] - older.indexTrigger[hand]) * t;
+			}
+			return true;
+		}
+		newer = older;
+	}
+	// Older than anything kept
+	out = newer;
+	return true;
+}
+
+size_t InputSampler::since(double time, vector<InputSample>& out) const
+{
+	uint64_t count = written.load(memory_order_acquire);
+	uint64_t first = count;
+	InputSample sample;
+	// Find the oldest sample newer than time, then copy forward from it
+	while (first > 0 && count - first < HISTORY - 1 && read(first - 1, sample) && sample.time > time)
+		first--;
+	size_t added = 0;
+	for (uint64_t n = first; n < count; n++) {
+		if (!read(n, sample))
+			continue;
+		out.push_back(sample);
+		added++;
+	}
+	return added;
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+// Std. Includes
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include <OVR_CAPI.h>
+
+// Controller state at one instant
+struct InputSample {
+	// ovr_GetTimeInSeconds when it was read
+	double time = 0.0;
+	ovrPosef hands[2];
+	float indexTrigger[2] = { 0.0f, 0.0f };
+	unsigned int buttons = 0;
+};
+
+// Polls the Touch controllers on a thread of its own, many times a frame, into a ring of
+// timestamped samples. There is one writer, the polling thread, and readers never lock or
+// wait: they copy samples out and then check the writer hasn't lapped them while they did,
+// throwing away anything it may have overwritten. The ring holds the last HISTORY samples,
+// about a second at the highest rate.
+class InputSampler {
+public:
+	static const size_t HISTORY = 1024;
+
+	~InputSampler();
+
+	// rateHz between 500 and 1000 keeps sub-frame detail without burning a core
+	void start(ovrSession session, int rateHz);
+	void stop();
+
+	// Newest sample; false before the first
+	bool latest(InputSample& out) const;
+	// State at time, interpolated between the samples around it; clamps to the oldest and
+	// newest kept. False if there are no samples yet.
+	bool at(double time, InputSample& out) const;
+	// Appends every sample newer than time, oldest first, and returns how many
+	size_t since(double time, vector<InputSample>& out) const;
+
+private:
+	InputSample ring[HISTORY];
+	// Samples ever written; sample n lives in ring[n % HISTORY]
+	atomic<uint64_t> written{ 0 };
+
+	ovrSession session = nullptr;
+	int rateHz = 1000;
+	thread worker;
+	atomic<bool> quit{ false };
+
+	void run();
+	// Copies sample n out; false if the writer has overwritten or may be overwriting it
+	bool read(uint64_t n, InputSample& out) const;
+};
\ No newline at end of file
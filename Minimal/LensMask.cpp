@@ -0,0 +1,113 @@
+#include "LensMask.h"
+#include "Shader.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr VertexAttribute VertexLayout<MaskVertex>::attributes[];
+
+// How far past the ellipse the ring reaches in normalized device coordinates: beyond any
+// corner of the viewport, whichever way the ellipse is off center
+static const float RING_REACH = 4.0f;
+
+void LensMask::init(const ovrFovPort fov[2])
+{
+	this->shader = LoadShaders("lens_mask.vert", "lens_mask.frag", vertexInputs<MaskVertex>());
+	glGenVertexArrays(2, this->VAO);
+	glGenBuffers(2, this->VBO);
+	glGenQueries(2, this->queries);
+
+	const int segments = std::max(this->profile.segments, 8);
+	for (int eye = 0; eye < 2; eye++) {
+		// Left, right, up and down tangents, and the ellipse in them
+		glm::vec4 t(fov[eye].LeftTan, fov[eye].RightTan, fov[eye].UpTan, fov[eye].DownTan);
+		this->tangents[eye] = t;
+		this->center[eye] = this->profile.center;
+		this->radius[eye] = this->profile.scale * glm::vec2(std::max(t.x, t.y), std::max(t.z, t.w));
+		auto toNdc = [t](glm::vec2 tangent) {
+			return glm::vec2((tangent.x + t.x) / (t.x + t.y) * 2.0f - 1.0f, (tangent.y + t.w) / (t.z + t.w) * 2.0f - 1.0f);
+		};
+
+		// A strip from the ellipse outward, a pair of vertices for each edge's end
+		glm::vec2 middle = toNdc(this->center[eye]);
+		vector<MaskVertex> ring;
+		for (int i = 0; i <= segments; i++) {
+			float angle = 2.0f * 3.14159265f * (i % segments) / segments;
+			glm::vec2 inner = toNdc(this->center[eye] + this->radius[eye] * glm::vec2(cosf(angle), sinf(angle)));
+			MaskVertex vertex;
+			vertex.Position = inner;
+			ring.push_back(vertex);
+			vertex.Position = middle + glm::normalize(inner - middle) * RING_REACH;
+			ring.push_back(vertex);
+		}
+		this->vertexCount = (GLsizei)ring.size();
+
+		glBindVertexArray(this->VAO[eye]);
+		glBindBuffer(GL_ARRAY_BUFFER, this->VBO[eye]);
+		glBufferData(GL_ARRAY_BUFFER, ring.size() * sizeof(MaskVertex), &ring[0], GL_STATIC_DRAW);
+		setVertexLayout<MaskVertex>();
+		glBindVertexArray(0);
+	}
+}
+
+void LensMask::release()
+{
+	glDeleteQueries(2, this->queries);
+	glDeleteBuffers(2, this->VBO);
+	glDeleteVertexArrays(2, this->VAO);
+	glDeleteProgram(this->shader);
+	this->shader = 0;
+}
+
+void LensMask::draw(int eye)
+{
+	if (!this->enabled || !this->shader)
+		return;
+	// The count of the last query, if the GPU has it; the mask is counted again once it's in
+	if (this->counting[eye]) {
+		GLuint available = 0;
+		glGetQueryObjectuiv(this->queries[eye], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 passed = 0;
+			glGetQueryObjectui64v(this->queries[eye], GL_QUERY_RESULT, &passed);
+			this->samples[eye] = passed;
+			this->counting[eye] = false;
+		}
+	}
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glUseProgram(this->shader);
+	glBindVertexArray(this->VAO[eye]);
+	bool count = !this->counting[eye];
+	if (count)
+		glBeginQuery(GL_SAMPLES_PASSED, this->queries[eye]);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, this->vertexCount);
+	if (count) {
+		glEndQuery(GL_SAMPLES_PASSED);
+		this->counting[eye] = true;
+	}
+	glBindVertexArray(0);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+bool LensMask::visible(int eye, glm::vec2 tangent) const
+{
+	glm::vec2 d = (tangent - this->center[eye]) / this->radius[eye];
+	return glm::dot(d, d) <= 1.0f;
+}
+
+double LensMask::hiddenFraction(int eye, glm::uvec2 size) const
+{
+	if (size.x == 0 || size.y == 0)
+		return 0.0;
+	const glm::vec4& t = this->tangents[eye];
+	uint64_t hidden = 0;
+	for (unsigned y = 0; y < size.y; y++) {
+		float ty = (y + 0.5f) / size.y * (t.z + t.w) - t.w;
+		for (unsigned x = 0; x < size.x; x++) {
+			float tx = (x + 0.5f) / size.x * (t.x + t.y) - t.x;
+			hidden += !visible(eye, glm::vec2(tx, ty));
+		}
+	}
+	return (double)hidden / ((double)size.x * size.y);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <OVR_CAPI.h>
+
+#include "VertexLayout.h"
+
+// The mask's corners are in normalized device coordinates of the eye's viewport
+struct MaskVertex {
+	glm::vec2 Position;
+};
+
+template <> struct VertexLayout<MaskVertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(MaskVertex, Position, "position", 0),
+	};
+};
+static_assert(checkVertexLayout<MaskVertex>(true), "MaskVertex attributes don't cover MaskVertex exactly");
+
+// The part of the eye's field of view the lens shows: an ellipse in tangent space around the
+// lens axis plus center, with semi-axes scale times the widest tangent of the fov on each axis
+struct LensProfile {
+	glm::vec2 center = glm::vec2(0.0f);
+	glm::vec2 scale = glm::vec2(1.12f);
+	// Edges the ellipse is drawn with
+	int segments = 64;
+};
+
+// Covers what each eye's lens doesn't show with depth at the near plane before the eye is
+// drawn, so the depth test throws those pixels away before they are shaded. SDK 1.13 has no
+// hidden area mesh, so the mask comes from the fov and a LensProfile.
+class LensMask {
+public:
+	LensProfile profile;
+	bool enabled = true;
+
+	// Compiles lens_mask.vert and lens_mask.frag and builds each eye's mask
+	void init(const ovrFovPort fov[2]);
+	void release();
+
+	// Into the depth of the bound framebuffer's viewport, eye 0 or 1, with the depth test on; color is left alone
+	void draw(int eye);
+	// The share of a size pixel eye viewport the mask covers, counted pixel by pixel
+	double hiddenFraction(int eye, glm::uvec2 size) const;
+	// Pixels the mask covered the last time the GPU counted them, which it does every few frames
+	uint64_t hiddenSamples(int eye) const { return this->samples[eye]; }
+
+private:
+	GLuint shader = 0;
+	GLuint VAO[2] = { 0, 0 }, VBO[2] = { 0, 0 };
+	GLsizei vertexCount = 0;
+	// Each eye's ellipse in tangent space, for hiddenFraction
+	glm::vec4 tangents[2];
+	glm::vec2 center[2], radius[2];
+	GLuint queries[2] = { 0, 0 };
+	bool counting[2] = { false, false };
+	uint64_t samples[2] = { 0, 0 };
+
+	bool visible(int eye, glm::vec2 tangent) const;
+};
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Line.h"
 
+constexpr VertexAttribute VertexLayout<LineVertex>::attributes[];
+
 Line::Line(vector <GLfloat> coords) {
 	this->coords = coords;
 	transform = glm::mat4(1.0f);
@@ -13,9 +15,7 @@ Line::Line(vector <GLfloat> coords) {
 	glBufferData(GL_ARRAY_BUFFER, this->coords.size() * sizeof(GLfloat), &(this->coords[0]), GL_STATIC_DRAW);
 
 	// Set the vertex attribute pointers
-	// Vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (GLvoid*)0);
+	setVertexLayout<LineVertex>();
 	//glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 }
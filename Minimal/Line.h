@@ -1,6 +1,19 @@
 #pragma once
 
 #include "Model.h"
+#include "VertexLayout.h"
+
+// Line endpoints are packed xyz triples
+struct LineVertex {
+	glm::vec3 Position;
+};
+
+template <> struct VertexLayout<LineVertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(LineVertex, Position, "position", 0),
+	};
+};
+static_assert(checkVertexLayout<LineVertex>(true), "LineVertex attributes don't cover LineVertex exactly");
 
 class Line {
 public:
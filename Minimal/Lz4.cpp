@@ -0,0 +1,144 @@
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+// Shortest match the format can encode
+static const size_t MIN_MATCH = 4;
+// The last five bytes are always literals, and the last match starts twelve bytes before the end
+static const size_t LAST_LITERALS = 5;
+static const size_t MATCH_LIMIT = 12;
+// Matches reach at most this far back, the largest offset in two bytes
+static const size_t MAX_OFFSET = 65535;
+// Positions remembered by the hash of their first four bytes
+static const int HASH_BITS = 12;
+
+static uint32_t read32(const unsigned char* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static size_t hashOf(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Lengths of 15 and over continue in bytes of 255 until one is less
+static void writeLength(unsigned char*& op, size_t length)
+{
+	for (; length >= 255; length -= 255)
+		*op++ = 255;
+	*op++ = (unsigned char)length;
+}
+
+static bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+{
+	unsigned char byte;
+	do {
+		if (ip == end)
+			return false;
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+// One sequence: a run of literals, then a match unless it is the last sequence
+static bool emit(unsigned char*& op, const unsigned char* end, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+	size_t need = 1 + literalCount / 255 + 1 + literalCount + (matchLength ? 2 + (matchLength - MIN_MATCH) / 255 + 1 : 0);
+	if (need > (size_t)(end - op))
+		return false;
+	unsigned char* token = op++;
+	*token = (unsigned char)(std::min(literalCount, (size_t)15) << 4);
+	if (literalCount >= 15)
+		writeLength(op, literalCount - 15);
+	memcpy(op, literals, literalCount);
+	op += literalCount;
+	if (!matchLength)
+		return true;
+	*op++ = (unsigned char)(offset & 0xff);
+	*op++ = (unsigned char)(offset >> 8);
+	size_t extra = matchLength - MIN_MATCH;
+	*token |= (unsigned char)std::min(extra, (size_t)15);
+	if (extra >= 15)
+		writeLength(op, extra - 15);
+	return true;
+}
+
+size_t lz4Compress(const char* source, size_t size, char* destination, size_t capacity)
+{
+	const unsigned char* src = (const unsigned char*)source;
+	unsigned char* op = (unsigned char*)destination;
+	const unsigned char* end = op + capacity;
+
+	// Greedy: take the first match the table offers, as the reference fast mode does
+	int64_t table[1 << HASH_BITS];
+	std::fill(table, table + (1 << HASH_BITS), (int64_t)-1);
+	size_t anchor = 0;
+	for (size_t i = 0; i + MATCH_LIMIT <= size;) {
+		uint32_t sequence = read32(src + i);
+		size_t slot = hashOf(sequence);
+		int64_t candidate = table[slot];
+		table[slot] = (int64_t)i;
+		if (candidate < 0 || i - (size_t)candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+			i++;
+			continue;
+		}
+		size_t length = MIN_MATCH;
+		while (i + length < size - LAST_LITERALS && src[candidate + length] == src[i + length])
+			length++;
+		if (!emit(op, end, src + anchor, i - anchor, i - (size_t)candidate, length))
+			return 0;
+		i += length;
+		anchor = i;
+	}
+	if (!emit(op, end, src + anchor, size - anchor, 0, 0))
+		return 0;
+	return op - (unsigned char*)destination;
+}
+
+bool lz4Decompress(const char* source, size_t stored, char* destination, size_t size)
+{
+	const unsigned char* ip = (const unsigned char*)source;
+	const unsigned char* inEnd = ip + stored;
+	unsigned char* out = (unsigned char*)destination;
+	unsigned char* op = out;
+	unsigned char* outEnd = out + size;
+	while (ip < inEnd) {
+		unsigned token = *ip++;
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(ip, inEnd, literals))
+			return false;
+		if (literals > (size_t)(inEnd - ip) || literals > (size_t)(outEnd - op))
+			return false;
+		memcpy(op, ip, literals);
+		ip += literals;
+		op += literals;
+		// The last sequence ends with its literals
+		if (ip == inEnd)
+			break;
+
+		if (inEnd - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - out))
+			return false;
+		size_t length = token & 15;
+		if (length == 15 && !readLength(ip, inEnd, length))
+			return false;
+		length += MIN_MATCH;
+		if (length > (size_t)(outEnd - op))
+			return false;
+		// Byte by byte, since a match may overlap what it is copying
+		const unsigned char* match = op - offset;
+		for (size_t k = 0; k < length; k++)
+			op[k] = match[k];
+		op += length;
+	}
+	return op == outEnd;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+// Std. Includes
+#include <cstddef>
+
+// The LZ4 block format, on its own: no frame, no checksums. Blocks written here read back
+// with any LZ4 decoder, and the other way around, so the cooker could switch to the
+// reference library without a format change.
+
+// Largest output lz4Compress may need for size bytes of input
+inline size_t lz4Bound(size_t size) { return size + size / 255 + 16; }
+
+// Compresses size bytes of src into dst. Returns the compressed size, or 0 if it didn't
+// fit in capacity, which for incompressible data is the sign to store the block raw.
+size_t lz4Compress(const char* src, size_t size, char* dst, size_t capacity);
+
+// Decompresses one block of exactly size bytes from its stored bytes. False if the block
+// is damaged or doesn't decompress to size; dst is left partly written in that case.
+bool lz4Decompress(const char* src, size_t stored, char* dst, size_t size);
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "Mesh.h"
 
+constexpr VertexAttribute VertexLayout<Vertex>::attributes[];
+
 // Render the mesh
 void Mesh::Draw(GLuint shader)
 {
@@ -33,7 +35,7 @@ void Mesh::Draw(GLuint shader)
 
 	// Draw mesh
 	glBindVertexArray(this->VAO);
-	glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+	glDrawElementsBaseVertex(GL_TRIANGLES, this->indexCount, GL_UNSIGNED_INT, (GLvoid*)(this->firstIndex * sizeof(GLuint)), this->baseVertex);
 	glBindVertexArray(0);
 
 	// Always good practice to set everything back to defaults once configured.
@@ -64,15 +66,57 @@ void Mesh::setupMesh()
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
 
 	// Set the vertex attribute pointers
-	// Vertex Positions
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-	// Vertex Normals
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-	// Vertex Texture Coords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
+	setVertexLayout<Vertex>();
 
 	glBindVertexArray(0);
+	this->releaseCpuCopy();
+}
+
+void Mesh::setupShared(GLuint vao, GLint baseVertex, GLuint firstIndex)
+{
+	this->VAO = vao;
+	this->baseVertex = baseVertex;
+	this->firstIndex = firstIndex;
+}
+
+void Mesh::releaseBuffers()
+{
+	if (!this->VBO)
+		return;
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteBuffers(1, &this->VBO);
+	glDeleteBuffers(1, &this->EBO);
+	this->VAO = this->VBO = this->EBO = 0;
+}
+
+void Mesh::releaseCpuCopy()
+{
+	if (this->retain != RETAIN_NONE)
+		return;
+	// Swapped out, clear() alone keeps the capacity
+	vector<Vertex>().swap(this->vertices);
+	vector<GLuint>().swap(this->indices);
+}
+
+size_t Mesh::cpuBytes() const
+{
+	size_t bytes = this->vertices.capacity() * sizeof(Vertex) + this->indices.capacity() * sizeof(GLuint);
+	bytes += this->bvh.nodes.capacity() * sizeof(BVHNode) + this->bvh.triangles.capacity() * sizeof(BVHTriangle);
+	for (const Texture& texture : this->textures)
+		bytes += sizeof(Texture) + texture.type.capacity() + texture.path.capacity();
+	return bytes;
+}
+
+string retentionNames(unsigned retain)
+{
+	static const char* names[] = { "collision", "reupload", "analysis" };
+	string list;
+	for (int i = 0; i < 3; i++) {
+		if (!(retain & (1u << i)))
+			continue;
+		if (!list.empty())
+			list += ", ";
+		list += names[i];
+	}
+	return list.empty() ? "none" : list;
 }
\ No newline at end of file
@@ -16,6 +16,8 @@ using namespace std;
 #include <assimp/postprocess.h>
 
 #include "Shader.h"
+#include "BVH.h"
+#include "VertexLayout.h"
 
 
 struct Vertex {
@@ -27,12 +29,38 @@ struct Vertex {
 	glm::vec2 TexCoords;
 };
 
+template <> struct VertexLayout<Vertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(Vertex, Position, "position", 0),
+		VERTEX_ATTRIBUTE(Vertex, Normal, "normal", 1),
+		VERTEX_ATTRIBUTE(Vertex, TexCoords, "texCoords", 2),
+	};
+};
+static_assert(checkVertexLayout<Vertex>(true), "Vertex attributes don't cover Vertex exactly");
+
 struct Texture {
 	GLuint id;
 	string type;
-	aiString path;
+	// Only as long as the path is; an aiString is a kilobyte whatever it holds
+	string path;
+};
+
+// Why a mesh keeps its vertices and indices in CPU memory once they are on the GPU. Without
+// a reason they are dropped as soon as they are uploaded. Ray picking never needs them, the
+// BVH keeps triangles of its own.
+enum MeshRetention : unsigned {
+	RETAIN_NONE = 0,
+	// Distance fields or other collision built from the model after upload
+	RETAIN_COLLISION = 1,
+	// Uploaded again after being evicted from the GPU
+	RETAIN_REUPLOAD = 2,
+	// Mesh statistics and other tools reading the geometry
+	RETAIN_ANALYSIS = 4,
 };
 
+// "collision, reupload", or "none"
+string retentionNames(unsigned retain);
+
 struct Material {
 	glm::vec3 ambient;
 	glm::vec3 diffuse;
@@ -44,39 +72,83 @@ struct Material {
 class Mesh {
 public:
 	/*  Mesh Data  */
+	// CPU copies, empty once uploaded unless retained; vertexCount and indexCount stay
 	vector<Vertex> vertices;
 	vector<GLuint> indices;
 	vector<Texture> textures;	
 	Material mtl;
+	// Triangle hierarchy for exact ray picking, built once at load
+	MeshBVH bvh;
+	// Where the mesh lives in its index/vertex buffers; non-zero when the buffers are shared
+	GLint baseVertex = 0;
+	GLuint firstIndex = 0;
+	GLsizei indexCount = 0;
+	GLsizei vertexCount = 0;
+	// MeshRetention flags
+	unsigned retain = RETAIN_NONE;
 
 	/*  Functions  */
-	// Constructor
-	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, aiMaterial* mtl)
+	// Constructor. With upload false no GL calls are made, so a mesh can be built on a
+	// worker thread and given buffers later with setupMesh or setupShared.
+	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, aiMaterial* mtl, bool upload = true, unsigned retain = RETAIN_NONE)
+		: Mesh(std::move(vertices), std::move(indices), std::move(textures), toMaterial(mtl), upload, retain)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
-		aiColor3D ambient, diffuse, specular, emission;
-		mtl->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
-		mtl->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
-		mtl->Get(AI_MATKEY_COLOR_SPECULAR, specular);
-		mtl->Get(AI_MATKEY_COLOR_EMISSIVE, emission);
-		this->mtl.ambient = glm::vec3(ambient.r, ambient.g, ambient.b);
-		this->mtl.diffuse = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
-		this->mtl.specular = glm::vec3(specular.r, specular.g, specular.b);
-		this->mtl.emission = glm::vec3(emission.r, emission.g, emission.b);
-		mtl->Get(AI_MATKEY_SHININESS, this->mtl.shininess);
+	}
 
+	// The same from a material already read, as a cooked model stores it
+	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, const Material& mtl, bool upload = true, unsigned retain = RETAIN_NONE)
+	{
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
+		this->textures = std::move(textures);
+		this->indexCount = (GLsizei)this->indices.size();
+		this->vertexCount = (GLsizei)this->vertices.size();
+		this->retain = retain;
+		this->mtl = mtl;
+
+		if (!this->indices.empty())
+			this->bvh.build(&this->vertices[0].Position, sizeof(Vertex), &this->indices[0], this->indices.size());
 
 		// Now that we have all the required data, set the vertex buffers and its attribute pointers.
-		this->setupMesh();
+		if (upload)
+			this->setupMesh();
 	}
 
 	void Draw(GLuint shader);
 
+	// Creates buffers of the mesh's own
+	void setupMesh();
+	// Draws out of a shared VAO instead, from the given offsets into its buffers
+	void setupShared(GLuint vao, GLint baseVertex, GLuint firstIndex);
+
+	// Deletes buffers of the mesh's own; shared ones belong to their pool
+	void releaseBuffers();
+
+	// Frees the CPU copies of the vertices and indices unless something retains them
+	void releaseCpuCopy();
+	bool hasCpuCopy() const { return !this->vertices.empty(); }
+
+	// Bytes held in CPU memory (copies, BVH, textures) and in GPU buffers
+	size_t cpuBytes() const;
+	size_t gpuBytes() const { return this->vertexCount * sizeof(Vertex) + this->indexCount * sizeof(GLuint); }
+
+	static Material toMaterial(aiMaterial* mtl)
+	{
+		Material material;
+		aiColor3D ambient, diffuse, specular, emission;
+		mtl->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
+		mtl->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+		mtl->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+		mtl->Get(AI_MATKEY_COLOR_EMISSIVE, emission);
+		material.ambient = glm::vec3(ambient.r, ambient.g, ambient.b);
+		material.diffuse = glm::vec3(diffuse.r, diffuse.g, diffuse.b);
+		material.specular = glm::vec3(specular.r, specular.g, specular.b);
+		material.emission = glm::vec3(emission.r, emission.g, emission.b);
+		mtl->Get(AI_MATKEY_SHININESS, material.shininess);
+		return material;
+	}
+
 private:
 	/*  Render data  */
-	GLuint VAO, VBO, EBO;
-
-	void setupMesh();
+	GLuint VAO = 0, VBO = 0, EBO = 0;
 };
\ No newline at end of file
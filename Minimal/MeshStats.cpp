@@ -0,0 +1,202 @@
+#include "MeshStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+constexpr VertexAttribute VertexLayout<CompactVertex>::attributes[];
+constexpr VertexAttribute VertexLayout<QuantizedVertex>::attributes[];
+
+// Entries of the simulated post-transform cache; older GPUs had 16, newer ones hold more
+static const size_t CACHE_SIZE = 16;
+// Resolution of the coverage grid overdraw is estimated on
+static const int OVERDRAW_GRID = 64;
+
+static size_t indexBytes(size_t vertices, size_t indices)
+{
+	return indices * (vertices <= 65536 ? sizeof(uint16_t) : sizeof(GLuint));
+}
+
+// Misses of a FIFO cache replaying the index buffer
+static size_t cacheMisses(const vector<GLuint>& indices)
+{
+	GLuint cache[CACHE_SIZE];
+	std::fill(cache, cache + CACHE_SIZE, 0xffffffffu);
+	size_t next = 0, misses = 0;
+	for (GLuint index : indices) {
+		if (std::find(cache, cache + CACHE_SIZE, index) != cache + CACHE_SIZE)
+			continue;
+		cache[next] = index;
+		next = (next + 1) % CACHE_SIZE;
+		misses++;
+	}
+	return misses;
+}
+
+// Vertices equal byte for byte to another, less one for each distinct value
+static size_t duplicateVertices(const vector<Vertex>& vertices)
+{
+	vector<const Vertex*> sorted(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		sorted[i] = &vertices[i];
+	sort(sorted.begin(), sorted.end(), [](const Vertex* a, const Vertex* b) { return memcmp(a, b, sizeof(Vertex)) < 0; });
+	size_t duplicates = 0;
+	for (size_t i = 1; i < sorted.size(); i++)
+		duplicates += memcmp(sorted[i - 1], sorted[i], sizeof(Vertex)) == 0;
+	return duplicates;
+}
+
+// Rasterizes the front faces of every mesh orthographically onto a grid fitted to the bounds,
+// once from each side along each axis, and averages fragments per covered cell
+static float estimateOverdraw(const vector<const Mesh*>& meshes, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	vector<uint32_t> depth(OVERDRAW_GRID * OVERDRAW_GRID);
+	float sum = 0.0f;
+	int views = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		float extentU = boundsMax[u] - boundsMin[u], extentV = boundsMax[v] - boundsMin[v];
+		if (extentU <= 0.0f || extentV <= 0.0f)
+			continue;
+		float scaleU = OVERDRAW_GRID / extentU, scaleV = OVERDRAW_GRID / extentV;
+		for (float side = -1.0f; side <= 1.0f; side += 2.0f) {
+			std::fill(depth.begin(), depth.end(), 0);
+			size_t fragments = 0;
+			for (const Mesh* mesh : meshes) {
+				for (size_t t = 0; t + 2 < mesh->indices.size(); t += 3) {
+					const glm::vec3& a = mesh->vertices[mesh->indices[t]].Position;
+					const glm::vec3& b = mesh->vertices[mesh->indices[t + 1]].Position;
+					const glm::vec3& c = mesh->vertices[mesh->indices[t + 2]].Position;
+					if (glm::cross(b - a, c - a)[axis] * side <= 0.0f)
+						continue;
+					float x[3] = { (a[u] - boundsMin[u]) * scaleU, (b[u] - boundsMin[u]) * scaleU, (c[u] - boundsMin[u]) * scaleU };
+					float y[3] = { (a[v] - boundsMin[v]) * scaleV, (b[v] - boundsMin[v]) * scaleV, (c[v] - boundsMin[v]) * scaleV };
+					float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+					if (area == 0.0f)
+						continue;
+					int x0 = std::max(0, (int)std::min(x[0], std::min(x[1], x[2])));
+					int x1 = std::min(OVERDRAW_GRID - 1, (int)std::max(x[0], std::max(x[1], x[2])));
+					int y0 = std::max(0, (int)std::min(y[0], std::min(y[1], y[2])));
+					int y1 = std::min(OVERDRAW_GRID - 1, (int)std::max(y[0], std::max(y[1], y[2])));
+					for (int py = y0; py <= y1; py++) {
+						for (int px = x0; px <= x1; px++) {
+							// Cell centre inside all three edges, whichever way the triangle winds
+							float cx = px + 0.5f, cy = py + 0.5f;
+							float e0 = ((x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0])) * area;
+							float e1 = ((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) * area;
+							float e2 = ((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) * area;
+							if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+								continue;
+							depth[py * OVERDRAW_GRID + px]++;
+							fragments++;
+						}
+					}
+				}
+			}
+			size_t covered = depth.size() - std::count(depth.begin(), depth.end(), 0u);
+			if (covered == 0)
+				continue;
+			sum += float(fragments) / covered;
+			views++;
+		}
+	}
+	return views ? sum / views : 0.0f;
+}
+
+MeshStats analyzeMesh(const Mesh& mesh)
+{
+	MeshStats stats;
+	stats.vertices = mesh.vertices.size();
+	stats.triangles = mesh.indices.size() / 3;
+	if (stats.vertices == 0)
+		return stats;
+
+	stats.duplicateRatio = float(duplicateVertices(mesh.vertices)) / stats.vertices;
+	size_t misses = cacheMisses(mesh.indices);
+	stats.acmr = stats.triangles ? float(misses) / stats.triangles : 0.0f;
+	stats.atvr = float(misses) / stats.vertices;
+
+	stats.boundsMin = stats.boundsMax = mesh.vertices[0].Position;
+	for (const Vertex& vertex : mesh.vertices) {
+		stats.boundsMin = glm::min(stats.boundsMin, vertex.Position);
+		stats.boundsMax = glm::max(stats.boundsMax, vertex.Position);
+	}
+	stats.overdraw = estimateOverdraw(vector<const Mesh*>(1, &mesh), stats.boundsMin, stats.boundsMax);
+
+	stats.bytes = stats.vertices * sizeof(Vertex) + mesh.indices.size() * sizeof(GLuint);
+	stats.compactBytes = stats.vertices * sizeof(CompactVertex) + indexBytes(stats.vertices, mesh.indices.size());
+	stats.quantizedBytes = stats.vertices * sizeof(QuantizedVertex) + indexBytes(stats.vertices, mesh.indices.size());
+	return stats;
+}
+
+ModelStats analyzeModel(const Model& model, const string& path)
+{
+	ModelStats stats;
+	stats.path = path;
+	vector<const Mesh*> meshes;
+	vector<const Material*> materials;
+	size_t duplicates = 0, misses = 0;
+	MeshStats& total = stats.total;
+	for (const Mesh& mesh : model.getMeshes()) {
+		MeshStats meshStats = analyzeMesh(mesh);
+		stats.meshes.push_back(meshStats);
+		meshes.push_back(&mesh);
+		if (none_of(materials.begin(), materials.end(), [&](const Material* m) { return memcmp(m, &mesh.mtl, sizeof(Material)) == 0; }))
+			materials.push_back(&mesh.mtl);
+		if (meshStats.vertices == 0)
+			continue;
+
+		if (total.vertices == 0) {
+			total.boundsMin = meshStats.boundsMin;
+			total.boundsMax = meshStats.boundsMax;
+		}
+		total.boundsMin = glm::min(total.boundsMin, meshStats.boundsMin);
+		total.boundsMax = glm::max(total.boundsMax, meshStats.boundsMax);
+		total.vertices += meshStats.vertices;
+		total.triangles += meshStats.triangles;
+		duplicates += (size_t)(meshStats.duplicateRatio * meshStats.vertices + 0.5f);
+		misses += (size_t)(meshStats.acmr * meshStats.triangles + 0.5f);
+		total.bytes += meshStats.bytes;
+		total.compactBytes += meshStats.compactBytes;
+		total.quantizedBytes += meshStats.quantizedBytes;
+	}
+	stats.materials = materials.size();
+	if (total.vertices) {
+		total.duplicateRatio = float(duplicates) / total.vertices;
+		total.acmr = total.triangles ? float(misses) / total.triangles : 0.0f;
+		total.atvr = float(misses) / total.vertices;
+		total.overdraw = estimateOverdraw(meshes, total.boundsMin, total.boundsMax);
+	}
+	return stats;
+}
+
+static void printRow(ostream& out, const string& name, const MeshStats& stats)
+{
+	out << "  " << left << setw(8) << name << right
+		<< setw(9) << stats.vertices << setw(9) << stats.triangles
+		<< setw(7) << fixed << setprecision(1) << stats.duplicateRatio * 100.0f << "%"
+		<< setw(7) << setprecision(2) << stats.acmr << setw(7) << stats.atvr << setw(9) << stats.overdraw
+		<< setw(10) << stats.bytes / 1024 << setw(12) << stats.compactBytes / 1024 << setw(12) << stats.quantizedBytes / 1024 << endl;
+}
+
+bool printStats(ostream& out, const ModelStats& stats, size_t triangleBudget)
+{
+	const MeshStats& total = stats.total;
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << stats.path << ": " << stats.meshes.size() << " meshes, " << stats.materials << " materials, bounds ("
+		<< total.boundsMin.x << ", " << total.boundsMin.y << ", " << total.boundsMin.z << ") to ("
+		<< total.boundsMax.x << ", " << total.boundsMax.y << ", " << total.boundsMax.z << ")" << endl;
+	out << "  " << left << setw(8) << "mesh" << right << setw(9) << "verts" << setw(9) << "tris" << setw(8) << "dup" << setw(7) << "ACMR" << setw(7) << "ATVR"
+		<< setw(9) << "overdraw" << setw(10) << "KB" << setw(12) << "KB compact" << setw(12) << "KB quantized" << endl;
+	for (size_t i = 0; i < stats.meshes.size(); i++)
+		printRow(out, to_string(i), stats.meshes[i]);
+	printRow(out, "total", total);
+	out.flags(flags);
+	out.precision(precision);
+
+	bool over = total.triangles > triangleBudget;
+	if (over)
+		out << "  WARNING: " << total.triangles << " triangles, over the budget of " << triangleBudget << " per model" << endl;
+	return over;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "VertexLayout.h"
+
+// Candidate compact vertex formats, declared for real so the projected sizes are what they'd be.
+// Full position, octahedral normal and UVs in 16 bit fixed point:
+struct CompactVertex {
+	glm::vec3 Position;
+	glm::i16vec2 Normal;
+	glm::u16vec2 TexCoords;
+};
+// Position quantized to 16 bits within the mesh bounds, normal in 8 bits:
+struct QuantizedVertex {
+	glm::u16vec4 Position;
+	glm::i8vec4 Normal;
+	glm::u16vec2 TexCoords;
+};
+
+template <> struct VertexLayout<CompactVertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(CompactVertex, Position, "position", 0),
+		VERTEX_ATTRIBUTE(CompactVertex, Normal, "octNormal", 1, GL_TRUE),
+		VERTEX_ATTRIBUTE(CompactVertex, TexCoords, "texCoords", 2, GL_TRUE),
+	};
+};
+static_assert(checkVertexLayout<CompactVertex>(true), "CompactVertex attributes don't cover CompactVertex exactly");
+
+template <> struct VertexLayout<QuantizedVertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(QuantizedVertex, Position, "quantizedPosition", 0, GL_TRUE),
+		VERTEX_ATTRIBUTE(QuantizedVertex, Normal, "normal", 1, GL_TRUE),
+		VERTEX_ATTRIBUTE(QuantizedVertex, TexCoords, "texCoords", 2, GL_TRUE),
+	};
+};
+static_assert(checkVertexLayout<QuantizedVertex>(true), "QuantizedVertex attributes don't cover QuantizedVertex exactly");
+
+// What a mesh (or a whole model) costs to store and draw
+struct MeshStats {
+	size_t vertices = 0;
+	size_t triangles = 0;
+	// Vertices identical to an earlier one, as a fraction of all
+	float duplicateRatio = 0.0f;
+	// Post-transform cache misses per triangle and per vertex, for a FIFO cache of CACHE_SIZE
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+	// Fragments per covered pixel, averaged over views along the six axes
+	float overdraw = 0.0f;
+	glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+	// Vertex plus index bytes as stored now, and projected for the compact formats (with
+	// 16 bit indices wherever the vertices fit)
+	size_t bytes = 0;
+	size_t compactBytes = 0;
+	size_t quantizedBytes = 0;
+};
+
+struct ModelStats {
+	string path;
+	vector<MeshStats> meshes;
+	// Sums; cache and overdraw figures are over all meshes together
+	MeshStats total;
+	size_t materials = 0;
+};
+
+// Triangles a single model may put on screen per eye per frame before it is flagged
+const size_t MODEL_TRIANGLE_BUDGET = 100000;
+
+// Analysis works on the CPU copies of the meshes, GL-free, so the model has to be loaded with
+// upload off or RETAIN_ANALYSIS
+MeshStats analyzeMesh(const Mesh& mesh);
+ModelStats analyzeModel(const Model& model, const string& path);
+
+// A table per model, with a warning line when it goes over triangleBudget. Returns whether it did.
+bool printStats(ostream& out, const ModelStats& stats, size_t triangleBudget = MODEL_TRIANGLE_BUDGET);
\ No newline at end of file
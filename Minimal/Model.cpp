@@ -1,11 +1,71 @@
 #include "Model.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <thread>
+
+// Runs work(i) for every i below count, spread over the cores with this thread as one of
+// them. Meshes differ a lot in size, so each thread claims the next index as it finishes.
+static void forEachParallel(size_t count, const function<void(size_t)>& work)
+{
+	size_t threads = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), count);
+	if (threads < 2)
+	{
+		for (size_t i = 0; i < count; i++)
+			work(i);
+		return;
+	}
+	std::atomic<size_t> next(0);
+	auto worker = [&] {
+		for (size_t i; (i = next++) < count;)
+			work(i);
+	};
+	vector<future<void>> helpers;
+	for (size_t t = 1; t < threads; t++)
+		helpers.push_back(std::async(std::launch::async, worker));
+	worker();
+	for (future<void>& helper : helpers)
+		helper.get();
+}
+
+// Moves the converted meshes in, in order, then gives them buffers if the model uploads on load
+void Model::adoptMeshes(vector<unique_ptr<Mesh>>& slots)
+{
+	this->meshes.reserve(slots.size());
+	for (unique_ptr<Mesh>& mesh : slots)
+		this->meshes.push_back(std::move(*mesh));
+	if (this->uploadOnLoad)
+		this->upload();
+}
+
 // Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
 void Model::loadModel(string path)
 {
+	// A cooked copy in the mounted archive needs no parsing
+	const AssetArchive* archive = AssetArchive::mounted();
+	const AssetArchive::Entry* entry = archive ? archive->find(path) : NULL;
+	if (entry) {
+		this->path = path;
+		this->directory = path.substr(0, path.find_last_of('/'));
+		auto start = chrono::steady_clock::now();
+		if (this->loadArchived(*archive, *entry)) {
+			this->computeBounds();
+			this->times.convert = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			return;
+		}
+		cout << "ERROR::ARCHIVE:: could not read " << path << ", loading it from its file" << endl;
+		this->meshes.clear();
+	}
+
 	// Read file via ASSIMP
 	Assimp::Importer importer;
+	auto start = chrono::steady_clock::now();
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	auto imported = chrono::steady_clock::now();
+	this->times.import = chrono::duration<double>(imported - start).count();
 	// Check for errors
 	if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
 	{
@@ -13,27 +73,36 @@ void Model::loadModel(string path)
 		return;
 	}
 	// Retrieve the directory path of the filepath
+	this->path = path;
 	this->directory = path.substr(0, path.find_last_of('/'));
 
-	// Process ASSIMP's root node recursively
-	this->processNode(scene->mRootNode, scene);
+	// Gather ASSIMP's node tree into a flat list, then convert the meshes side by side. Each
+	// only reads the scene and writes its own slot; the GL buffers come after, on this thread.
+	vector<aiMesh*> order;
+	this->processNode(scene->mRootNode, scene, order);
+	vector<unique_ptr<Mesh>> slots(order.size());
+	forEachParallel(order.size(), [&](size_t i) {
+		slots[i].reset(new Mesh(this->processMesh(order[i], scene)));
+	});
+	this->adoptMeshes(slots);
+	this->computeBounds();
+	this->times.convert = chrono::duration<double>(chrono::steady_clock::now() - imported).count();
 }
 
-// Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-void Model::processNode(aiNode* node, const aiScene* scene)
+// Walks the nodes in a recursive fashion, listing the meshes of each node and then of its children nodes (if any), in the order they are drawn.
+void Model::processNode(aiNode* node, const aiScene* scene, vector<aiMesh*>& order)
 {
-	// Process each mesh located at the current node
+	// List each mesh located at the current node
 	for (GLuint i = 0; i < node->mNumMeshes; i++)
 	{
 		// The node object only contains indices to index the actual objects in the scene. 
 		// The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		this->meshes.push_back(this->processMesh(mesh, scene));
+		order.push_back(scene->mMeshes[node->mMeshes[i]]);
 	}
-	// After we've processed all of the meshes (if any) we then recursively process each of the children nodes
+	// After we've listed all of the meshes (if any) we then recursively walk each of the children nodes
 	for (GLuint i = 0; i < node->mNumChildren; i++)
 	{
-		this->processNode(node->mChildren[i], scene);
+		this->processNode(node->mChildren[i], scene, order);
 	}
 
 }
@@ -44,6 +113,8 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 	vector<Vertex> vertices;
 	vector<GLuint> indices;
 	vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
+	indices.reserve(mesh->mNumFaces * 3);
 
 	// Walk through each of the mesh's vertices
 	for (GLuint i = 0; i < mesh->mNumVertices; i++)
@@ -102,6 +173,100 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 	}*/
 	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-	// Return a mesh object created from the extracted mesh data
-	return Mesh(vertices, indices, textures, material);
+	// Return a mesh object created from the extracted mesh data; buffers are made later on the GL thread
+	return Mesh(std::move(vertices), std::move(indices), std::move(textures), material, false, this->retain);
+}
+
+// A cooked model: a count, one record per mesh, then each mesh's vertices and indices
+struct CookedMesh {
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	Material material;
+};
+
+vector<char> Model::cook() const
+{
+	vector<char> blob(sizeof(uint32_t) + this->meshes.size() * sizeof(CookedMesh));
+	uint32_t count = (uint32_t)this->meshes.size();
+	memcpy(&blob[0], &count, sizeof(count));
+	for (size_t i = 0; i < this->meshes.size(); i++)
+	{
+		const Mesh& mesh = this->meshes[i];
+		CookedMesh record = { (uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size(), mesh.mtl };
+		memcpy(&blob[sizeof(uint32_t) + i * sizeof(CookedMesh)], &record, sizeof(record));
+		const char* vertices = (const char*)mesh.vertices.data();
+		const char* indices = (const char*)mesh.indices.data();
+		blob.insert(blob.end(), vertices, vertices + mesh.vertices.size() * sizeof(Vertex));
+		blob.insert(blob.end(), indices, indices + mesh.indices.size() * sizeof(GLuint));
+	}
+	return blob;
+}
+
+// Reads the vertices and indices straight into the vectors the meshes upload from, a mesh
+// per thread as a parsed model does
+bool Model::loadArchived(const AssetArchive& archive, const AssetArchive::Entry& entry)
+{
+	uint32_t count;
+	if (!archive.read(entry, 0, sizeof(count), (char*)&count) || count > entry.size / sizeof(CookedMesh))
+		return false;
+	vector<CookedMesh> records(count);
+	if (count && !archive.read(entry, sizeof(count), count * sizeof(CookedMesh), (char*)&records[0]))
+		return false;
+
+	vector<uint64_t> offsets(count + 1, sizeof(count) + count * sizeof(CookedMesh));
+	for (uint32_t i = 0; i < count; i++)
+		offsets[i + 1] = offsets[i] + records[i].vertexCount * sizeof(Vertex) + records[i].indexCount * sizeof(GLuint);
+	if (offsets[count] > entry.size)
+		return false;
+
+	vector<unique_ptr<Mesh>> slots(count);
+	std::atomic<bool> ok(true);
+	forEachParallel(count, [&](size_t i) {
+		const CookedMesh& record = records[i];
+		size_t vertexBytes = record.vertexCount * sizeof(Vertex);
+		size_t indexBytes = record.indexCount * sizeof(GLuint);
+		vector<Vertex> vertices(record.vertexCount);
+		vector<GLuint> indices(record.indexCount);
+		if ((vertexBytes && !archive.read(entry, offsets[i], vertexBytes, (char*)&vertices[0]))
+			|| (indexBytes && !archive.read(entry, offsets[i] + vertexBytes, indexBytes, (char*)&indices[0])))
+		{
+			ok = false;
+			return;
+		}
+		// Whole triangles of vertices the record has, or the archive is damaged and the file is read instead
+		if (record.indexCount % 3 != 0 || std::any_of(indices.begin(), indices.end(), [&](GLuint index) { return index >= record.vertexCount; })) {
+			ok = false;
+			return;
+		}
+		slots[i].reset(new Mesh(std::move(vertices), std::move(indices), vector<Texture>(), record.material, false, this->retain));
+	});
+	if (!ok)
+		return false;
+	this->adoptMeshes(slots);
+	return true;
+}
+
+// Combines the root boxes of the mesh hierarchies into the model's bounding box
+void Model::computeBounds()
+{
+	this->localMin = glm::vec3(0.0f);
+	this->localMax = glm::vec3(0.0f);
+	bool first = true;
+	for (const Mesh& mesh : this->meshes)
+	{
+		if (mesh.bvh.empty())
+			continue;
+		this->localMin = first ? mesh.bvh.boundsMin() : glm::min(this->localMin, mesh.bvh.boundsMin());
+		this->localMax = first ? mesh.bvh.boundsMax() : glm::max(this->localMax, mesh.bvh.boundsMax());
+		first = false;
+	}
 }
+
+void Model::reportMemory(ostream& out, const string& name) const
+{
+	bool copies = false;
+	for (const Mesh& mesh : this->meshes)
+		copies = copies || mesh.hasCpuCopy();
+	out << name << ": " << this->cpuBytes() / 1024 << " KB CPU, " << this->gpuBytes() / 1024 << " KB GPU, vertices "
+		<< (copies ? "kept" : "released") << ", retained for " << retentionNames(this->retain) << endl;
+}
\ No newline at end of file
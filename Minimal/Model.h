@@ -5,6 +5,8 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <cstring>
 #include <vector>
 using namespace std;
 // GL Includes
@@ -13,10 +15,18 @@ using namespace std;
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "Mesh.h"
+#include "AssetArchive.h"
 
 class Model
 {
 public:
+	// Where loading the model went, in seconds: the Assimp import (none for a cooked model)
+	// and the conversion into meshes, BVHs included (and the upload, for a model uploaded on load)
+	struct LoadTimes {
+		double import = 0.0;
+		double convert = 0.0;
+	};
+
 	//Model() {}
 
 	Model(GLchar* path)
@@ -24,6 +34,65 @@ public:
 		this->loadModel(path);
 	}
 
+	// With upload false the model is only parsed (meshes, materials, hierarchies) and
+	// makes no GL calls, so it can be loaded on a worker thread and uploaded later.
+	// retain (MeshRetention flags) keeps the meshes' CPU copies past their upload.
+	Model(const string& path, bool upload, unsigned retain = RETAIN_NONE)
+	{
+		this->uploadOnLoad = upload;
+		this->retain = retain;
+		this->loadModel(path);
+	}
+
+	// Bytes the meshes take in GPU buffers
+	size_t gpuBytes() const
+	{
+		size_t bytes = 0;
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			bytes += this->meshes[i].gpuBytes();
+		return bytes;
+	}
+
+	// Bytes the model holds in CPU memory: mesh copies still kept, hierarchies, textures
+	size_t cpuBytes() const
+	{
+		size_t bytes = 0;
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			bytes += this->meshes[i].cpuBytes();
+		return bytes;
+	}
+
+	// Gives every mesh buffers of its own, for a model loaded with upload off. GL thread only.
+	void upload()
+	{
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].setupMesh();
+	}
+
+	// Deletes the buffers upload() gave the meshes. GL thread only.
+	void releaseBuffers()
+	{
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].releaseBuffers();
+	}
+
+	// Drops the meshes' CPU copies that nothing retains, for models uploaded by someone else
+	void releaseCpuCopies()
+	{
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].releaseCpuCopy();
+	}
+
+	// One line of CPU bytes, GPU bytes and what the CPU copies are retained for
+	void reportMemory(ostream& out, const string& name) const;
+
+	const string& getPath() const { return this->path; }
+	const LoadTimes& loadTimes() const { return this->times; }
+
+	// The meshes and their materials as one blob for the asset archive, in the layout
+	// they are uploaded in. Needs the CPU copies, so cook from a model loaded with upload off.
+	vector<char> cook() const;
+
 	// Draws the model, and thus all its meshes
 	void Draw(GLuint shader)
 	{
@@ -31,13 +100,36 @@ public:
 			this->meshes[i].Draw(shader);
 	}
 
+	const vector<Mesh>& getMeshes() const { return this->meshes; }
+	vector<Mesh>& getMeshes() { return this->meshes; }
+
+	// Traces the packet (already in model space) against every mesh, keeping the nearest hits
+	void intersect(RayPacket& packet) const
+	{
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+			this->meshes[i].bvh.intersect(packet);
+	}
+
+	// Model space bounding box of all meshes
+	glm::vec3 boundsMin() const { return this->localMin; }
+	glm::vec3 boundsMax() const { return this->localMax; }
+
 private:
 	/*  Model Data  */
 	vector<Mesh> meshes;
+	glm::vec3 localMin, localMax;
+	bool uploadOnLoad = true;
+	unsigned retain = RETAIN_NONE;
+	string path;
 	string directory;
+	LoadTimes times;
 	vector<Texture> textures_loaded;
 
 	void loadModel(string path);
-	void processNode(aiNode* node, const aiScene* scene);
+	bool loadArchived(const AssetArchive& archive, const AssetArchive::Entry& entry);
+	void processNode(aiNode* node, const aiScene* scene, vector<aiMesh*>& order);
+	// Makes no GL calls and touches nothing but its own mesh, so meshes convert in parallel
 	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+	void adoptMeshes(vector<unique_ptr<Mesh>>& slots);
+	void computeBounds();
 };
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "ParticleEmitter.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Random::next() gives 15 bits; this takes it to [0, 1)
+static const float TO_UNIT = 1.0f / 32768.0f;
+// Shortest vector normalized as it is rather than divided by nearly nothing
+static const float MIN_LENGTH = 1e-6f;
+
+int ParticleEmitters::add(const EmitterDesc& desc)
+{
+	this->descs.push_back(desc);
+	return (int)this->descs.size() - 1;
+}
+
+size_t ParticleEmitters::burst(int e, ParticleSystem& pool, Random& random)
+{
+	size_t count = (size_t)std::max(this->descs[e].burst, 0);
+	initialize(this->descs[e], pool, pool.append(count), count, random);
+	return count;
+}
+
+size_t ParticleEmitters::emitAt(int e, const vector<glm::vec3>& origins, ParticleSystem& pool, Random& random)
+{
+	if (origins.empty())
+		return 0;
+	initialize(this->descs[e], pool, pool.append(origins.size()), origins.size(), random, origins.data());
+	return origins.size();
+}
+
+// Scales x, y and z to length, each element by its own; their old lengths go through scratch
+static void normalize(float* x, float* y, float* z, const float* length, float* scratch, size_t count)
+{
+	for (size_t i = 0; i < count; i++) scratch[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+	for (size_t i = 0; i < count; i++) scratch[i] = (length ? length[i] : 1.0f) / std::max(scratch[i], MIN_LENGTH);
+	for (size_t i = 0; i < count; i++) x[i] *= scratch[i];
+	for (size_t i = 0; i < count; i++) y[i] *= scratch[i];
+	for (size_t i = 0; i < count; i++) z[i] *= scratch[i];
+}
+
+void ParticleEmitters::initialize(const EmitterDesc& desc, ParticleSystem& pool, size_t first, size_t count, Random& random, const glm::vec3* origins)
+{
+	if (count == 0)
+		return;
+
+	// The generator is serial, so draw everything first, molecule by molecule, into one
+	// array per value: position (3 values in a box, none at a point), direction, speed, then axis
+	const int positionDraws = desc.shape == EMIT_BOX ? 3 : 0;
+	const int draws = positionDraws + 7;
+	static thread_local vector<float> scratch;
+	scratch.resize((draws + 1) * count);
+	float* u = scratch.data();
+	for (size_t i = 0; i < count; i++) {
+		for (int d = 0; d < draws; d++)
+			u[d * count + i] = random.next() * TO_UNIT;
+	}
+	const float* direction = u + positionDraws * count;
+	float* speed = u + (positionDraws + 3) * count;
+	const float* axis = u + (positionDraws + 4) * count;
+	float* temp = u + draws * count;
+
+	// Each loop writes one array, so the compiler can vectorize it
+	float* pos[3] = { &pool.posX[first], &pool.posY[first], &pool.posZ[first] };
+	for (int a = 0; a < 3; a++) {
+		float* out = pos[a];
+		if (origins) {
+			for (size_t i = 0; i < count; i++) out[i] = origins[i][a];
+		}
+		else {
+			const float c = desc.center[a];
+			for (size_t i = 0; i < count; i++) out[i] = c;
+		}
+	}
+	if (desc.shape == EMIT_BOX) {
+		for (int a = 0; a < 3; a++) {
+			float* out = pos[a];
+			const float* r = u + a * count;
+			const float extent = desc.extent[a];
+			for (size_t i = 0; i < count; i++) out[i] += (2.0f * r[i] - 1.0f) * extent;
+		}
+	}
+
+	float* vel[3] = { &pool.velX[first], &pool.velY[first], &pool.velZ[first] };
+	for (int a = 0; a < 3; a++) {
+		float* out = vel[a];
+		const float* r = direction + a * count;
+		const float low = desc.directionMin[a], range = desc.directionMax[a] - desc.directionMin[a];
+		for (size_t i = 0; i < count; i++) out[i] = low + r[i] * range;
+	}
+	const float speedRange = desc.speedMax - desc.speedMin;
+	for (size_t i = 0; i < count; i++) speed[i] = desc.speedMin + speed[i] * speedRange;
+	normalize(vel[0], vel[1], vel[2], speed, temp, count);
+
+	float* spin[3] = { &pool.axisX[first], &pool.axisY[first], &pool.axisZ[first] };
+	for (int a = 0; a < 3; a++) {
+		float* out = spin[a];
+		const float* r = axis + a * count;
+		for (size_t i = 0; i < count; i++) out[i] = 2.0f * r[i] - 1.0f;
+	}
+	normalize(spin[0], spin[1], spin[2], nullptr, temp, count);
+
+	std::fill(pool.angle.begin() + first, pool.angle.begin() + first + count, 0.0f);
+	std::fill(pool.kind.begin() + first, pool.kind.begin() + first + count, (unsigned char)desc.kind);
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+#include "Random.h"
+
+// Where an emitter puts new molecules
+enum EmitterShape {
+	EMIT_POINT = 0,
+	// Anywhere in the box center +- extent
+	EMIT_BOX = 1
+};
+
+// How an emitter spawns. Every value is drawn uniformly from its range. The defaults are a
+// chimney puff: straight up out of a point, slowly, in any upward direction.
+struct EmitterDesc {
+	EmitterShape shape = EMIT_POINT;
+	glm::vec3 center = glm::vec3(0.0f);
+	glm::vec3 extent = glm::vec3(0.0f);
+	// How many burst adds at once
+	int burst = 0;
+	// Direction of travel is drawn in this box and normalized, then scaled to the speed
+	glm::vec3 directionMin = glm::vec3(-0.5f, 0.0f, -0.5f);
+	glm::vec3 directionMax = glm::vec3(0.5f, 1.0f, 0.5f);
+	// Distance travelled per tick
+	float speedMin = 0.01f, speedMax = 0.01f;
+	ParticleKind kind = PARTICLE_CO2;
+};
+
+// The ways the scene spawns molecules. When they fire is up to the caller (the cells'
+// timers, the start and end of a round); what they spawn goes straight into the particle
+// pool's arrays, all the molecules of a call in one batch: the random numbers are drawn
+// first, then each array is filled by a loop of its own.
+class ParticleEmitters {
+public:
+	// Declares an emitter and returns its id
+	int add(const EmitterDesc& desc);
+	size_t count() const { return this->descs.size(); }
+
+	// Adds emitter e's burst at once and returns how many that was
+	size_t burst(int e, ParticleSystem& pool, Random& random);
+	// One molecule from emitter e at each of origins, which stand in for its center
+	size_t emitAt(int e, const vector<glm::vec3>& origins, ParticleSystem& pool, Random& random);
+
+	// Fills slots [first, first + count) of pool the way desc spawns, at origins[i] in place of
+	// the center if given. For pools with fixed slots; the others append.
+	static void initialize(const EmitterDesc& desc, ParticleSystem& pool, size_t first, size_t count, Random& random, const glm::vec3* origins = nullptr);
+
+private:
+	vector<EmitterDesc> descs;
+};
\ No newline at end of file
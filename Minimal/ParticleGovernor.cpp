@@ -0,0 +1,98 @@
+#include "ParticleGovernor.h"
+
+#include <algorithm>
+
+const double ParticleGovernor::HEADROOM = 0.8;
+const double ParticleGovernor::MISSED_FRAME = 1.4;
+const size_t ParticleGovernor::MIN_MESHES;
+const size_t ParticleGovernor::MIN_DRAWN;
+
+// Weight of the newest frame in the running averages, about a third of a second at 90 Hz
+static const double SMOOTHING = 0.1;
+// Budgets grow back at most this much a frame, so one quiet frame doesn't undo them
+static const double RECOVERY = 1.05;
+
+void ParticleGovernor::frame(double simSeconds, double renderSeconds, double meshSeconds, double intervalSeconds)
+{
+	this->sim += (simSeconds - this->sim) * SMOOTHING;
+	this->render += (renderSeconds - this->render) * SMOOTHING;
+	if (this->meshesDrawn > 0) {
+		double cost = meshSeconds / this->meshesDrawn;
+		this->perMesh = this->perMesh == 0.0 ? cost : this->perMesh + (cost - this->perMesh) * SMOOTHING;
+	}
+	this->other += (renderSeconds - meshSeconds - this->other) * SMOOTHING;
+
+	// As many meshes as the rest of the frame leaves room for, followed as is so a burst of
+	// spawns is cut back on the next frame
+	this->afford = (size_t)-1;
+	if (this->perMesh > 0.0) {
+		double room = this->frameSeconds * HEADROOM - this->sim - this->other;
+		this->afford = std::max(MIN_MESHES, room > 0.0 ? (size_t)std::min(room / this->perMesh, 1e9) : (size_t)0);
+	}
+
+	// A missed frame means the estimate is off (or the GPU is the limit): cut for real, then
+	// climb back a little a frame
+	bool missed = intervalSeconds > this->frameSeconds * MISSED_FRAME;
+	size_t count = this->order.size();
+	if (missed && this->meshesDrawn > MIN_MESHES)
+		this->meshes = std::max(MIN_MESHES, std::min(this->meshes, this->meshesDrawn) * 3 / 4);
+	else if (!missed && this->meshes != (size_t)-1)
+		this->meshes = this->meshes >= count * 2 ? (size_t)-1 : (size_t)(this->meshes * RECOVERY) + 1;
+
+	// Still missing with the meshes at their floor leaves the impostors to cut
+	if (missed && this->meshesDrawn <= MIN_MESHES && count > MIN_DRAWN)
+		this->drawn = std::max(MIN_DRAWN, std::min(this->drawn, count) * 3 / 4);
+	else if (!missed && this->drawn != (size_t)-1)
+		this->drawn = this->drawn >= count ? (size_t)-1 : (size_t)(this->drawn * RECOVERY) + 1;
+}
+
+void ParticleGovernor::assign(const ParticleSystem& particles, glm::vec3 head, glm::vec3 forward, vector<unsigned char>& detail)
+{
+	const size_t n = particles.size();
+	detail.assign(n, DETAIL_MESH);
+	size_t budget = this->meshBudget();
+	this->meshesDrawn = n;
+	this->limited = false;
+	this->order.resize(n);
+	if (n <= budget && n <= this->drawn)
+		return;
+
+	// Lower is more important: distance, times a penalty for O2 and for being out of view
+	this->importance.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		glm::vec3 offset = particles.position(i) - head;
+		float distance = glm::length(offset);
+		float score = distance;
+		if (glm::dot(offset, forward) < distance * 0.5f)
+			score *= 8.0f;
+		if (particles.kind[i] != PARTICLE_CO2)
+			score *= 4.0f;
+		this->importance[i] = score;
+		this->order[i] = i;
+	}
+	auto moreImportant = [this](size_t a, size_t b) { return this->importance[a] < this->importance[b]; };
+
+	// Only the split points need to be right, not the order within each part
+	size_t meshCount = std::min(budget, n);
+	std::nth_element(this->order.begin(), this->order.begin() + meshCount, this->order.end(), moreImportant);
+	size_t drawCount = std::max(meshCount, std::min(this->drawn, n));
+	if (drawCount < n)
+		std::nth_element(this->order.begin() + meshCount, this->order.begin() + drawCount, this->order.end(), moreImportant);
+	for (size_t k = meshCount; k < n; k++) {
+		size_t i = this->order[k];
+		detail[i] = k < drawCount || particles.kind[i] == PARTICLE_CO2 ? DETAIL_IMPOSTOR : DETAIL_HIDDEN;
+	}
+	this->meshesDrawn = meshCount;
+	this->limited = true;
+}
+
+void ParticleGovernor::report(ostream& out) const
+{
+	size_t budget = this->meshBudget();
+	out << "Particle governor: sim " << this->sim * 1000.0 << " ms, render " << this->render * 1000.0 << " ms, "
+		<< this->perMesh * 1e6 << " us per mesh; ";
+	if (budget == (size_t)-1)
+		out << "every molecule drawn as a mesh" << endl;
+	else
+		out << budget << " meshes, " << (this->drawn == (size_t)-1 ? string("no cap") : to_string(this->drawn) + " drawn at most") << endl;
+}
\ No newline at end of file
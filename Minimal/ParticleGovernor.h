@@ -0,0 +1,72 @@
+#pragma once
+// Std. Includes
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+
+// How a particle is drawn this frame
+enum ParticleDetail {
+	DETAIL_MESH = 0,
+	DETAIL_IMPOSTOR = 1,
+	// Not drawn at all; only ever O2, the molecules still in play are always visible
+	DETAIL_HIDDEN = 2
+};
+
+// Holds the frame rate as molecules pile up by lowering how they are drawn, never what
+// happens to them. Each frame it is fed the seconds spent simulating, rendering and drawing
+// molecule meshes, and the time since the last frame, and keeps a running cost per mesh.
+// From that it predicts how many molecules can be drawn as full meshes, the rest as
+// impostors, so a burst of spawns is cut back on the next frame. Missed frames lower
+// the budget further, and if they go on with it at its floor (GPU bound), it also caps how
+// many are drawn at all. Budgets go to the most important molecules first: CO2
+// before O2, in view before behind, near before far. Positions, co2Count and laser hits
+// are untouched; O2 drawn as less than a mesh may also skip the scene hierarchy, since
+// nothing traces them.
+class ParticleGovernor {
+public:
+	// Fraction of the frame the simulation and render work is kept under
+	static const double HEADROOM;
+	// A frame this much longer than the target counts as missed
+	static const double MISSED_FRAME;
+	// Fewest molecules drawn as meshes, and drawn at all, however slow it gets
+	static const size_t MIN_MESHES = 32;
+	static const size_t MIN_DRAWN = 256;
+
+	explicit ParticleGovernor(double frameSeconds = 1.0 / 90.0) : frameSeconds(frameSeconds) {}
+
+	void setFrameSeconds(double seconds) { frameSeconds = seconds; }
+
+	// Timings of the frame just finished: its simulation, its rendering (all eyes), the part
+	// of that spent drawing molecule meshes, and the time since the one before
+	void frame(double simSeconds, double renderSeconds, double meshSeconds, double intervalSeconds);
+	// Fills detail[i] with a ParticleDetail for every particle, most important first within
+	// the budgets. forward is the unit view direction.
+	void assign(const ParticleSystem& particles, glm::vec3 head, glm::vec3 forward, vector<unsigned char>& detail);
+
+	size_t meshBudget() const { return std::min(meshes, afford); }
+	size_t drawBudget() const { return drawn; }
+	// Whether the budgets cut anything last assign
+	bool limiting() const { return limited; }
+	void report(ostream& out) const;
+
+private:
+	double frameSeconds;
+	// Running averages, seconds; other is rendering besides the molecule meshes
+	double sim = 0.0, render = 0.0, other = 0.0;
+	double perMesh = 0.0;
+	// Budgets, -1 for none: what the costs predict fits, and what missed frames allow
+	size_t afford = (size_t)-1;
+	size_t meshes = (size_t)-1;
+	size_t drawn = (size_t)-1;
+	// Meshes drawn in the frame being timed
+	size_t meshesDrawn = 0;
+	bool limited = false;
+	vector<float> importance;
+	vector<size_t> order;
+};
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "ParticleImpostors.h"
+#include "ParticleGovernor.h"
+
+constexpr VertexAttribute VertexLayout<ImpostorVertex>::attributes[];
+
+ParticleImpostors::ParticleImpostors(const ShaderSource& source)
+{
+	this->shader = CompileShaders(source, vertexInputs<ImpostorVertex>());
+	glGenVertexArrays(1, &this->VAO);
+	glGenBuffers(1, &this->VBO);
+}
+
+ParticleImpostors::~ParticleImpostors()
+{
+	glDeleteBuffers(1, &this->VBO);
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteProgram(this->shader);
+}
+
+void ParticleImpostors::update(const ParticleSystem& particles, const vector<unsigned char>& detail, const ParticleSystem& far)
+{
+	this->points.clear();
+	auto add = [this](const ParticleSystem& system, size_t i) {
+		ImpostorVertex point;
+		point.Position = system.position(i);
+		point.Radius = this->radius;
+		glm::vec3 color = glm::clamp(this->colors[system.kind[i]], 0.0f, 1.0f) * 255.0f;
+		point.Color = glm::u8vec4((GLubyte)color.x, (GLubyte)color.y, (GLubyte)color.z, 255);
+		this->points.push_back(point);
+	};
+	for (size_t i = 0; i < detail.size(); i++) {
+		if (detail[i] == DETAIL_IMPOSTOR)
+			add(particles, i);
+	}
+	for (size_t i = 0; i < far.size(); i++)
+		add(far, i);
+	if (this->points.empty())
+		return;
+
+	glBindVertexArray(this->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+	// Grown in doubling steps and orphaned every frame, so the driver never waits on the last draw
+	if (this->points.size() > this->capacity) {
+		this->capacity = std::max(this->points.size(), this->capacity * 2);
+		setVertexLayout<ImpostorVertex>();
+	}
+	glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(ImpostorVertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, this->points.size() * sizeof(ImpostorVertex), &this->points[0]);
+	glBindVertexArray(0);
+}
+
+void ParticleImpostors::draw(const glm::mat4& projection, const glm::mat4& view)
+{
+	if (this->points.empty())
+		return;
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glUseProgram(this->shader);
+	glUniformMatrix4fv(glGetUniformLocation(this->shader, "projection"), 1, GL_FALSE, &projection[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(this->shader, "view"), 1, GL_FALSE, &view[0][0]);
+	glUniform1f(glGetUniformLocation(this->shader, "viewportHeight"), (float)viewport[3]);
+
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glBindVertexArray(this->VAO);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)this->points.size());
+	glBindVertexArray(0);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+}
\ No newline at end of file
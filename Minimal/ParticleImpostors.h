@@ -0,0 +1,52 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+#include "Shader.h"
+#include "VertexLayout.h"
+
+// One molecule drawn as a shaded sphere on a point sprite
+struct ImpostorVertex {
+	glm::vec3 Position;
+	float Radius;
+	glm::u8vec4 Color;
+};
+
+template <> struct VertexLayout<ImpostorVertex> {
+	static constexpr VertexAttribute attributes[] = {
+		VERTEX_ATTRIBUTE(ImpostorVertex, Position, "position", 0),
+		VERTEX_ATTRIBUTE(ImpostorVertex, Radius, "radius", 1),
+		VERTEX_ATTRIBUTE(ImpostorVertex, Color, "color", 2, GL_TRUE),
+	};
+};
+static_assert(checkVertexLayout<ImpostorVertex>(true), "ImpostorVertex attributes don't cover ImpostorVertex exactly");
+
+// Draws the molecules the ParticleGovernor demoted, all in one call per eye. A point
+// costs the same wherever it is, where a molecule mesh is a draw per atom.
+class ParticleImpostors {
+public:
+	// Color of each ParticleKind, and the radius of the sphere standing in for a molecule
+	glm::vec3 colors[2] = { glm::vec3(0.3f), glm::vec3(0.8f, 0.1f, 0.1f) };
+	float radius = 0.3f;
+
+	// source is impostor.vert and impostor.frag, read with ReadShaderSource
+	explicit ParticleImpostors(const ShaderSource& source);
+	~ParticleImpostors();
+
+	// Refills the points from the particles whose detail is DETAIL_IMPOSTOR, and every one of far
+	void update(const ParticleSystem& particles, const vector<unsigned char>& detail, const ParticleSystem& far);
+	// Draws them into the bound framebuffer with the camera of the eye being rendered
+	void draw(const glm::mat4& projection, const glm::mat4& view);
+	size_t size() const { return points.size(); }
+
+private:
+	GLuint shader = 0;
+	GLuint VAO = 0, VBO = 0;
+	size_t capacity = 0;
+	vector<ImpostorVertex> points;
+};
\ No newline at end of file
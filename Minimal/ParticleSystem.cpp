@@ -0,0 +1,98 @@
+#include "ParticleSystem.h"
+
+void ParticleSystem::clear()
+{
+	posX.clear(); posY.clear(); posZ.clear();
+	velX.clear(); velY.clear(); velZ.clear();
+	axisX.clear(); axisY.clear(); axisZ.clear();
+	angle.clear();
+	kind.clear();
+}
+
+void ParticleSystem::reserve(size_t n)
+{
+	posX.reserve(n); posY.reserve(n); posZ.reserve(n);
+	velX.reserve(n); velY.reserve(n); velZ.reserve(n);
+	axisX.reserve(n); axisY.reserve(n); axisZ.reserve(n);
+	angle.reserve(n);
+	kind.reserve(n);
+}
+
+size_t ParticleSystem::spawn(glm::vec3 position, glm::vec3 velocity, glm::vec3 axis, ParticleKind k)
+{
+	posX.push_back(position.x); posY.push_back(position.y); posZ.push_back(position.z);
+	velX.push_back(velocity.x); velY.push_back(velocity.y); velZ.push_back(velocity.z);
+	axisX.push_back(axis.x); axisY.push_back(axis.y); axisZ.push_back(axis.z);
+	angle.push_back(0.0f);
+	kind.push_back((unsigned char)k);
+	return kind.size() - 1;
+}
+
+size_t ParticleSystem::append(size_t count)
+{
+	size_t first = size();
+	size_t n = first + count;
+	posX.resize(n); posY.resize(n); posZ.resize(n);
+	velX.resize(n); velY.resize(n); velZ.resize(n);
+	axisX.resize(n); axisY.resize(n); axisZ.resize(n);
+	angle.resize(n);
+	kind.resize(n);
+	return first;
+}
+
+void ParticleSystem::place(size_t i, glm::vec3 position, glm::vec3 velocity, glm::vec3 axis, ParticleKind k)
+{
+	posX[i] = position.x; posY[i] = position.y; posZ[i] = position.z;
+	velX[i] = velocity.x; velY[i] = velocity.y; velZ[i] = velocity.z;
+	axisX[i] = axis.x; axisY[i] = axis.y; axisZ[i] = axis.z;
+	angle[i] = 0.0f;
+	kind[i] = (unsigned char)k;
+}
+
+void ParticleSystem::integrate()
+{
+	const size_t n = size();
+	// Each loop touches one or two arrays so the compiler can vectorize it
+	for (size_t i = 0; i < n; i++) posX[i] += velX[i];
+	for (size_t i = 0; i < n; i++) posY[i] += velY[i];
+	for (size_t i = 0; i < n; i++) posZ[i] += velZ[i];
+	for (size_t i = 0; i < n; i++) angle[i] += spin;
+
+	// Check walls
+	for (size_t i = 0; i < n; i++) velX[i] = (posX[i] < boxMin.x || posX[i] > boxMax.x) ? -velX[i] : velX[i];
+	for (size_t i = 0; i < n; i++) velY[i] = (posY[i] < boxMin.y || posY[i] > boxMax.y) ? -velY[i] : velY[i];
+	for (size_t i = 0; i < n; i++) velZ[i] = (posZ[i] < boxMin.z || posZ[i] > boxMax.z) ? -velZ[i] : velZ[i];
+}
+
+glm::mat4 ParticleSystem::transform(size_t i) const
+{
+	glm::mat4 m = glm::translate(glm::mat4(1.0f), position(i));
+	m = glm::scale(m, glm::vec3(scale));
+	return glm::rotate(m, angle[i], glm::vec3(axisX[i], axisY[i], axisZ[i]));
+}
+
+void ParticleSystem::save(Snapshot& snapshot) const
+{
+	snapshot.putArray(posX); snapshot.putArray(posY); snapshot.putArray(posZ);
+	snapshot.putArray(velX); snapshot.putArray(velY); snapshot.putArray(velZ);
+	snapshot.putArray(axisX); snapshot.putArray(axisY); snapshot.putArray(axisZ);
+	snapshot.putArray(angle);
+	snapshot.putArray(kind);
+}
+
+bool ParticleSystem::load(Snapshot& snapshot)
+{
+	bool ok = snapshot.getArray(posX) && snapshot.getArray(posY) && snapshot.getArray(posZ)
+		&& snapshot.getArray(velX) && snapshot.getArray(velY) && snapshot.getArray(velZ)
+		&& snapshot.getArray(axisX) && snapshot.getArray(axisY) && snapshot.getArray(axisZ)
+		&& snapshot.getArray(angle)
+		&& snapshot.getArray(kind);
+	// Every array must describe the same particles
+	size_t n = kind.size();
+	if (!ok || posX.size() != n || posY.size() != n || posZ.size() != n || velX.size() != n || velY.size() != n || velZ.size() != n
+		|| axisX.size() != n || axisY.size() != n || axisZ.size() != n || angle.size() != n) {
+		clear();
+		return false;
+	}
+	return true;
+}
\ No newline at end of file
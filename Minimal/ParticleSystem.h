@@ -0,0 +1,60 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Snapshot.h"
+
+// What a particle currently is. Gameplay only ever cares about CO2 vs O2.
+enum ParticleKind {
+	PARTICLE_CO2 = 0,
+	PARTICLE_O2 = 1
+};
+
+// Structure-of-arrays storage for the molecules. Every field lives in its own
+// tightly packed array so the per-tick kernels (integration, collision) can
+// stream through positions and velocities four particles at a time.
+class ParticleSystem {
+public:
+	/*  Particle Data  */
+	vector<float> posX, posY, posZ;
+	vector<float> velX, velY, velZ;
+	// Spin axis (unit length) and accumulated spin angle
+	vector<float> axisX, axisY, axisZ;
+	vector<float> angle;
+	vector<unsigned char> kind;
+
+	// Uniform scale applied to every molecule model
+	float scale = 0.3f;
+	// Spin angle added per tick, in the units glm::rotate expects
+	float spin = 0.05f;
+	// Walls of the play area, particles bounce when they leave it
+	glm::vec3 boxMin = glm::vec3(-10.0f, -10.0f, -25.0f);
+	glm::vec3 boxMax = glm::vec3(10.0f, 10.0f, -5.0f);
+
+	/*  Functions  */
+	size_t size() const { return kind.size(); }
+	void clear();
+	void reserve(size_t n);
+
+	// Appends a particle and returns its index
+	size_t spawn(glm::vec3 position, glm::vec3 velocity, glm::vec3 axis, ParticleKind k);
+	// Adds count particles at the end for the caller to fill in, and returns the first
+	size_t append(size_t count);
+	// Overwrites particle i, for pools that keep a fixed number of slots
+	void place(size_t i, glm::vec3 position, glm::vec3 velocity, glm::vec3 axis, ParticleKind k);
+
+	// Moves and spins every particle one tick and reflects velocities off the box walls
+	void integrate();
+
+	// Model matrix of particle i: translate * scale * spin
+	glm::mat4 transform(size_t i) const;
+	glm::vec3 position(size_t i) const { return glm::vec3(posX[i], posY[i], posZ[i]); }
+
+	// Appends every array to a snapshot, or restores them from one
+	void save(Snapshot& snapshot) const;
+	bool load(Snapshot& snapshot);
+};
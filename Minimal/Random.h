@@ -0,0 +1,14 @@
+#pragma once
+
+// The linear congruential generator behind rand() in the Visual C++ runtime, with its
+// state out in the open so it can be saved and restored along with the game
+struct Random {
+	unsigned state = 1;
+
+	// Next value in [0, 0x7fff], the same sequence rand() gives without srand()
+	int next()
+	{
+		state = state * 214013u + 2531011u;
+		return (state >> 16) & 0x7fff;
+	}
+};
\ No newline at end of file
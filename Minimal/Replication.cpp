@@ -0,0 +1,551 @@
+#define NOMINMAX
+#include <Windows.h>
+
+#include "Replication.h"
+#include "Random.h"
+#include "SpscQueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <glm/gtc/matrix_transform.hpp>
+
+const float ReplicatedScene::POSITION_RANGE = 64.0f;
+const float ReplicatedScene::ANGLE_PERIOD = 360.0f;
+const uint32_t ReplicationServer::HISTORY;
+const size_t ReplicationServer::MAX_PACKET_BYTES;
+
+// Beams are quantized up to this long, in metres
+static const float MAX_BEAM = 64.0f;
+// Most bits one particle can take in a packet, so a packet never goes over its budget
+static const size_t MAX_ENTRY_BITS = 1 + 34 + 4 * 34 + 1 + 3 * 8 + 1;
+// More than this many particles in a packet is a damaged one
+static const uint32_t MAX_PARTICLES = 1 << 22;
+
+void BitWriter::write(uint32_t value, int bits)
+{
+	this->scratch |= (uint64_t)(bits == 32 ? value : value & ((1u << bits) - 1)) << this->pending;
+	this->pending += bits;
+	this->bits += bits;
+	while (this->pending >= 8) {
+		this->bytes.push_back((uint8_t)this->scratch);
+		this->scratch >>= 8;
+		this->pending -= 8;
+	}
+}
+
+void BitWriter::writeUnsigned(uint32_t value)
+{
+	static const int widths[4] = { 4, 8, 16, 32 };
+	int width = value < 16 ? 0 : value < 256 ? 1 : value < 65536 ? 2 : 3;
+	this->write(width, 2);
+	this->write(value, widths[width]);
+}
+
+void BitWriter::writeSigned(int32_t value)
+{
+	// Zigzag, so small changes either way are small numbers
+	this->writeUnsigned(((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+void BitWriter::flush()
+{
+	if (this->pending > 0)
+		this->bytes.push_back((uint8_t)this->scratch);
+	this->scratch = 0;
+	this->pending = 0;
+}
+
+uint32_t BitReader::read(int bits)
+{
+	uint32_t value = 0;
+	for (int got = 0; got < bits;) {
+		size_t byte = this->bit >> 3;
+		if (byte >= this->size) {
+			this->overrun = true;
+			return 0;
+		}
+		int offset = (int)(this->bit & 7);
+		int take = std::min(8 - offset, bits - got);
+		value |= (uint32_t)((this->data[byte] >> offset) & ((1u << take) - 1)) << got;
+		got += take;
+		this->bit += take;
+	}
+	return value;
+}
+
+uint32_t BitReader::readUnsigned()
+{
+	static const int widths[4] = { 4, 8, 16, 32 };
+	return this->read(widths[this->read(2)]);
+}
+
+int32_t BitReader::readSigned()
+{
+	uint32_t zigzag = this->readUnsigned();
+	return (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+}
+
+static uint16_t quantizePosition(float value)
+{
+	float unit = (glm::clamp(value, -ReplicatedScene::POSITION_RANGE, ReplicatedScene::POSITION_RANGE) / ReplicatedScene::POSITION_RANGE + 1.0f) * 0.5f;
+	return (uint16_t)std::lround(unit * 65535.0f);
+}
+
+static float positionOf(uint16_t value)
+{
+	return (value / 65535.0f * 2.0f - 1.0f) * ReplicatedScene::POSITION_RANGE;
+}
+
+ReplicatedScene::ReplicatedScene()
+{
+	memset(this->lasers, 0, sizeof(this->lasers));
+}
+
+void ReplicatedScene::capture(const ParticleSystem& source, const glm::mat4 laserTransforms[2], const float beamLength[2], const bool red[2], int co2, bool won, bool lost)
+{
+	const size_t n = source.size();
+	this->particles.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		ReplicatedParticle& p = this->particles[i];
+		p.position[0] = quantizePosition(source.posX[i]);
+		p.position[1] = quantizePosition(source.posY[i]);
+		p.position[2] = quantizePosition(source.posZ[i]);
+		float turn = std::fmod(source.angle[i], ANGLE_PERIOD) / ANGLE_PERIOD;
+		p.angle = (uint16_t)(int32_t)std::lround((turn < 0.0f ? turn + 1.0f : turn) * 65536.0f);
+		p.axis[0] = (int8_t)std::lround(glm::clamp(source.axisX[i], -1.0f, 1.0f) * 127.0f);
+		p.axis[1] = (int8_t)std::lround(glm::clamp(source.axisY[i], -1.0f, 1.0f) * 127.0f);
+		p.axis[2] = (int8_t)std::lround(glm::clamp(source.axisZ[i], -1.0f, 1.0f) * 127.0f);
+		p.kind = source.kind[i];
+	}
+	for (int hand = 0; hand < 2; hand++) {
+		ReplicatedLaser& laser = this->lasers[hand];
+		glm::vec3 origin = glm::vec3(laserTransforms[hand][3]);
+		glm::vec3 beam = glm::vec3(laserTransforms[hand][2]);
+		float reach = glm::length(beam);
+		glm::vec3 direction = reach > 0.0f ? beam / reach : glm::vec3(0.0f, 0.0f, -1.0f);
+		for (int a = 0; a < 3; a++) {
+			laser.origin[a] = quantizePosition(origin[a]);
+			laser.direction[a] = (int16_t)std::lround(direction[a] * 32767.0f);
+		}
+		laser.length = (uint16_t)std::lround(glm::clamp(reach * beamLength[hand] / MAX_BEAM, 0.0f, 1.0f) * 65535.0f);
+		laser.red = red[hand] ? 1 : 0;
+	}
+	this->co2Count = co2;
+	this->win = won;
+	this->lose = lost;
+}
+
+glm::vec3 ReplicatedScene::position(size_t i) const
+{
+	const ReplicatedParticle& p = this->particles[i];
+	return glm::vec3(positionOf(p.position[0]), positionOf(p.position[1]), positionOf(p.position[2]));
+}
+
+glm::mat4 ReplicatedScene::transform(size_t i, float scale) const
+{
+	const ReplicatedParticle& p = this->particles[i];
+	glm::vec3 axis = glm::vec3(p.axis[0], p.axis[1], p.axis[2]) / 127.0f;
+	glm::mat4 m = glm::translate(glm::mat4(1.0f), this->position(i));
+	m = glm::scale(m, glm::vec3(scale));
+	return glm::rotate(m, p.angle / 65536.0f * ANGLE_PERIOD, axis);
+}
+
+glm::vec3 ReplicatedScene::laserOrigin(int hand) const
+{
+	const ReplicatedLaser& laser = this->lasers[hand];
+	return glm::vec3(positionOf(laser.origin[0]), positionOf(laser.origin[1]), positionOf(laser.origin[2]));
+}
+
+glm::vec3 ReplicatedScene::laserDirection(int hand) const
+{
+	const ReplicatedLaser& laser = this->lasers[hand];
+	return glm::vec3(laser.direction[0], laser.direction[1], laser.direction[2]) / 32767.0f;
+}
+
+float ReplicatedScene::laserLength(int hand) const
+{
+	return this->lasers[hand].length / 65535.0f * MAX_BEAM;
+}
+
+// The header: sequence, baseline, counts, lasers and game state, written whole every packet
+static void writeHeader(BitWriter& out, uint32_t sequence, uint32_t baseline, const ReplicatedScene& scene)
+{
+	out.write(sequence, 32);
+	out.write(baseline, 32);
+	out.write((uint32_t)scene.particles.size(), 32);
+	out.write((uint32_t)scene.co2Count, 32);
+	out.write(scene.win ? 1 : 0, 1);
+	out.write(scene.lose ? 1 : 0, 1);
+	for (const ReplicatedLaser& laser : scene.lasers) {
+		for (int a = 0; a < 3; a++)
+			out.write(laser.origin[a], 16);
+		for (int a = 0; a < 3; a++)
+			out.write((uint16_t)laser.direction[a], 16);
+		out.write(laser.length, 16);
+		out.write(laser.red, 1);
+	}
+}
+
+// One particle as the change from its baseline. Differences wrap in 16 bits, so the
+// reader gets back the exact value whichever way is shorter.
+static void writeParticle(BitWriter& out, const ReplicatedParticle& p, const ReplicatedParticle& base)
+{
+	for (int a = 0; a < 3; a++)
+		out.writeSigned((int16_t)(uint16_t)(p.position[a] - base.position[a]));
+	out.writeSigned((int16_t)(uint16_t)(p.angle - base.angle));
+	bool changed = memcmp(p.axis, base.axis, sizeof(p.axis)) != 0 || p.kind != base.kind;
+	out.write(changed ? 1 : 0, 1);
+	if (changed) {
+		for (int a = 0; a < 3; a++)
+			out.write((uint8_t)p.axis[a], 8);
+		out.write(p.kind, 1);
+	}
+}
+
+static void readParticle(BitReader& in, ReplicatedParticle& p, const ReplicatedParticle& base)
+{
+	for (int a = 0; a < 3; a++)
+		p.position[a] = (uint16_t)(base.position[a] + in.readSigned());
+	p.angle = (uint16_t)(base.angle + in.readSigned());
+	if (in.read(1)) {
+		for (int a = 0; a < 3; a++)
+			p.axis[a] = (int8_t)(uint8_t)in.read(8);
+		p.kind = (uint8_t)in.read(1);
+	}
+	else {
+		memcpy(p.axis, base.axis, sizeof(p.axis));
+		p.kind = base.kind;
+	}
+}
+
+static bool sameParticle(const ReplicatedParticle& a, const ReplicatedParticle& b)
+{
+	return memcmp(a.position, b.position, sizeof(a.position)) == 0 && a.angle == b.angle
+		&& memcmp(a.axis, b.axis, sizeof(a.axis)) == 0 && a.kind == b.kind;
+}
+
+ReplicationServer::ReplicationServer()
+{
+	std::fill(this->stateSequence, this->stateSequence + HISTORY, 0u);
+}
+
+void ReplicationServer::restart()
+{
+	this->first = this->next;
+	this->acked = 0;
+	for (vector<ReplicatedParticle>& state : this->states)
+		state.clear();
+	std::fill(this->stateSequence, this->stateSequence + HISTORY, 0u);
+	this->priority.clear();
+	this->lastCarried.clear();
+	this->order.clear();
+	this->lastSent = this->lastWaiting = 0;
+}
+
+void ReplicationServer::write(const ReplicatedScene& scene, glm::vec3 focus, vector<uint8_t>& packet)
+{
+	uint32_t sequence = this->next++;
+	bool haveBaseline = this->acked != 0 && sequence - this->acked < HISTORY && this->stateSequence[this->acked % HISTORY] == this->acked;
+	uint32_t baseline = haveBaseline ? this->acked : 0;
+	const vector<ReplicatedParticle>* base = haveBaseline ? &this->states[baseline % HISTORY] : nullptr;
+	const ReplicatedParticle zero = {};
+	const size_t n = scene.particles.size();
+
+	// A particle the spectator already has as it is now waits for nothing; the rest gain
+	// priority every tick they wait, CO2 and ones near the player faster
+	this->priority.resize(n, 0.0f);
+	this->lastCarried.resize(n, 0);
+	this->order.clear();
+	for (size_t i = 0; i < n; i++) {
+		const ReplicatedParticle& known = base && i < base->size() ? (*base)[i] : zero;
+		if (base && i < base->size() && this->lastCarried[i] <= baseline && sameParticle(scene.particles[i], known)) {
+			this->priority[i] = 0.0f;
+			continue;
+		}
+		float distance = glm::length(scene.position(i) - focus);
+		this->priority[i] += (scene.particles[i].kind == PARTICLE_CO2 ? 2.0f : 1.0f) / (1.0f + distance);
+		this->order.push_back((uint32_t)i);
+	}
+
+	// Only as many as could possibly fit need to be in order
+	size_t budgetBits = std::min(this->budgetBytes, MAX_PACKET_BYTES) * 8;
+	size_t fit = std::min(this->order.size(), budgetBits / 16 + 1);
+	auto higher = [this](uint32_t a, uint32_t b) { return this->priority[a] > this->priority[b]; };
+	std::partial_sort(this->order.begin(), this->order.begin() + fit, this->order.end(), higher);
+
+	BitWriter out;
+	out.bytes.swap(packet);
+	out.bytes.clear();
+	writeHeader(out, sequence, baseline, scene);
+	size_t carried = 0;
+	for (; carried < fit && out.bitCount() + MAX_ENTRY_BITS + 1 <= budgetBits; carried++) {
+		uint32_t i = this->order[carried];
+		out.write(1, 1);
+		out.writeUnsigned(i);
+		writeParticle(out, scene.particles[i], base && i < base->size() ? (*base)[i] : zero);
+	}
+	out.write(0, 1);
+	out.flush();
+	packet.swap(out.bytes);
+
+	// What the spectator will have once this packet arrives: the baseline with these particles
+	vector<ReplicatedParticle>& state = this->states[sequence % HISTORY];
+	if (base)
+		state = *base;
+	else
+		state.clear();
+	state.resize(n, zero);
+	for (size_t k = 0; k < carried; k++) {
+		uint32_t i = this->order[k];
+		state[i] = scene.particles[i];
+		this->priority[i] = 0.0f;
+		this->lastCarried[i] = sequence;
+	}
+	this->stateSequence[sequence % HISTORY] = sequence;
+	this->lastSent = carried;
+	this->lastWaiting = this->order.size() - carried;
+}
+
+bool ReplicationServer::acknowledge(const vector<uint8_t>& ack)
+{
+	BitReader in(ack.data(), ack.size());
+	uint32_t sequence = in.read(32);
+	if (in.failed() || sequence < this->first || sequence >= this->next)
+		return false;
+	this->acked = std::max(this->acked, sequence);
+	return true;
+}
+
+bool ReplicationClient::receive(const vector<uint8_t>& packet, vector<uint8_t>& ack)
+{
+	BitReader in(packet.data(), packet.size());
+	uint32_t sequence = in.read(32);
+	uint32_t baseline = in.read(32);
+	uint32_t count = in.read(32);
+	int32_t co2 = (int32_t)in.read(32);
+	bool won = in.read(1) != 0;
+	bool lost = in.read(1) != 0;
+	ReplicatedLaser lasers[2];
+	for (ReplicatedLaser& laser : lasers) {
+		for (int a = 0; a < 3; a++)
+			laser.origin[a] = (uint16_t)in.read(16);
+		for (int a = 0; a < 3; a++)
+			laser.direction[a] = (int16_t)(uint16_t)in.read(16);
+		laser.length = (uint16_t)in.read(16);
+		laser.red = (uint8_t)in.read(1);
+	}
+	if (in.failed() || sequence == 0 || count > MAX_PARTICLES)
+		return false;
+	const vector<ReplicatedParticle>* base = nullptr;
+	if (baseline) {
+		if (this->stateSequence[baseline % ReplicationServer::HISTORY] != baseline)
+			return false;
+		base = &this->states[baseline % ReplicationServer::HISTORY];
+	}
+
+	const ReplicatedParticle zero = {};
+	vector<ReplicatedParticle> state = base ? *base : vector<ReplicatedParticle>();
+	state.resize(count, zero);
+	vector<uint32_t> carried;
+	while (in.read(1)) {
+		uint32_t i = in.readUnsigned();
+		if (in.failed() || i >= count)
+			return false;
+		readParticle(in, state[i], base && i < base->size() ? (*base)[i] : zero);
+		carried.push_back(i);
+	}
+	if (in.failed())
+		return false;
+	this->states[sequence % ReplicationServer::HISTORY].swap(state);
+	this->stateSequence[sequence % ReplicationServer::HISTORY] = sequence;
+
+	// Shown is the newest of everything, so a late packet only fills in what nothing newer has
+	const vector<ReplicatedParticle>& decoded = this->states[sequence % ReplicationServer::HISTORY];
+	if (sequence > this->newest) {
+		this->newest = sequence;
+		this->shown.particles.resize(count, zero);
+		this->updated.resize(count, 0);
+		this->shown.co2Count = co2;
+		this->shown.win = won;
+		this->shown.lose = lost;
+		memcpy(this->shown.lasers, lasers, sizeof(lasers));
+	}
+	for (uint32_t i : carried) {
+		if (i < this->updated.size() && sequence > this->updated[i]) {
+			this->shown.particles[i] = decoded[i];
+			this->updated[i] = sequence;
+		}
+	}
+
+	BitWriter out;
+	out.write(sequence, 32);
+	out.flush();
+	ack.swap(out.bytes);
+	return true;
+}
+
+// Both queues of a link, laid out in the shared mapping
+struct SharedPacket {
+	uint32_t size;
+	uint8_t bytes[ReplicationServer::MAX_PACKET_BYTES];
+};
+
+struct SharedMemoryLink::Channels {
+	// Set by the host last, once the queues are ready
+	std::atomic<uint32_t> ready;
+	SpscQueue<SharedPacket, 16> toSpectator;
+	SpscQueue<SharedPacket, 16> toHost;
+};
+
+static const uint32_t LINK_READY = 0x4b4e494c; // "LINK"
+
+bool SharedMemoryLink::host(const string& name)
+{
+	this->close();
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(Channels), name.c_str());
+	if (!mapping)
+		return false;
+	bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Channels));
+	if (!view) {
+		CloseHandle(mapping);
+		return false;
+	}
+	this->mapping = mapping;
+	// A spectator still attached from an earlier host keeps the mapping alive and is reading
+	// its queues, so those are taken over as they are rather than built again under it
+	if (existed && ((Channels*)view)->ready.load(std::memory_order_acquire) == LINK_READY) {
+		this->channels = (Channels*)view;
+	}
+	else {
+		this->channels = new (view) Channels();
+		this->channels->ready.store(LINK_READY, std::memory_order_release);
+	}
+	this->hosting = true;
+	return true;
+}
+
+bool SharedMemoryLink::join(const string& name)
+{
+	this->close();
+	HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+	if (!mapping)
+		return false;
+	Channels* view = (Channels*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Channels));
+	if (!view || view->ready.load(std::memory_order_acquire) != LINK_READY) {
+		if (view)
+			UnmapViewOfFile(view);
+		CloseHandle(mapping);
+		return false;
+	}
+	this->mapping = mapping;
+	this->channels = view;
+	this->hosting = false;
+	return true;
+}
+
+void SharedMemoryLink::close()
+{
+	if (this->channels)
+		UnmapViewOfFile(this->channels);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	this->channels = nullptr;
+	this->mapping = nullptr;
+}
+
+bool SharedMemoryLink::send(const vector<uint8_t>& packet)
+{
+	if (!this->channels || packet.size() > ReplicationServer::MAX_PACKET_BYTES)
+		return false;
+	// Built in place of the copy the queue makes; too big for the stack
+	static thread_local SharedPacket staging;
+	staging.size = (uint32_t)packet.size();
+	memcpy(staging.bytes, packet.data(), packet.size());
+	return (this->hosting ? this->channels->toSpectator : this->channels->toHost).push(staging);
+}
+
+bool SharedMemoryLink::receive(vector<uint8_t>& packet)
+{
+	if (!this->channels)
+		return false;
+	static thread_local SharedPacket staging;
+	if (!(this->hosting ? this->channels->toHost : this->channels->toSpectator).pop(staging))
+		return false;
+	packet.assign(staging.bytes, staging.bytes + staging.size);
+	return true;
+}
+
+ReplicationBenchResult benchmarkReplication(size_t particles, int ticks, size_t budgetBytes, float loss)
+{
+	ReplicationBenchResult result;
+	result.particles = particles;
+	Random random;
+	auto chance = [&random]() { return random.next() / 32768.0f; };
+
+	// Molecules spread through the play area, moving as the game's do
+	ParticleSystem system;
+	system.reserve(particles);
+	glm::vec3 extent = system.boxMax - system.boxMin;
+	for (size_t i = 0; i < particles; i++) {
+		glm::vec3 position = system.boxMin + glm::vec3(chance(), chance(), chance()) * extent;
+		glm::vec3 velocity = glm::normalize(glm::vec3(chance() - 0.5f, chance() - 0.5f, chance() - 0.5f)) / 100.0f;
+		glm::vec3 axis = glm::normalize(glm::vec3(chance() - 0.5f, chance() - 0.5f, chance() - 0.5f));
+		system.spawn(position, velocity, axis, chance() < 0.8f ? PARTICLE_CO2 : PARTICLE_O2);
+	}
+	glm::mat4 lasers[2] = { glm::mat4(1.0f), glm::mat4(1.0f) };
+	float beams[2] = { 1.0f, 1.0f };
+	bool red[2] = { false, false };
+	glm::vec3 focus = (system.boxMin + system.boxMax) * 0.5f;
+
+	ReplicationServer server;
+	server.budgetBytes = budgetBytes;
+	ReplicationClient client;
+	ReplicatedScene scene;
+	// Packets and acks in flight arrive on the next tick
+	std::deque<vector<uint8_t>> packets, acks;
+	vector<uint8_t> packet, ack;
+	size_t bytes = 0, carried = 0, samples = 0;
+	double errorSum = 0.0;
+	for (int tick = 0; tick < ticks; tick++) {
+		system.integrate();
+		scene.capture(system, lasers, beams, red, (int)particles, false, false);
+		while (!acks.empty()) {
+			server.acknowledge(acks.front());
+			acks.pop_front();
+		}
+		server.write(scene, focus, packet);
+		bytes += packet.size();
+		carried += server.sent();
+
+		std::deque<vector<uint8_t>> arriving;
+		arriving.swap(packets);
+		if (chance() >= loss)
+			packets.push_back(packet);
+		for (const vector<uint8_t>& p : arriving) {
+			if (client.receive(p, ack) && chance() >= loss)
+				acks.push_back(ack);
+		}
+
+		// How far the spectator's molecules are from where the host has them, once it has settled
+		if (tick >= ticks / 2 && tick % 10 == 0) {
+			for (size_t i = 0; i < particles; i++) {
+				if (!client.known(i))
+					continue;
+				double error = glm::length(client.scene().position(i) - system.position(i));
+				errorSum += error;
+				result.maxError = std::max(result.maxError, error);
+				samples++;
+			}
+		}
+	}
+	result.bytesPerTick = (double)bytes / ticks;
+	result.particlesPerTick = (double)carried / ticks;
+	result.fullBytes = particles * (7 * sizeof(float) + 1);
+	result.quantizedBytes = particles * sizeof(ReplicatedParticle);
+	result.meanError = samples ? errorSum / samples : 0.0;
+	return result;
+}
\ No newline at end of file
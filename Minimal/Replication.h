@@ -0,0 +1,189 @@
+#pragma once
+// Std. Includes
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "ParticleSystem.h"
+
+// Writes values of up to 32 bits into a byte stream, low bits first
+class BitWriter {
+public:
+	vector<uint8_t> bytes;
+
+	void write(uint32_t value, int bits);
+	// Small values in few bits: a 2 bit width class, then 4, 8, 16 or 32 bits
+	void writeUnsigned(uint32_t value);
+	void writeSigned(int32_t value);
+	// Pads the last byte out; call once before sending
+	void flush();
+	size_t bitCount() const { return this->bits; }
+
+private:
+	uint64_t scratch = 0;
+	int pending = 0;
+	size_t bits = 0;
+};
+
+// Reads what a BitWriter wrote. Reading past the end yields zeros and sets failed().
+class BitReader {
+public:
+	BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+	uint32_t read(int bits);
+	uint32_t readUnsigned();
+	int32_t readSigned();
+	bool failed() const { return this->overrun; }
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t bit = 0;
+	bool overrun = false;
+};
+
+// A molecule as it travels: position in 16 bits an axis over POSITION_RANGE, spin angle in
+// 16 bits a turn, axis in 8 bits a component
+struct ReplicatedParticle {
+	uint16_t position[3];
+	uint16_t angle;
+	int8_t axis[3];
+	uint8_t kind;
+};
+
+struct ReplicatedLaser {
+	uint16_t origin[3];
+	int16_t direction[3];
+	uint16_t length;
+	uint8_t red;
+};
+
+// What a spectator sees of the game, quantized
+struct ReplicatedScene {
+	// Positions are quantized within [-POSITION_RANGE, POSITION_RANGE] metres on each axis
+	static const float POSITION_RANGE;
+	// One full turn of the spin angle, in the units glm::rotate takes (degrees here)
+	static const float ANGLE_PERIOD;
+
+	vector<ReplicatedParticle> particles;
+	ReplicatedLaser lasers[2];
+	int32_t co2Count = 0;
+	bool win = false, lose = false;
+
+	ReplicatedScene();
+
+	// Quantizes the live game
+	void capture(const ParticleSystem& source, const glm::mat4 laserTransforms[2], const float beamLength[2], const bool red[2], int co2, bool won, bool lost);
+
+	glm::vec3 position(size_t i) const;
+	// translate * scale * spin, as ParticleSystem::transform
+	glm::mat4 transform(size_t i, float scale) const;
+	glm::vec3 laserOrigin(int hand) const;
+	glm::vec3 laserDirection(int hand) const;
+	float laserLength(int hand) const;
+};
+
+// The host's side. Each tick it sends what changed against the newest state the spectator
+// acknowledged, not the whole scene: every particle is delta coded against its value in
+// that baseline, in as few bits as the change needs. Particles that don't fit in the byte
+// budget wait for a later tick; the ones that waited longest and are nearest the player go
+// first, so a big scene updates what matters every tick and the rest in turn.
+class ReplicationServer {
+public:
+	// Packets the baselines can be this far behind; older acks mean starting from nothing
+	static const uint32_t HISTORY = 32;
+	// Bytes a packet can take, whatever the budget
+	static const size_t MAX_PACKET_BYTES = 64 * 1024;
+
+	size_t budgetBytes = 8 * 1024;
+
+	ReplicationServer();
+
+	// Starts the spectator from nothing again. The sequence runs on, so a spectator still
+	// attached from before takes the new packets as newer than what it has.
+	void restart();
+	// The packet for this tick of scene, with particles near focus first
+	void write(const ReplicatedScene& scene, glm::vec3 focus, vector<uint8_t>& packet);
+	// An ack from the spectator; false if it isn't one
+	bool acknowledge(const vector<uint8_t>& ack);
+
+	uint32_t sequence() const { return this->next - 1; }
+	// Particles in the last packet, and those left for later ticks
+	size_t sent() const { return this->lastSent; }
+	size_t waiting() const { return this->lastWaiting; }
+
+private:
+	uint32_t next = 1;
+	// First packet since the last restart; acks for older ones are stale
+	uint32_t first = 1;
+	// Newest packet the spectator has, 0 for none
+	uint32_t acked = 0;
+	// The spectator's particles as of each recent packet, once it gets that packet
+	vector<ReplicatedParticle> states[HISTORY];
+	uint32_t stateSequence[HISTORY];
+	// Accumulated priority, and the packet that last carried each particle
+	vector<float> priority;
+	vector<uint32_t> lastCarried;
+	vector<uint32_t> order;
+	size_t lastSent = 0, lastWaiting = 0;
+};
+
+// The spectator's side: decodes packets into the scene it shows and answers each with an ack
+class ReplicationClient {
+public:
+	// False if the packet is damaged or its baseline is too old to have; no ack then
+	bool receive(const vector<uint8_t>& packet, vector<uint8_t>& ack);
+
+	const ReplicatedScene& scene() const { return this->shown; }
+	// Whether particle i has arrived yet; the rest of shown is zeros
+	bool known(size_t i) const { return i < this->updated.size() && this->updated[i] != 0; }
+	uint32_t sequence() const { return this->newest; }
+
+private:
+	uint32_t newest = 0;
+	ReplicatedScene shown;
+	// Packet that last updated each shown particle
+	vector<uint32_t> updated;
+	vector<ReplicatedParticle> states[ReplicationServer::HISTORY];
+	uint32_t stateSequence[ReplicationServer::HISTORY] = {};
+};
+
+// Carries packets between two processes on this machine through shared memory, one queue
+// each way. Like a datagram socket it drops what doesn't fit and never blocks, so a slow
+// spectator can't hold up the frame; the acks sort out what got through.
+class SharedMemoryLink {
+public:
+	// The host creates the link, a spectator opens the one the host made
+	bool host(const string& name);
+	bool join(const string& name);
+	void close();
+	~SharedMemoryLink() { close(); }
+
+	bool send(const vector<uint8_t>& packet);
+	bool receive(vector<uint8_t>& packet);
+
+private:
+	struct Channels;
+	// Windows handle of the mapping, kept as void* to leave Windows.h out of the header
+	void* mapping = nullptr;
+	Channels* channels = nullptr;
+	bool hosting = false;
+};
+
+// Bytes a tick takes to keep a spectator in sync with a scene of the given size, and how far behind it falls
+struct ReplicationBenchResult {
+	size_t particles = 0;
+	double bytesPerTick = 0.0;
+	double particlesPerTick = 0.0;
+	// Bytes a tick for the full scene, as floats and quantized
+	size_t fullBytes = 0, quantizedBytes = 0;
+	// Distance between the spectator's and the host's positions, mean and worst, in metres
+	double meanError = 0.0, maxError = 0.0;
+};
+
+// Runs the host and a spectator side by side for ticks ticks, with packets delayed a tick
+// and dropped at the loss rate
+ReplicationBenchResult benchmarkReplication(size_t particles, int ticks, size_t budgetBytes, float loss);
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "SceneBVH.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+// Instances per top level leaf
+static const GLuint MAX_LEAF_INSTANCES = 2;
+// Rebuild once refitting has made the tree this much more expensive than when built
+static const float REBUILD_COST_RATIO = 1.5f;
+
+void SceneBVH::resize(size_t count)
+{
+	instances.resize(count);
+	instanceMin.resize(count);
+	instanceMax.resize(count);
+}
+
+void SceneBVH::setInstance(size_t index, const Model* model, const glm::mat4& toWorld, unsigned mask, int id)
+{
+	SceneInstance& instance = instances[index];
+	instance.model = model;
+	instance.toObject = glm::inverse(toWorld);
+	instance.mask = mask;
+	instance.id = id;
+
+	// World box of the transformed model box (Arvo): move the center, and grow the
+	// half extents by the absolute value of the rotation/scale part
+	glm::vec3 center = (model->boundsMin() + model->boundsMax()) * 0.5f;
+	glm::vec3 half = (model->boundsMax() - model->boundsMin()) * 0.5f;
+	glm::vec3 worldCenter = glm::vec3(toWorld * glm::vec4(center, 1.0f));
+	glm::vec3 worldHalf;
+	for (int i = 0; i < 3; i++) {
+		worldHalf[i] = std::abs(toWorld[0][i]) * half.x + std::abs(toWorld[1][i]) * half.y + std::abs(toWorld[2][i]) * half.z;
+	}
+	instanceMin[index] = worldCenter - worldHalf;
+	instanceMax[index] = worldCenter + worldHalf;
+}
+
+float SceneBVH::cost() const
+{
+	// Surface area heuristic of the whole tree relative to its root
+	float total = 0.0f;
+	for (const BVHNode& node : nodes) {
+		glm::vec3 e = glm::vec3(node.boundsMax[0] - node.boundsMin[0], node.boundsMax[1] - node.boundsMin[1], node.boundsMax[2] - node.boundsMin[2]);
+		float area = e.x * e.y + e.y * e.z + e.z * e.x;
+		total += node.isLeaf() ? area * node.count : area;
+	}
+	return total;
+}
+
+void SceneBVH::update()
+{
+	if (instances.size() != builtCount || nodes.empty()) {
+		buildHierarchy(nodes, order, instanceMin, instanceMax, MAX_LEAF_INSTANCES);
+		builtCount = instances.size();
+		builtCost = cost();
+	}
+	else {
+		refitHierarchy(nodes, order, instanceMin, instanceMax);
+		if (cost() > builtCost * REBUILD_COST_RATIO) {
+			buildHierarchy(nodes, order, instanceMin, instanceMax, MAX_LEAF_INSTANCES);
+			builtCost = cost();
+		}
+	}
+
+	nodeMask.assign(nodes.size(), 0);
+	for (size_t n = nodes.size(); n-- > 0;) {
+		const BVHNode& node = nodes[n];
+		if (node.isLeaf()) {
+			for (GLuint i = node.leftFirst; i < node.leftFirst + node.count; i++)
+				nodeMask[n] |= instances[order[i]].mask;
+		}
+		else {
+			nodeMask[n] = nodeMask[node.leftFirst] | nodeMask[node.leftFirst + 1];
+		}
+	}
+}
+
+template <typename Visit>
+void SceneBVH::traverse(const Ray& ray, unsigned mask, float& tMax, Visit visit) const
+{
+	if (nodes.empty()) {
+		return;
+	}
+	glm::vec3 inv = glm::vec3(1.0f) / ray.direction;
+	auto enter = [&](GLuint n, float& tEnter) {
+		const BVHNode& node = nodes[n];
+		if (!(nodeMask[n] & mask)) return false;
+		float tmin = 0.0f, tmax = tMax;
+		for (int a = 0; a < 3; a++) {
+			float t1 = (node.boundsMin[a] - ray.origin[a]) * inv[a];
+			float t2 = (node.boundsMax[a] - ray.origin[a]) * inv[a];
+			tmin = std::max(tmin, std::min(t1, t2));
+			tmax = std::min(tmax, std::max(t1, t2));
+		}
+		tEnter = tmin;
+		return tmin <= tmax;
+	};
+
+	// buildHierarchy caps the depth, so the stack holds every sibling left waiting
+	GLuint stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	float tEnter;
+	if (enter(0, tEnter)) {
+		stack[stackSize++] = 0;
+	}
+	while (stackSize > 0) {
+		const BVHNode& node = nodes[stack[--stackSize]];
+		if (node.isLeaf()) {
+			for (GLuint i = node.leftFirst; i < node.leftFirst + node.count; i++) {
+				const SceneInstance& instance = instances[order[i]];
+				if (!(instance.mask & mask)) continue;
+				// Bottom level: trace the mesh hierarchies in the instance's own space
+				RayPacket packet;
+				packet.set(0, ray, instance.toObject);
+				packet.t[0] = tMax;
+				instance.model->intersect(packet);
+				if (packet.t[0] < tMax) {
+					visit((int)order[i], packet.t[0]);
+				}
+			}
+			continue;
+		}
+
+		float tLeft, tRight;
+		bool hitLeft = enter(node.leftFirst, tLeft);
+		bool hitRight = enter(node.leftFirst + 1, tRight);
+		assert(stackSize + 2 <= BVH_STACK_SIZE);
+		if (hitLeft && hitRight) {
+			// Nearer child on top of the stack
+			stack[stackSize++] = tLeft <= tRight ? node.leftFirst + 1 : node.leftFirst;
+			stack[stackSize++] = tLeft <= tRight ? node.leftFirst : node.leftFirst + 1;
+		}
+		else if (hitLeft) {
+			stack[stackSize++] = node.leftFirst;
+		}
+		else if (hitRight) {
+			stack[stackSize++] = node.leftFirst + 1;
+		}
+	}
+}
+
+bool SceneBVH::intersect(const Ray& ray, unsigned mask, SceneHit& hit) const
+{
+	float tMax = ray.tMax;
+	hit.instance = -1;
+	hit.t = tMax;
+	// Each hit shrinks tMax, so the rest of the traversal only looks closer
+	traverse(ray, mask, tMax, [&](int instance, float t) {
+		tMax = t;
+		hit.instance = instance;
+		hit.t = t;
+	});
+	return hit.instance >= 0;
+}
+
+void SceneBVH::intersectAll(const Ray& ray, unsigned mask, vector<SceneHit>& hits) const
+{
+	hits.clear();
+	float tMax = ray.tMax;
+	traverse(ray, mask, tMax, [&](int instance, float t) {
+		SceneHit hit;
+		hit.instance = instance;
+		hit.t = t;
+		hits.push_back(hit);
+	});
+}
@@ -0,0 +1,65 @@
+#pragma once
+// Std. Includes
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "BVH.h"
+#include "Model.h"
+
+// What an instance is, so a query can look at only some of them
+enum InstanceMask {
+	INSTANCE_STATIC = 1,
+	INSTANCE_CO2 = 2,
+	INSTANCE_O2 = 4,
+	INSTANCE_ALL = 0xff
+};
+
+// A model placed in the world
+struct SceneInstance {
+	const Model* model;
+	glm::mat4 toObject;
+	unsigned mask;
+	// Caller's handle for the instance, e.g. a particle index
+	int id;
+};
+
+struct SceneHit {
+	int instance;
+	float t;
+};
+
+// Top level of a two-level acceleration structure. The leaves are model instances
+// and each model brings its own per-mesh hierarchies as the bottom level. Moving
+// instances only refit the tree; it is rebuilt when the instance count changes or
+// the refitted tree has degraded too far from the one that was built.
+class SceneBVH {
+public:
+	/*  Scene Data  */
+	vector<SceneInstance> instances;
+	vector<BVHNode> nodes;
+
+	/*  Functions  */
+	// Sets the number of instances; call setInstance for each afterwards
+	void resize(size_t count);
+	void setInstance(size_t index, const Model* model, const glm::mat4& toWorld, unsigned mask, int id);
+	// Brings the tree up to date with the instances set since the last update
+	void update();
+
+	// Nearest hit among instances matching mask, within the ray's range
+	bool intersect(const Ray& ray, unsigned mask, SceneHit& hit) const;
+	// Every instance matching mask the ray hits within its range, unordered
+	void intersectAll(const Ray& ray, unsigned mask, vector<SceneHit>& hits) const;
+
+private:
+	vector<glm::vec3> instanceMin, instanceMax;
+	vector<GLuint> order;
+	// Union of the masks of every instance below each node
+	vector<unsigned> nodeMask;
+	size_t builtCount = 0;
+	float builtCost = 0.0f;
+
+	float cost() const;
+	template <typename Visit> void traverse(const Ray& ray, unsigned mask, float& tMax, Visit visit) const;
+};
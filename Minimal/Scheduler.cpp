@@ -0,0 +1,159 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+
+// Wheel resolution: 10 ms per slot, a turn of 256 slots
+static const std::clock_t TICK = CLOCKS_PER_SEC / 100 > 0 ? CLOCKS_PER_SEC / 100 : 1;
+static const int64_t SLOTS = 256;
+
+Scheduler::Scheduler(int workers)
+{
+	slots.resize(SLOTS);
+	current = std::clock();
+	wheelTick = tickOf(current);
+	for (int i = 0; i < workers; i++)
+		this->workers.push_back(thread(&Scheduler::workerMain, this));
+}
+
+Scheduler::~Scheduler()
+{
+	{
+		lock_guard<mutex> guard(jobLock);
+		quit = true;
+	}
+	jobReady.notify_all();
+	for (thread& worker : workers)
+		worker.join();
+}
+
+void Scheduler::async(function<void()> work, function<void()> done)
+{
+	{
+		lock_guard<mutex> guard(jobLock);
+		jobs.push_back([this, work, done] {
+			work();
+			post(done);
+		});
+	}
+	jobReady.notify_one();
+}
+
+void Scheduler::post(function<void()> fn)
+{
+	lock_guard<mutex> guard(postLock);
+	posted.push_back(fn);
+}
+
+void Scheduler::workerMain()
+{
+	for (;;) {
+		function<void()> job;
+		{
+			unique_lock<mutex> guard(jobLock);
+			jobReady.wait(guard, [this] { return quit || !jobs.empty(); });
+			if (quit)
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+		job();
+	}
+}
+
+void Scheduler::runPosted()
+{
+	vector<function<void()>> batch;
+	{
+		lock_guard<mutex> guard(postLock);
+		batch.swap(posted);
+	}
+	// Continuations may post more; those wait for the next round
+	for (function<void()>& fn : batch)
+		fn();
+}
+
+void Scheduler::runUntil(function<bool()> done)
+{
+	while (!done()) {
+		runPosted();
+		this_thread::yield();
+	}
+}
+
+TimerId Scheduler::after(float seconds, function<void()> fn)
+{
+	Timer timer = { nextId++, current + (std::clock_t)(seconds * CLOCKS_PER_SEC), 0, fn };
+	live.insert(timer.id);
+	schedule(timer);
+	return timer.id;
+}
+
+TimerId Scheduler::every(float interval, function<void()> fn, float firstDelay)
+{
+	std::clock_t period = std::max<std::clock_t>((std::clock_t)(interval * CLOCKS_PER_SEC), 1);
+	std::clock_t delay = firstDelay < 0.0f ? period : (std::clock_t)(firstDelay * CLOCKS_PER_SEC);
+	Timer timer = { nextId++, current + delay, period, fn };
+	live.insert(timer.id);
+	schedule(timer);
+	return timer.id;
+}
+
+void Scheduler::cancel(TimerId id)
+{
+	live.erase(id);
+}
+
+void Scheduler::schedule(Timer timer)
+{
+	// Never behind the wheel, or it would wait a whole turn
+	int64_t tick = std::max(tickOf(timer.due), wheelTick);
+	slots[tick % SLOTS].push_back(timer);
+}
+
+int64_t Scheduler::tickOf(std::clock_t time) const
+{
+	return (int64_t)(time / TICK);
+}
+
+void Scheduler::update(std::clock_t now)
+{
+	runPosted();
+	current = now;
+
+	// Every slot the wheel passed since last time, at most one full turn
+	int64_t target = tickOf(now);
+	int64_t from = std::max(wheelTick, target - SLOTS + 1);
+	vector<Timer> due;
+	for (int64_t t = from; t <= target; t++) {
+		vector<Timer>& slot = slots[t % SLOTS];
+		for (size_t i = 0; i < slot.size();) {
+			if (!live.count(slot[i].id) || slot[i].due <= now) {
+				if (live.count(slot[i].id))
+					due.push_back(slot[i]);
+				slot[i] = slot.back();
+				slot.pop_back();
+			}
+			else {
+				i++;
+			}
+		}
+	}
+	// Stay on the current tick, timers later within it are still to come
+	wheelTick = target;
+
+	sort(due.begin(), due.end(), [](const Timer& a, const Timer& b) { return a.due < b.due; });
+	for (Timer& timer : due) {
+		// An earlier timer's callback may have cancelled this one
+		if (!live.count(timer.id))
+			continue;
+		if (timer.period == 0)
+			live.erase(timer.id);
+		timer.fn();
+		if (timer.period > 0 && live.count(timer.id)) {
+			timer.due += timer.period;
+			if (timer.due <= now)
+				timer.due = now + timer.period;
+			schedule(timer);
+		}
+	}
+}
\ No newline at end of file
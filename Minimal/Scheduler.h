@@ -0,0 +1,76 @@
+#pragma once
+// Std. Includes
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+// Handle of a scheduled timer, 0 for none
+typedef uint64_t TimerId;
+
+// Where asynchronous work and everything timed in the game runs. Jobs go to a pool of
+// worker threads and continue on the GL thread once done; timers sit in a hashed wheel
+// and fire from update() when due, so nothing in the frame has to poll for either.
+class Scheduler {
+public:
+	explicit Scheduler(int workers = 2);
+	~Scheduler();
+
+	// Runs work on a worker, then done on the GL thread in a later update
+	void async(function<void()> work, function<void()> done);
+	// Runs fn on the GL thread in the next update. Safe from any thread.
+	void post(function<void()> fn);
+
+	// GL thread only
+	TimerId after(float seconds, function<void()> fn);
+	// Fires every interval seconds, the first time after firstDelay (interval if negative)
+	TimerId every(float interval, function<void()> fn, float firstDelay = -1.0f);
+	void cancel(TimerId id);
+
+	// GL thread, once a frame: runs posted continuations, then every timer due by now
+	void update(std::clock_t now);
+	// Keeps running posted continuations until done() holds, for the rare blocking wait
+	void runUntil(function<bool()> done);
+
+	std::clock_t now() const { return current; }
+
+private:
+	struct Timer {
+		TimerId id;
+		std::clock_t due;
+		// Zero for one-shot timers
+		std::clock_t period;
+		function<void()> fn;
+	};
+
+	// Workers
+	vector<thread> workers;
+	deque<function<void()>> jobs;
+	mutex jobLock;
+	condition_variable jobReady;
+	bool quit = false;
+
+	// Continuations for the GL thread
+	vector<function<void()>> posted;
+	mutex postLock;
+
+	// Timer wheel: a timer lives in the slot of its due tick, and a slot is checked as the
+	// wheel passes it. Timers more than one turn out just wait in their slot for later turns.
+	vector<vector<Timer>> slots;
+	// Timers not yet fired or cancelled; anything else found in a slot is dropped
+	unordered_set<TimerId> live;
+	std::clock_t current = 0;
+	int64_t wheelTick = 0;
+	TimerId nextId = 1;
+
+	void workerMain();
+	void runPosted();
+	void schedule(Timer timer);
+	int64_t tickOf(std::clock_t time) const;
+};
\ No newline at end of file
@@ -1,21 +1,115 @@
 #include "Shader.h"
-
-GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path) {
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+#include "AssetArchive.h"
+
+// A shader file, or one it includes, from the mounted archive if it was cooked in, else from disk
+static bool ReadShaderFile(const std::string & path, std::string & code) {
+	const AssetArchive * archive = AssetArchive::mounted();
+	const AssetArchive::Entry * entry = archive ? archive->find(path) : NULL;
+	if (entry && archive->read(*entry, code))
+		return true;
+	code.clear();
+	std::ifstream stream(path, std::ios::in);
+	if (!stream.is_open())
+		return false;
+	std::string Line = "";
+	while (getline(stream, Line))
+		code += "\n" + Line;
+	return true;
+}
+
+// Replaces each #include "name" line of code with the file it names, looked up next to path
+// and expanded the same way. A file already in this shader is left out the second time, which
+// also keeps includes that come back around from going on forever.
+static void ExpandIncludes(std::string & code, const std::string & path, std::vector<std::string> & included) {
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	size_t start = 0;
+	while ((start = code.find("#include", start)) != std::string::npos) {
+		size_t lineEnd = code.find('\n', start);
+		if (lineEnd == std::string::npos)
+			lineEnd = code.size();
+		// Only a directive: one mentioned in a comment is left alone
+		size_t lineStart = code.find_last_of('\n', start);
+		lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+		if (code.find_first_not_of(" \t", lineStart) != start) {
+			start = lineEnd;
+			continue;
+		}
+		size_t open = code.find('"', start);
+		size_t close = open < lineEnd ? code.find('"', open + 1) : std::string::npos;
+		if (close == std::string::npos || close > lineEnd) {
+			printf("%s: #include needs a \"file\"\n", path.c_str());
+			start = lineEnd;
+			continue;
+		}
+		std::string name = directory + code.substr(open + 1, close - open - 1);
+		std::string text;
+		if (std::find(included.begin(), included.end(), name) == included.end()) {
+			included.push_back(name);
+			if (ReadShaderFile(name, text))
+				ExpandIncludes(text, name, included);
+			else
+				printf("Impossible to open %s, included from %s\n", name.c_str(), path.c_str());
+		}
+		code.replace(start, lineEnd - start, text);
+		start += text.size();
+	}
+}
+
+static void ExpandIncludes(ShaderSource & source) {
+	std::vector<std::string> included;
+	ExpandIncludes(source.vertex, source.vertexPath, included);
+	included.clear();
+	ExpandIncludes(source.fragment, source.fragmentPath, included);
+}
+
+ShaderSource ReadShaderSource(const char * vertex_file_path, const char * fragment_file_path) {
+	ShaderSource source;
+	source.vertexPath = vertex_file_path;
+	source.fragmentPath = fragment_file_path;
+
+	// Cooked into the mounted archive, both come from there
+	const AssetArchive * archive = AssetArchive::mounted();
+	const AssetArchive::Entry * vertexEntry = archive ? archive->find(vertex_file_path) : NULL;
+	const AssetArchive::Entry * fragmentEntry = archive ? archive->find(fragment_file_path) : NULL;
+	if (vertexEntry && fragmentEntry && archive->read(*vertexEntry, source.vertex) && archive->read(*fragmentEntry, source.fragment)) {
+		source.found = true;
+		ExpandIncludes(source);
+		return source;
+	}
+	source.vertex.clear();
+	source.fragment.clear();
 
 	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
 	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
 	if (VertexShaderStream.is_open()) {
 		std::string Line = "";
 		while (getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
+			source.vertex += "\n" + Line;
 		VertexShaderStream.close();
+		source.found = true;
 	}
-	else {
+
+	// Read the Fragment Shader code from the file
+	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+	if (FragmentShaderStream.is_open()) {
+		std::string Line = "";
+		while (getline(FragmentShaderStream, Line))
+			source.fragment += "\n" + Line;
+		FragmentShaderStream.close();
+	}
+	ExpandIncludes(source);
+	return source;
+}
+
+GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path, const std::string & vertexInputs) {
+	return CompileShaders(ReadShaderSource(vertex_file_path, fragment_file_path), vertexInputs);
+}
+
+GLuint CompileShaders(const ShaderSource & source, const std::string & vertexInputs) {
+	const char * vertex_file_path = source.vertexPath.c_str();
+	const char * fragment_file_path = source.fragmentPath.c_str();
+	if (!source.found) {
 		printf("Impossible to open %s. Check to make sure the file exists and you passed in the right filepath!\n", vertex_file_path);
 		printf("The current working directory is:");
 		// Please for the love of whatever deity/ies you believe in never do something like the next line of code,
@@ -29,16 +123,20 @@ GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_pat
 		return 0;
 	}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open()) {
-		std::string Line = "";
-		while (getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
+	// Declare the vertex inputs right after the version, which has to come first
+	std::string VertexShaderCode = source.vertex;
+	if (!vertexInputs.empty()) {
+		size_t version = VertexShaderCode.find("#version");
+		size_t lineEnd = version == std::string::npos ? 0 : VertexShaderCode.find('\n', version);
+		VertexShaderCode.insert(lineEnd == std::string::npos ? VertexShaderCode.size() : lineEnd, "\n" + vertexInputs);
 	}
 
+	const std::string & FragmentShaderCode = source.fragment;
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
@@ -105,4 +203,48 @@ GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_pat
 	glDeleteShader(FragmentShaderID);
 
 	return ProgramID;
-}
\ No newline at end of file
+}
+
+// code with a #define for each feature in mask, right after the #version line
+static std::string DefineFeatures(const std::string & code, unsigned mask, const std::vector<std::string> & features) {
+	std::string defines;
+	for (size_t i = 0; i < features.size(); i++) {
+		if (mask & (1u << i))
+			defines += "\n#define " + features[i] + " 1";
+	}
+	std::string defined = code;
+	size_t version = defined.find("#version");
+	size_t lineEnd = version == std::string::npos ? 0 : defined.find('\n', version);
+	defined.insert(lineEnd == std::string::npos ? defined.size() : lineEnd, defines);
+	return defined;
+}
+
+ShaderPermutations::ShaderPermutations(const ShaderSource & source, const std::vector<std::string> & features, const std::string & vertexInputs) {
+	this->source = source;
+	this->features = features;
+	this->vertexInputs = vertexInputs;
+}
+
+ShaderPermutations::~ShaderPermutations() {
+	for (auto& program : this->programs)
+		glDeleteProgram(program.second);
+}
+
+GLuint ShaderPermutations::get(unsigned mask) {
+	auto found = this->programs.find(mask);
+	if (found != this->programs.end())
+		return found->second;
+
+	ShaderSource variant = this->source;
+	variant.vertex = DefineFeatures(this->source.vertex, mask, this->features);
+	variant.fragment = DefineFeatures(this->source.fragment, mask, this->features);
+	printf("Variant %#x of %s:", mask, this->source.vertexPath.c_str());
+	for (size_t i = 0; i < this->features.size(); i++) {
+		if (mask & (1u << i))
+			printf(" %s", this->features[i].c_str());
+	}
+	printf("\n");
+	GLuint program = CompileShaders(variant, this->vertexInputs);
+	this->programs[mask] = program;
+	return program;
+}
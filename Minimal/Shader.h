@@ -228,6 +228,7 @@ GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_pat
 #include <stdio.h>
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -241,6 +242,40 @@ using namespace std;
 #endif
 #include <GLFW/glfw3.h>
 
-GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path);
+// The text of a vertex and fragment shader pair. Reading it makes no GL calls, so it can be
+// done on a worker before there is a context.
+struct ShaderSource {
+	std::string vertexPath, fragmentPath;
+	std::string vertex, fragment;
+	// Whether the vertex shader file was found
+	bool found = false;
+};
+// Each #include "file" line is replaced by that file, found next to the one including it
+ShaderSource ReadShaderSource(const char * vertex_file_path, const char * fragment_file_path);
+
+// vertexInputs, when given, is inserted after the vertex shader's #version line; see vertexInputs<V>()
+GLuint CompileShaders(const ShaderSource & source, const std::string & vertexInputs = "");
+// ReadShaderSource and CompileShaders in one
+GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path, const std::string & vertexInputs = "");
+
+// One shader pair compiled as many ways as its features combine. Bit i of a mask #defines
+// features[i] in both stages, right after #version, so the text can leave out what a draw
+// doesn't need with #ifdef. Each mask is compiled the first time it is asked for and kept,
+// with its program, until the permutations are destroyed.
+class ShaderPermutations {
+public:
+	ShaderPermutations(const ShaderSource & source, const std::vector<std::string> & features, const std::string & vertexInputs = "");
+	~ShaderPermutations();
+
+	// The program with the features of mask, compiled now if it hasn't been
+	GLuint get(unsigned mask);
+	size_t compiled() const { return this->programs.size(); }
+
+private:
+	ShaderSource source;
+	std::vector<std::string> features;
+	std::string vertexInputs;
+	std::unordered_map<unsigned, GLuint> programs;
+};
 
 #endif
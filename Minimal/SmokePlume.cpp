@@ -0,0 +1,172 @@
+#include "SmokePlume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <glm/gtc/noise.hpp>
+
+const int SmokePlume::NOISE_SIZE;
+const float SmokePlume::NOISE_METRES = 6.0f;
+// Golden ratio conjugate: each frame's jitter lands in the biggest gap the last ones left
+static const float JITTER_STEP = 0.618034f;
+
+SmokePlume::SmokePlume(const ShaderSource& march, const ShaderSource& composite)
+{
+	this->marchShader = CompileShaders(march);
+	this->compositeShader = CompileShaders(composite);
+	glGenVertexArrays(1, &this->VAO);
+	glGenFramebuffers(1, &this->framebuffer);
+	createNoise();
+}
+
+SmokePlume::~SmokePlume()
+{
+	for (int eye = 0; eye < 2; eye++)
+		glDeleteTextures(2, this->targets[eye]);
+	glDeleteTextures(1, &this->noise);
+	glDeleteFramebuffers(1, &this->framebuffer);
+	glDeleteVertexArrays(1, &this->VAO);
+	glDeleteProgram(this->marchShader);
+	glDeleteProgram(this->compositeShader);
+}
+
+void SmokePlume::createNoise()
+{
+	// Two octaves of Perlin noise that repeat across the volume, so it tiles as it scrolls up
+	const int n = NOISE_SIZE;
+	std::vector<unsigned char> texels(n * n * n);
+	for (int z = 0; z < n; z++) {
+		for (int y = 0; y < n; y++) {
+			for (int x = 0; x < n; x++) {
+				glm::vec3 p = glm::vec3((float)x, (float)y, (float)z) * (4.0f / n);
+				float value = 0.65f * glm::perlin(p, glm::vec3(4.0f)) + 0.35f * glm::perlin(p * 2.0f, glm::vec3(8.0f));
+				texels[(z * n + y) * n + x] = (unsigned char)(glm::clamp(value * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f);
+			}
+		}
+	}
+	glGenTextures(1, &this->noise);
+	glBindTexture(GL_TEXTURE_3D, this->noise);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, n, n, n, 0, GL_RED, GL_UNSIGNED_BYTE, &texels[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void SmokePlume::resize(int eye, glm::ivec2 size)
+{
+	glDeleteTextures(2, this->targets[eye]);
+	glGenTextures(2, this->targets[eye]);
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, this->targets[eye][i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	this->targetSize[eye] = size;
+	this->hasHistory[eye] = false;
+}
+
+void SmokePlume::draw(int eye, const glm::mat4& projection, const glm::mat4& view, GLuint depthTexture)
+{
+	if (this->divisor <= 0) {
+		this->hasHistory[0] = this->hasHistory[1] = false;
+		return;
+	}
+	GLint viewport[4], bound;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+	glm::ivec2 size((viewport[2] + this->divisor - 1) / this->divisor, (viewport[3] + this->divisor - 1) / this->divisor);
+	if (size.x != this->targetSize[eye].x || size.y != this->targetSize[eye].y)
+		resize(eye, size);
+	if (eye == 0)
+		this->frame++;
+
+	glm::mat4 viewProjection = projection * view;
+	glm::vec3 camera = glm::vec3(glm::inverse(view)[3]);
+	glm::vec4 eyeRect((float)viewport[0], (float)viewport[1], (float)viewport[2], (float)viewport[3]);
+	float top = this->radius;
+	glm::vec3 boxMin = this->base - glm::vec3(top, 0.0f, top);
+	glm::vec3 boxMax = this->base + glm::vec3(top, this->height, top);
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+	glBindVertexArray(this->VAO);
+
+	// March into this frame's target, reading last frame's
+	int next = 1 - this->current[eye];
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->targets[eye][next], 0);
+	glViewport(0, 0, size.x, size.y);
+	GLuint s = this->marchShader;
+	glUseProgram(s);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_3D, this->noise);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, this->targets[eye][this->current[eye]]);
+	glUniform1i(glGetUniformLocation(s, "sceneDepth"), 0);
+	glUniform1i(glGetUniformLocation(s, "noise"), 1);
+	glUniform1i(glGetUniformLocation(s, "history"), 2);
+	glUniform4fv(glGetUniformLocation(s, "eyeRect"), 1, &eyeRect[0]);
+	glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+	glUniformMatrix4fv(glGetUniformLocation(s, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+	glUniformMatrix4fv(glGetUniformLocation(s, "previousViewProjection"), 1, GL_FALSE, &this->previousViewProjection[eye][0][0]);
+	glUniform3fv(glGetUniformLocation(s, "eye"), 1, &camera[0]);
+	glUniform3fv(glGetUniformLocation(s, "base"), 1, &this->base[0]);
+	glUniform1f(glGetUniformLocation(s, "height"), this->height);
+	glUniform1f(glGetUniformLocation(s, "radius"), this->radius);
+	glUniform3fv(glGetUniformLocation(s, "boxMin"), 1, &boxMin[0]);
+	glUniform3fv(glGetUniformLocation(s, "boxMax"), 1, &boxMax[0]);
+	glUniform1f(glGetUniformLocation(s, "density"), this->density);
+	glUniform1f(glGetUniformLocation(s, "noiseScale"), 1.0f / NOISE_METRES);
+	glUniform1f(glGetUniformLocation(s, "rise"), std::fmod(this->rise, NOISE_METRES));
+	glUniform3fv(glGetUniformLocation(s, "smokeColor"), 1, &this->color[0]);
+	glm::vec3 lightDir = glm::normalize(glm::vec3(0.0f, 5.0f, 5.0f));
+	glUniform3fv(glGetUniformLocation(s, "lightDir"), 1, &lightDir[0]);
+	glUniform1i(glGetUniformLocation(s, "steps"), std::max(this->steps, 1));
+	glUniform1f(glGetUniformLocation(s, "jitter"), std::fmod(this->frame * JITTER_STEP, 1.0f));
+	glUniform1f(glGetUniformLocation(s, "historyWeight"), this->hasHistory[eye] ? this->historyWeight : 0.0f);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+	this->current[eye] = next;
+	this->hasHistory[eye] = true;
+	this->previousViewProjection[eye] = viewProjection;
+
+	// Then over the eye, premultiplied
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bound);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	s = this->compositeShader;
+	glUseProgram(s);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, this->targets[eye][next]);
+	glUniform1i(glGetUniformLocation(s, "sceneDepth"), 0);
+	glUniform1i(glGetUniformLocation(s, "smoke"), 2);
+	glUniform4fv(glGetUniformLocation(s, "eyeRect"), 1, &eyeRect[0]);
+	glUniform2f(glGetUniformLocation(s, "smokeSize"), (float)size.x, (float)size.y);
+	glUniform2f(glGetUniformLocation(s, "linearize"), projection[3][2], projection[2][2]);
+	glUniform1f(glGetUniformLocation(s, "depthTolerance"), 0.05f);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glDisable(GL_BLEND);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_3D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindVertexArray(0);
+	glDepthMask(GL_TRUE);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+}
\ No newline at end of file
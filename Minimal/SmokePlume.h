@@ -0,0 +1,59 @@
+#pragma once
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+// Smoke rising from a chimney. The plume is marched through a tiling noise volume into a
+// target a fraction of each eye's size, blended each frame with the last one, then laid over
+// the eye with the scene's depth. The march takes a fixed number of steps per smoke pixel,
+// so what it costs follows divisor and steps and not how much of the view the plume fills.
+class SmokePlume {
+public:
+	// Foot of the plume, its height and its radius at the top
+	glm::vec3 base = glm::vec3(0.0f);
+	float height = 8.0f;
+	float radius = 2.5f;
+	// Extinction per metre at the thickest, and how fast the smoke rises in metres a second
+	float density = 1.5f;
+	float riseSpeed = 0.6f;
+	glm::vec3 color = glm::vec3(0.55f, 0.55f, 0.58f);
+	// Eye pixels per smoke pixel along each axis: 2 for half resolution, 4 for quarter, 0 for no smoke
+	int divisor = 2;
+	int steps = 24;
+	// Share of each smoke pixel that comes from last frame's
+	float historyWeight = 0.85f;
+
+	// march is smoke.vert and smoke.frag, composite smoke.vert and smoke_composite.frag
+	SmokePlume(const ShaderSource& march, const ShaderSource& composite);
+	~SmokePlume();
+
+	void update(float seconds) { this->rise += this->riseSpeed * seconds; }
+	// Lays the smoke over the viewport of the bound framebuffer, eye 0 or 1 of the render
+	// target whose depth is in depthTexture. That texture must not be attached while it draws.
+	void draw(int eye, const glm::mat4& projection, const glm::mat4& view, GLuint depthTexture);
+
+private:
+	// Noise texels along each side of the volume, and metres it spans before repeating
+	static const int NOISE_SIZE = 32;
+	static const float NOISE_METRES;
+
+	GLuint marchShader = 0, compositeShader = 0;
+	// smoke.vert needs no vertices, but GL wants a vertex array bound to draw
+	GLuint VAO = 0;
+	GLuint noise = 0;
+	GLuint framebuffer = 0;
+	// Per eye, this frame's smoke and last frame's, swapping each frame
+	GLuint targets[2][2] = { { 0, 0 }, { 0, 0 } };
+	glm::ivec2 targetSize[2];
+	int current[2] = { 0, 0 };
+	bool hasHistory[2] = { false, false };
+	glm::mat4 previousViewProjection[2];
+	float rise = 0.0f;
+	unsigned frame = 0;
+
+	void createNoise();
+	// (Re)creates eye's targets for a viewport of size, with no history
+	void resize(int eye, glm::ivec2 size);
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "Snapshot.h"
+
+#include <cstdio>
+#include <fstream>
+
+const uint32_t Snapshot::MAGIC;
+const uint32_t Snapshot::VERSION;
+
+void Snapshot::begin()
+{
+	data.clear();
+	cursor = 0;
+	put(MAGIC);
+	put(VERSION);
+}
+
+bool Snapshot::open()
+{
+	cursor = 0;
+	uint32_t magic, version;
+	return get(magic) && magic == MAGIC && get(version) && version == VERSION;
+}
+
+void Snapshot::append(const void* bytes, size_t size)
+{
+	size_t at = data.size();
+	data.resize(at + size);
+	memcpy(&data[at], bytes, size);
+}
+
+bool Snapshot::extract(void* bytes, size_t size)
+{
+	if (size > data.size() - cursor)
+		return false;
+	memcpy(bytes, &data[cursor], size);
+	cursor += size;
+	return true;
+}
+
+bool Snapshot::saveFile(const string& path) const
+{
+	// Write beside the old file and swap, so a crash mid-write never loses the last good one
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp, ios::binary | ios::trunc);
+		if (!file.write(data.data(), data.size()))
+			return false;
+	}
+	remove(path.c_str());
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+bool Snapshot::loadFile(const string& path)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	if (!file)
+		return false;
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	cursor = 0;
+	return data.empty() || (bool)file.read(&data[0], data.size());
+}
+
+SnapshotWriter::SnapshotWriter()
+{
+	worker = thread(&SnapshotWriter::run, this);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	{
+		lock_guard<mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void SnapshotWriter::submit(Snapshot& snapshot, const string& path)
+{
+	{
+		lock_guard<mutex> guard(lock);
+		pending.data.swap(snapshot.data);
+		pendingPath = path;
+		hasPending = true;
+	}
+	snapshot.data.clear();
+	wake.notify_one();
+}
+
+void SnapshotWriter::run()
+{
+	Snapshot writing;
+	string path;
+	for (;;) {
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [this] { return quit || hasPending; });
+			// Whatever was submitted last still gets written on the way out
+			if (!hasPending)
+				return;
+			writing.data.swap(pending.data);
+			path = pendingPath;
+			hasPending = false;
+		}
+		writing.saveFile(path);
+	}
+}
\ No newline at end of file
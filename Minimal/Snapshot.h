@@ -0,0 +1,82 @@
+#pragma once
+// Std. Includes
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// A versioned binary image of game state. Values and arrays are appended as raw bytes
+// behind a small header, so taking a snapshot is a run of memcpys out of the live
+// arrays and restoring one is a single read of the file plus a run of memcpys back.
+// Fields are read back in the order they were written.
+class Snapshot {
+public:
+	static const uint32_t MAGIC = 0x53324f43; // "CO2S"
+	// Bump whenever a field is added, removed or reordered
+	static const uint32_t VERSION = 3;
+
+	vector<char> data;
+
+	// Starts a new snapshot: clears it and writes the header
+	void begin();
+	template <typename T> void put(const T& value)
+	{
+		append(&value, sizeof(T));
+	}
+	template <typename T> void putArray(const vector<T>& values)
+	{
+		put((uint64_t)values.size());
+		if (!values.empty())
+			append(&values[0], values.size() * sizeof(T));
+	}
+
+	// Checks the header and rewinds to the first field. False for foreign or older data.
+	bool open();
+	template <typename T> bool get(T& value)
+	{
+		return extract(&value, sizeof(T));
+	}
+	template <typename T> bool getArray(vector<T>& values)
+	{
+		uint64_t count;
+		if (!get(count) || count * sizeof(T) > data.size() - cursor)
+			return false;
+		values.resize((size_t)count);
+		return count == 0 || extract(&values[0], (size_t)count * sizeof(T));
+	}
+
+	bool saveFile(const string& path) const;
+	bool loadFile(const string& path);
+
+private:
+	size_t cursor = 0;
+
+	void append(const void* bytes, size_t size);
+	bool extract(void* bytes, size_t size);
+};
+
+// Writes snapshots to disk on a thread of its own so the frame only pays for the copy.
+// If a new snapshot arrives before the last one was written the older one is dropped.
+class SnapshotWriter {
+public:
+	SnapshotWriter();
+	~SnapshotWriter();
+
+	// Takes over the snapshot's data; the caller's snapshot is left empty
+	void submit(Snapshot& snapshot, const string& path);
+
+private:
+	Snapshot pending;
+	string pendingPath;
+	bool hasPending = false;
+	bool quit = false;
+	mutex lock;
+	condition_variable wake;
+	thread worker;
+
+	void run();
+};
\ No newline at end of file
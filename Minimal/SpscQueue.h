@@ -0,0 +1,49 @@
+#pragma once
+// Std. Includes
+#include <atomic>
+#include <cstddef>
+using namespace std;
+
+// Fixed size ring passing values from exactly one producer thread to exactly one consumer
+// thread without locks. Neither side ever waits: push fails when the ring is full and pop
+// fails when it is empty, so a real-time thread can sit on either end.
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+public:
+	// Producer only
+	bool push(const T& value)
+	{
+		size_t tail = this->tail.load(memory_order_relaxed);
+		if (tail - head.load(memory_order_acquire) == N)
+			return false;
+		items[tail & (N - 1)] = value;
+		this->tail.store(tail + 1, memory_order_release);
+		return true;
+	}
+
+	// Consumer only
+	bool pop(T& value)
+	{
+		size_t head = this->head.load(memory_order_relaxed);
+		if (head == tail.load(memory_order_acquire))
+			return false;
+		value = items[head & (N - 1)];
+		this->head.store(head + 1, memory_order_release);
+		return true;
+	}
+
+	// Either side; only a hint while the other side is running
+	size_t size() const
+	{
+		return tail.load(memory_order_acquire) - head.load(memory_order_acquire);
+	}
+
+private:
+	T items[N];
+	// Counters only ever grow. Padded apart so the two threads don't share a cache line; padding
+	// rather than alignas, which the scene's plain new can't honour.
+	atomic<size_t> head{ 0 };
+	char padding[64];
+	atomic<size_t> tail{ 0 };
+};
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "StartupTimeline.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+// History lines kept for the median
+static const size_t HISTORY_RUNS = 20;
+// Width of the bars drawn for the timeline
+static const int BAR_WIDTH = 50;
+
+StartupTimeline::Phase::Phase(StartupTimeline& timeline, const string& name, const string& waitsFor)
+	: timeline(timeline)
+{
+	this->index = timeline.begin(name, waitsFor);
+}
+
+void StartupTimeline::Phase::end()
+{
+	if (!this->open)
+		return;
+	this->timeline.end(this->index);
+	this->open = false;
+}
+
+StartupTimeline::StartupTimeline()
+{
+	this->origin = chrono::steady_clock::now();
+	// The thread that makes the timeline is the main one, thread 0
+	this->threads.push_back(this_thread::get_id());
+}
+
+double StartupTimeline::seconds() const
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - this->origin).count();
+}
+
+int StartupTimeline::threadIndex(thread::id id)
+{
+	for (size_t i = 0; i < this->threads.size(); i++) {
+		if (this->threads[i] == id)
+			return (int)i;
+	}
+	this->threads.push_back(id);
+	return (int)this->threads.size() - 1;
+}
+
+size_t StartupTimeline::begin(const string& name, const string& waitsFor)
+{
+	double now = this->seconds();
+	lock_guard<mutex> guard(this->lock);
+	Span span = { name, this->threadIndex(this_thread::get_id()), now, -1.0, waitsFor };
+	this->spans.push_back(span);
+	return this->spans.size() - 1;
+}
+
+void StartupTimeline::end(size_t id)
+{
+	double now = this->seconds();
+	lock_guard<mutex> guard(this->lock);
+	this->spans[id].end = now;
+}
+
+void StartupTimeline::finish(ostream& out, const string& historyPath)
+{
+	if (this->done)
+		return;
+	this->firstFrame = this->seconds();
+	this->done = true;
+
+	// The runs before, newest last, one time in milliseconds a line
+	vector<double> history;
+	ifstream in(historyPath);
+	double ms;
+	while (in >> ms)
+		history.push_back(ms);
+	in.close();
+	if (history.size() > HISTORY_RUNS)
+		history.erase(history.begin(), history.end() - HISTORY_RUNS);
+	this->previousRuns = history.size();
+	if (!history.empty()) {
+		vector<double> sorted = history;
+		sort(sorted.begin(), sorted.end());
+		this->previousMedian = sorted[sorted.size() / 2] / 1000.0;
+	}
+
+	this->report(out);
+
+	history.push_back(this->firstFrame * 1000.0);
+	ofstream file(historyPath, ios::trunc);
+	for (double run : history)
+		file << fixed << setprecision(1) << run << "\n";
+}
+
+void StartupTimeline::report(ostream& out) const
+{
+	lock_guard<mutex> guard(this->lock);
+	double total = this->done ? this->firstFrame : this->seconds();
+	ios::fmtflags flags = out.flags();
+	streamsize precision = out.precision();
+	out << fixed << setprecision(1);
+
+	out << "Startup timeline, ms from WinMain (thread 0 is the main thread):" << endl;
+	for (const Span& span : this->spans) {
+		double end = span.end < 0.0 ? total : span.end;
+		int from = total > 0.0 ? (int)(span.start / total * BAR_WIDTH) : 0;
+		int to = total > 0.0 ? max(from + 1, (int)(end / total * BAR_WIDTH)) : 1;
+		string bar = string(min(from, BAR_WIDTH), ' ') + string(max(0, min(to, BAR_WIDTH) - from), span.waitsFor.empty() ? '#' : '.');
+		out << setw(8) << span.start * 1000.0 << setw(8) << (end - span.start) * 1000.0 << "  " << span.thread << "  |"
+			<< left << setw(BAR_WIDTH) << bar << right << "|  " << span.name << endl;
+	}
+
+	// Main thread work in order, with each wait standing for what it waited on. Phases inside
+	// another (a job run on the main thread as it's waited for) are already counted.
+	out << "Critical path:";
+	double path = 0.0, covered = 0.0;
+	for (const Span& span : this->spans) {
+		if (span.thread != 0 || span.end < 0.0 || span.start < covered)
+			continue;
+		double length = span.end - span.start;
+		if (length >= 0.001)
+			out << (span.waitsFor.empty() ? " " + span.name : " [" + span.waitsFor + "]") << " " << length * 1000.0;
+		path += length;
+		covered = span.end;
+	}
+	out << endl << "Phases cover " << path * 1000.0 << " of " << total * 1000.0 << " ms on the main thread" << endl;
+
+	if (this->done) {
+		out << "Time to first frame: " << this->firstFrame * 1000.0 << " ms";
+		if (this->previousRuns)
+			out << ", median of the " << this->previousRuns << " runs before " << this->previousMedian * 1000.0 << " ms";
+		out << endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+StartupTimeline& startupTimeline()
+{
+	static StartupTimeline timeline;
+	return timeline;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+// Std. Includes
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Records what startup does, on which thread and when, from WinMain to the first frame on
+// the headset. Phases are spans on one thread; a wait is a phase where a thread sat blocked
+// on another phase's result, which is how the critical path crosses threads. finish() at
+// the first frame prints the timeline and the critical path, and appends the time to first
+// frame to a history file so runs can be compared.
+class StartupTimeline {
+public:
+	// A phase that ends when it goes out of scope, or at end()
+	class Phase {
+	public:
+		Phase(StartupTimeline& timeline, const string& name, const string& waitsFor = "");
+		~Phase() { end(); }
+		void end();
+		size_t id() const { return index; }
+	private:
+		StartupTimeline& timeline;
+		size_t index;
+		bool open = true;
+	};
+
+	StartupTimeline();
+
+	// Starts a phase on the calling thread and returns its id. For a wait, waitsFor names the
+	// phase whose result the thread is blocked on.
+	size_t begin(const string& name, const string& waitsFor = "");
+	void end(size_t id);
+	double seconds() const;
+
+	// The first frame is out: prints the report to out and records the time in historyPath
+	void finish(ostream& out, const string& historyPath);
+	bool finished() const { return done; }
+
+	// Timeline, critical path and time to first frame
+	void report(ostream& out) const;
+
+private:
+	struct Span {
+		string name;
+		int thread;
+		double start, end;
+		string waitsFor;
+	};
+
+	chrono::steady_clock::time_point origin;
+	mutable mutex lock;
+	vector<Span> spans;
+	vector<thread::id> threads;
+	double firstFrame = 0.0;
+	bool done = false;
+	// Median time to first frame of the runs before this one, 0 without any
+	double previousMedian = 0.0;
+	size_t previousRuns = 0;
+
+	int threadIndex(thread::id id);
+};
+
+// The one timeline, started on first use; call it first thing in WinMain
+StartupTimeline& startupTimeline();
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+// Std. Includes
+#include <cstddef>
+#include <cstdint>
+#include <string>
+using namespace std;
+// GL Includes
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+// One field of a vertex struct as a shader input
+struct VertexAttribute {
+	// Name of the shader input
+	const char* name;
+	GLuint location;
+	// Component type and count in the buffer; a mat4 is 16 floats over four locations
+	GLenum type;
+	GLint count;
+	// Fixed point read as floats in [0, 1] or [-1, 1]; integers that aren't are read as ints
+	GLboolean normalized;
+	// 0 advances per vertex, n per n instances
+	GLuint divisor;
+	size_t offset;
+};
+
+// Component type and count of a field's C++ type
+template <typename T> struct AttributeFormat;
+template <> struct AttributeFormat<float> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 1; };
+template <> struct AttributeFormat<glm::vec2> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 2; };
+template <> struct AttributeFormat<glm::vec3> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 3; };
+template <> struct AttributeFormat<glm::vec4> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::mat4> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 16; };
+template <> struct AttributeFormat<int32_t> { static constexpr GLenum type = GL_INT; static constexpr GLint count = 1; };
+template <> struct AttributeFormat<uint32_t> { static constexpr GLenum type = GL_UNSIGNED_INT; static constexpr GLint count = 1; };
+template <> struct AttributeFormat<glm::ivec4> { static constexpr GLenum type = GL_INT; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::uvec4> { static constexpr GLenum type = GL_UNSIGNED_INT; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::u8vec4> { static constexpr GLenum type = GL_UNSIGNED_BYTE; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::i8vec4> { static constexpr GLenum type = GL_BYTE; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::u16vec2> { static constexpr GLenum type = GL_UNSIGNED_SHORT; static constexpr GLint count = 2; };
+template <> struct AttributeFormat<glm::i16vec2> { static constexpr GLenum type = GL_SHORT; static constexpr GLint count = 2; };
+template <> struct AttributeFormat<glm::i16vec4> { static constexpr GLenum type = GL_SHORT; static constexpr GLint count = 4; };
+template <> struct AttributeFormat<glm::u16vec4> { static constexpr GLenum type = GL_UNSIGNED_SHORT; static constexpr GLint count = 4; };
+
+constexpr size_t componentSize(GLenum type)
+{
+	return type == GL_BYTE || type == GL_UNSIGNED_BYTE ? 1
+		: type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ? 2
+		: 4;
+}
+
+// An attribute for a field of type T at offset. Use as VERTEX_ATTRIBUTE(V, field, name, location[, normalized[, divisor]]),
+// which takes T and offset from the field.
+template <typename T>
+constexpr VertexAttribute makeAttribute(size_t offset, const char* name, GLuint location, GLboolean normalized = GL_FALSE, GLuint divisor = 0)
+{
+	static_assert(sizeof(T) == AttributeFormat<T>::count * componentSize(AttributeFormat<T>::type), "Field type is padded, it can't be read as a vertex attribute");
+	return VertexAttribute{ name, location, AttributeFormat<T>::type, AttributeFormat<T>::count, normalized, divisor, offset };
+}
+#define VERTEX_ATTRIBUTE(V, field, ...) makeAttribute<decltype(V::field)>(offsetof(V, field), __VA_ARGS__)
+
+// Specialized for each vertex struct with its attributes, once:
+//   template <> struct VertexLayout<V> { static constexpr VertexAttribute attributes[] = { ... }; };
+// plus `constexpr VertexAttribute VertexLayout<V>::attributes[];` in one .cpp. From that come the
+// VAO setup (setVertexLayout), the shader's input declarations (vertexInputs) and the
+// compile-time checks of checkVertexLayout.
+template <typename V> struct VertexLayout;
+
+template <typename V>
+constexpr size_t attributeCount()
+{
+	return sizeof(VertexLayout<V>::attributes) / sizeof(VertexAttribute);
+}
+
+constexpr size_t attributeBytes(const VertexAttribute* attributes, size_t count)
+{
+	return count == 0 ? 0 : attributes->count * componentSize(attributes->type) + attributeBytes(attributes + 1, count - 1);
+}
+
+constexpr bool attributesFit(const VertexAttribute* attributes, size_t count, size_t size)
+{
+	return count == 0 || (attributes->offset + attributes->count * componentSize(attributes->type) <= size && attributesFit(attributes + 1, count - 1, size));
+}
+
+// Every attribute lies inside V, and with tight set every byte of V belongs to one
+template <typename V>
+constexpr bool checkVertexLayout(bool tight)
+{
+	return attributesFit(VertexLayout<V>::attributes, attributeCount<V>(), sizeof(V))
+		&& (!tight || attributeBytes(VertexLayout<V>::attributes, attributeCount<V>()) == sizeof(V));
+}
+
+// Points one attribute of the bound VAO into the bound array buffer
+inline void setVertexAttribute(const VertexAttribute& attribute, GLsizei stride, size_t firstByte)
+{
+	bool integer = attribute.type != GL_FLOAT && attribute.type != GL_HALF_FLOAT && !attribute.normalized;
+	// Matrices take a location per column
+	GLint columns = attribute.count > 4 ? attribute.count / 4 : 1;
+	GLint count = attribute.count / columns;
+	for (GLint c = 0; c < columns; c++) {
+		GLuint location = attribute.location + c;
+		const GLvoid* offset = (const GLvoid*)(firstByte + attribute.offset + c * count * componentSize(attribute.type));
+		glEnableVertexAttribArray(location);
+		if (integer)
+			glVertexAttribIPointer(location, count, attribute.type, stride, offset);
+		else
+			glVertexAttribPointer(location, count, attribute.type, attribute.normalized, stride, offset);
+		glVertexAttribDivisor(location, attribute.divisor);
+	}
+}
+
+// Points the attributes of the bound VAO at an array of V in the bound array buffer starting at firstByte
+template <typename V>
+void setVertexLayout(size_t firstByte = 0)
+{
+	for (size_t i = 0; i < attributeCount<V>(); i++)
+		setVertexAttribute(VertexLayout<V>::attributes[i], sizeof(V), firstByte);
+}
+
+// GLSL declaration of one attribute, "layout (location = 0) in vec3 position;"
+inline string attributeDeclaration(const VertexAttribute& attribute)
+{
+	bool integer = attribute.type != GL_FLOAT && attribute.type != GL_HALF_FLOAT && !attribute.normalized;
+	bool isSigned = attribute.type == GL_BYTE || attribute.type == GL_SHORT || attribute.type == GL_INT;
+	string type;
+	if (attribute.count == 16)
+		type = "mat4";
+	else if (attribute.count == 1)
+		type = !integer ? "float" : isSigned ? "int" : "uint";
+	else
+		type = string(!integer ? "vec" : isSigned ? "ivec" : "uvec") + to_string(attribute.count);
+	return "layout (location = " + to_string(attribute.location) + ") in " + type + " " + attribute.name + ";\n";
+}
+
+// The vertex shader inputs for V, to put after the #version line
+template <typename V>
+string vertexInputs()
+{
+	string declarations;
+	for (size_t i = 0; i < attributeCount<V>(); i++)
+		declarations += attributeDeclaration(VertexLayout<V>::attributes[i]);
+	return declarations;
+}
\ No newline at end of file
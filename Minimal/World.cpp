@@ -0,0 +1,193 @@
+#include "World.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Emitters away from home are slower and run dry, so the far field adds pressure without burying the player
+static const float FAR_EMITTER_INTERVAL = 8.0f;
+static const int FAR_PARTICLE_BUDGET = 3;
+
+void World::generate(const glm::vec3& home, int homeVariant, float homeInterval, int variantCount, int radius, Random& random)
+{
+	dims = glm::ivec2(2 * radius + 1, 2 * radius + 1);
+	origin = glm::vec3(home.x - (radius + 0.5f) * cellSize, 0.0f, home.z - (radius + 0.5f) * cellSize);
+	cells.assign(dims.x * dims.y, WorldCell());
+	activeCells.clear();
+
+	for (int z = 0; z < dims.y; z++) {
+		for (int x = 0; x < dims.x; x++) {
+			WorldCell& cell = cells[cellIndex(x, z)];
+			FactoryInstance factory;
+			Emitter emitter;
+			if (x == radius && z == radius) {
+				homeCell = cellIndex(x, z);
+				factory.position = home;
+				factory.variant = homeVariant;
+				emitter.interval = homeInterval;
+			}
+			else {
+				// Somewhere in the middle half of the cell, on the same ground as home
+				glm::vec3 corner = origin + glm::vec3(x * cellSize, 0.0f, z * cellSize);
+				factory.position = glm::vec3(corner.x + cellSize * (0.25f + 0.5f * fmod(random.next(), 100.0f) / 100.0f), home.y,
+					corner.z + cellSize * (0.25f + 0.5f * fmod(random.next(), 100.0f) / 100.0f));
+				factory.variant = random.next() % variantCount;
+				emitter.interval = FAR_EMITTER_INTERVAL;
+				cell.particleBudget = FAR_PARTICLE_BUDGET;
+			}
+			emitter.position = factory.position;
+			cell.factories.push_back(factory);
+			cell.emitters.push_back(emitter);
+		}
+	}
+}
+
+void World::stream(const glm::vec3& head, FactoryLibrary& factories, Scheduler& scheduler)
+{
+	// Nearest cells first, so their models get to the front of the load and upload queues
+	vector<pair<float, int>> nearby;
+	for (int c = 0; c < (int)cells.size(); c++) {
+		float d = distance(c, head);
+		if (d < prefetchRadius)
+			nearby.push_back(make_pair(d, c));
+
+		WorldCell& cell = cells[c];
+		bool active = cell.active ? d < loadRadius + hysteresis : d < loadRadius;
+		if (active && !cell.active) {
+			// Emitters start their interval on arrival rather than firing a backlog
+			for (int e = 0; e < (int)cell.emitters.size(); e++) {
+				cell.emitters[e].last = scheduler.now();
+				startEmitter(c, e, scheduler, -1.0f);
+			}
+		}
+		if (!active && cell.active) {
+			for (Emitter& emitter : cell.emitters) {
+				scheduler.cancel(emitter.timer);
+				emitter.timer = 0;
+			}
+		}
+		if (!active) {
+			// Nothing drawn, so the models can age out of the pool
+			for (FactoryInstance& factory : cell.factories)
+				factory.shown = -1;
+		}
+		cell.active = active;
+	}
+	sort(nearby.begin(), nearby.end());
+	for (const pair<float, int>& n : nearby) {
+		for (const FactoryInstance& factory : cells[n.second].factories)
+			factories.request(factory.variant);
+	}
+
+	activeCells.clear();
+	for (int c = 0; c < (int)cells.size(); c++) {
+		if (!cells[c].active)
+			continue;
+		activeCells.push_back(c);
+		for (FactoryInstance& factory : cells[c].factories) {
+			if (factories.resident(factory.variant))
+				factory.shown = factory.variant;
+			// The old variant may have been evicted since the instance was last drawn
+			else if (factory.shown >= 0 && !factories.resident(factory.shown))
+				factory.shown = -1;
+			if (factory.shown >= 0)
+				factories.touch(factory.shown);
+		}
+	}
+}
+
+void World::startEmitter(int cell, int index, Scheduler& scheduler, float firstDelay)
+{
+	Scheduler* timers = &scheduler;
+	cells[cell].emitters[index].timer = scheduler.every(cells[cell].emitters[index].interval, [this, cell, index, timers] {
+		cells[cell].emitters[index].last = timers->now();
+		fired.push_back(make_pair(cell, index));
+	}, firstDelay);
+}
+
+void World::emit(vector<glm::vec3>& spawns, vector<glm::vec3>& farSpawns)
+{
+	spawns.clear();
+	farSpawns.clear();
+	for (const pair<int, int>& f : fired) {
+		WorldCell& cell = cells[f.first];
+		if (cell.particleBudget >= 0 && cell.spawned >= cell.particleBudget)
+			continue;
+		(f.first == homeCell ? spawns : farSpawns).push_back(cell.emitters[f.second].position);
+		cell.spawned++;
+	}
+	fired.clear();
+}
+
+void World::restartEmitters(Scheduler& scheduler)
+{
+	fired.clear();
+	for (int c : activeCells) {
+		for (int e = 0; e < (int)cells[c].emitters.size(); e++) {
+			Emitter& emitter = cells[c].emitters[e];
+			scheduler.cancel(emitter.timer);
+			float waited = float(scheduler.now() - emitter.last) / CLOCKS_PER_SEC;
+			startEmitter(c, e, scheduler, std::max(emitter.interval - waited, 0.0f));
+		}
+	}
+}
+
+void World::resetBudgets()
+{
+	for (WorldCell& cell : cells)
+		cell.spawned = 0;
+}
+
+void World::save(Snapshot& snapshot, std::clock_t now) const
+{
+	snapshot.put((uint32_t)cells.size());
+	for (const WorldCell& cell : cells) {
+		snapshot.put((int32_t)cell.spawned);
+		for (const FactoryInstance& factory : cell.factories)
+			snapshot.put((int32_t)factory.variant);
+		// Timers as time already waited, since clock values don't survive a restart
+		for (const Emitter& emitter : cell.emitters)
+			snapshot.put((int64_t)(now - emitter.last));
+	}
+}
+
+bool World::load(Snapshot& snapshot, std::clock_t now)
+{
+	uint32_t count;
+	if (!snapshot.get(count) || count != cells.size())
+		return false;
+	for (WorldCell& cell : cells) {
+		int32_t spawned;
+		if (!snapshot.get(spawned))
+			return false;
+		cell.spawned = spawned;
+		for (FactoryInstance& factory : cell.factories) {
+			int32_t variant;
+			if (!snapshot.get(variant))
+				return false;
+			factory.variant = variant;
+		}
+		for (Emitter& emitter : cell.emitters) {
+			int64_t waited;
+			if (!snapshot.get(waited))
+				return false;
+			emitter.last = now - (std::clock_t)waited;
+		}
+	}
+	return true;
+}
+
+int World::cellAt(const glm::vec3& p) const
+{
+	int x = std::min(std::max((int)floorf((p.x - origin.x) / cellSize), 0), dims.x - 1);
+	int z = std::min(std::max((int)floorf((p.z - origin.z) / cellSize), 0), dims.y - 1);
+	return cellIndex(x, z);
+}
+
+float World::distance(int cell, const glm::vec3& p) const
+{
+	glm::vec2 lo = glm::vec2(origin.x + (cell % dims.x) * cellSize, origin.z + (cell / dims.x) * cellSize);
+	glm::vec2 hi = lo + glm::vec2(cellSize);
+	float dx = std::max(std::max(lo.x - p.x, p.x - hi.x), 0.0f);
+	float dz = std::max(std::max(lo.y - p.z, p.z - hi.y), 0.0f);
+	return sqrtf(dx * dx + dz * dz);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+// Std. Includes
+#include <ctime>
+#include <vector>
+using namespace std;
+// GL Includes
+#include <glm/glm.hpp>
+
+#include "FactoryLibrary.h"
+#include "Random.h"
+#include "Scheduler.h"
+#include "Snapshot.h"
+
+// A factory placed in the world
+struct FactoryInstance {
+	glm::vec3 position;
+	// Variant wanted, and the one drawn until that one is resident (-1 for none yet)
+	int variant;
+	int shown = -1;
+};
+
+// A chimney that puffs out a CO2 molecule every interval seconds
+struct Emitter {
+	glm::vec3 position;
+	float interval;
+	// When it last fired, and its timer while the cell is active
+	std::clock_t last = 0;
+	TimerId timer = 0;
+};
+
+struct WorldCell {
+	vector<FactoryInstance> factories;
+	vector<Emitter> emitters;
+	// Most molecules the cell's emitters add per round, -1 for no limit
+	int particleBudget = -1;
+	int spawned = 0;
+	bool active = false;
+};
+
+// The play area split into a grid of square cells on the ground plane. Only cells near
+// the head are active: their factories are drawn, collided with and picked, and their
+// emitters run on scheduler timers. Factory models are streamed through a FactoryLibrary ahead of need,
+// so a cell coming into range draws as soon as its models are resident.
+class World {
+public:
+	/*  World Data  */
+	// Corner of cell (0, 0) and cell counts along x and z
+	glm::vec3 origin;
+	float cellSize = 20.0f;
+	glm::ivec2 dims;
+	vector<WorldCell> cells;
+	// The cell generate put home in
+	int homeCell = -1;
+	// Indices of the active cells
+	vector<int> activeCells;
+	// Cells closer than loadRadius to the head become active and stay so until farther
+	// than loadRadius + hysteresis. Cells within prefetchRadius have their models streamed in.
+	float loadRadius = 30.0f;
+	float hysteresis = 5.0f;
+	float prefetchRadius = 50.0f;
+	// Vertical extent of the play area
+	float floor = -10.0f, ceiling = 10.0f;
+
+	/*  Functions  */
+	// Lays out a square of cells radius cells out from the one centered on home. home
+	// gets the given factory and emitter, every other cell a random factory and a slower,
+	// budgeted emitter.
+	void generate(const glm::vec3& home, int homeVariant, float homeInterval, int variantCount, int radius, Random& random);
+	// Activates and deactivates cells around head, starting and stopping their emitters,
+	// requests models ahead of need and switches instances to their wanted variants once resident
+	void stream(const glm::vec3& head, FactoryLibrary& factories, Scheduler& scheduler);
+	// Positions of the molecules emitters fired since the last call, within cell budgets: the
+	// home cell's, which are the round's, into spawns and the other cells' into farSpawns
+	void emit(vector<glm::vec3>& spawns, vector<glm::vec3>& farSpawns);
+	// Starts a new round: empties every cell's budget count
+	void resetBudgets();
+
+	// The changing part of the world (chosen variants, budgets, emitter timers) for a
+	// snapshot. The layout itself comes from generate and must match on load.
+	void save(Snapshot& snapshot, std::clock_t now) const;
+	bool load(Snapshot& snapshot, std::clock_t now);
+	// Puts the timers of active emitters back in step with their last firing, after a load
+	void restartEmitters(Scheduler& scheduler);
+
+	int cellIndex(int x, int z) const { return z * dims.x + x; }
+	// Cell containing p, clamped to the grid
+	int cellAt(const glm::vec3& p) const;
+	glm::vec3 boundsMin() const { return glm::vec3(origin.x, floor, origin.z); }
+	glm::vec3 boundsMax() const { return glm::vec3(origin.x + dims.x * cellSize, ceiling, origin.z + dims.y * cellSize); }
+	// Distance on the ground plane from p to the nearest point of a cell
+	float distance(int cell, const glm::vec3& p) const;
+
+private:
+	// Emitters (cell, index) whose timers fired, waiting for emit
+	vector<pair<int, int>> fired;
+
+	void startEmitter(int cell, int index, Scheduler& scheduler, float firstDelay);
+};
\ No newline at end of file
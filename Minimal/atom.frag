@@ -0,0 +1,42 @@
+#version 330 core
+#extension GL_ARB_conservative_depth : enable
+// Where this pixel's ray meets the atom's sphere, lit like shader.frag lights the meshes
+#include "lighting.glsl"
+
+in vec3 ray;
+flat in vec3 sphereCenter;
+flat in float sphereRadius;
+flat in vec3 atomColor;
+
+out vec4 color;
+
+uniform mat4 projection;
+// Back to world space, where the light is
+uniform mat4 inverseView;
+
+// The square lies on the plane through the sphere's nearest point, so the traced hit is never
+// nearer than it and the depth test can still run before shading. Drivers without the
+// extension get a plain write, which tests late.
+#ifdef GL_ARB_conservative_depth
+layout(depth_greater) out float gl_FragDepth;
+#endif
+
+void main()
+{
+	// The nearer root of |t * d - center| = radius, with the eye at the origin
+	vec3 d = normalize(ray);
+	float b = dot(d, sphereCenter);
+	float c = dot(sphereCenter, sphereCenter) - sphereRadius * sphereRadius;
+	float discriminant = b * b - c;
+	if (discriminant < 0.0) discard;
+	vec3 hit = d * (b - sqrt(discriminant));
+	vec3 normal = (hit - sphereCenter) / sphereRadius;
+
+	// The sphere's depth, not the square's, so atoms cut into each other and the scene
+	vec4 clip = projection * vec4(hit, 1.0);
+	gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far);
+
+	vec3 world = (inverseView * vec4(hit, 1.0)).xyz;
+	vec3 light = phong(world, mat3(inverseView) * normal, normalize(inverseView[3].xyz - world));
+	color = vec4(light * atomColor, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 330 core
+// One atom, drawn as a square facing the eye just in front of its sphere and just big enough
+// to cover it; atom.frag traces the sphere itself. The inputs (center, radius, color) are per
+// instance, declared by LoadShaders from VertexLayout<AtomInstance>. The square's corners
+// come from gl_VertexID, as a strip of four.
+
+uniform mat4 projection;
+uniform mat4 view;
+
+// Through this pixel from the eye, in view space
+out vec3 ray;
+flat out vec3 sphereCenter;
+flat out float sphereRadius;
+flat out vec3 atomColor;
+
+void main(){
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec3 c = (view * vec4(center, 1.0)).xyz;
+	float distance = length(c);
+	sphereCenter = c;
+	sphereRadius = radius;
+	atomColor = color.rgb;
+	ray = vec3(0.0);
+	// From inside the sphere none of it shows; outside the clip volume the square is dropped
+	if (distance <= radius * 1.001) {
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		return;
+	}
+
+	vec3 axis = c / distance;
+	vec3 side = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+	vec3 up = cross(side, axis);
+	// The cone from the eye that touches the sphere, cut across where the sphere starts
+	float extent = radius * (distance - radius) / sqrt(distance * distance - radius * radius);
+	ray = c - axis * radius + (corner.x * side + corner.y * up) * extent;
+	gl_Position = projection * vec4(ray, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec3 mycolor;
+in vec3 lightdir;
+
+out vec4 color;
+
+void main()
+{
+	// The sprite's square cut to a disc, with the normal of a sphere facing the eye
+	vec2 p = gl_PointCoord * 2.0 - 1.0;
+	float r2 = dot(p, p);
+	if (r2 > 1.0) discard;
+	vec3 normal = vec3(p.x, -p.y, sqrt(1.0 - r2));
+
+	float ambientStrength = 0.3f;
+	float diffuse = max(dot(normal, lightdir), 0.0);
+	color = vec4(mycolor * (ambientStrength + 0.7 * diffuse), 1.0);
+}
\ No newline at end of file
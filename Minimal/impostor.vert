@@ -0,0 +1,22 @@
+#version 330 core
+// A molecule the particle governor demoted, drawn as one point sprite that impostor.frag
+// shades like a sphere. The inputs (position, radius, color) are declared by LoadShaders
+// from VertexLayout<ImpostorVertex>.
+#include "lighting.glsl"
+
+uniform mat4 projection;
+uniform mat4 view;
+// Height in pixels of the eye being drawn, to size the sprite
+uniform float viewportHeight;
+
+out vec3 mycolor;
+out vec3 lightdir;
+
+void main(){
+	gl_Position = projection * view * vec4(position, 1.0);
+	// The sphere's projected diameter: projection[1][1] maps height to clip space at w = 1
+	gl_PointSize = max(viewportHeight * projection[1][1] * radius / gl_Position.w, 1.0);
+	mycolor = color.rgb;
+	// The scene light, in view space since that is where the sprite's normal is
+	lightdir = normalize(mat3(view) * LIGHT_POSITION);
+}
\ No newline at end of file
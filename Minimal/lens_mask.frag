@@ -0,0 +1,9 @@
+#version 330 core
+// Only depth is written; color writes are off while the mask draws
+
+out vec4 color;
+
+void main()
+{
+	color = vec4(0.0);
+}
\ No newline at end of file
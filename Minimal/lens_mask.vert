@@ -0,0 +1,8 @@
+#version 330 core
+// The lens mask's ring, already in normalized device coordinates, pushed to the near plane so
+// everything drawn after it fails the depth test. The position input is declared by LoadShaders
+// from VertexLayout<MaskVertex>.
+
+void main(){
+	gl_Position = vec4(position, -1.0, 1.0);
+}
\ No newline at end of file
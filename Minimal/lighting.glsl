@@ -0,0 +1,15 @@
+// The scene's one light, for any shader that lights something. Included, so no #version.
+const vec3 LIGHT_POSITION = vec3(0.0, 5.0, 5.0);
+const vec3 LIGHT_COLOR = vec3(0.7, 0.7, 0.7);
+const float AMBIENT_STRENGTH = 0.3;
+const float SPECULAR_STRENGTH = 0.5;
+const float SHININESS = 32.0;
+
+// Ambient, diffuse and specular light at position, facing normal, seen along viewdir (toward the eye)
+vec3 phong(vec3 position, vec3 normal, vec3 viewdir) {
+	vec3 lightdir = normalize(LIGHT_POSITION - position);
+	float diffuse = max(dot(normal, lightdir), 0.0);
+	vec3 reflectdir = reflect(-lightdir, normal);
+	float specular = SPECULAR_STRENGTH * pow(max(dot(viewdir, reflectdir), 0.0), SHININESS);
+	return (AMBIENT_STRENGTH + diffuse + specular) * LIGHT_COLOR;
+}
\ No newline at end of file
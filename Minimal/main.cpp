@@ -23,11 +23,36 @@ limitations under the License.
 #include <exception>
 #include <algorithm>
 #include <ctime>
+#include <deque>
+#include <thread>
+#include <future>
+#include <chrono>
 
 #include <Windows.h>
 #include "Shader.h"
 #include "Model.h"
 #include"Line.h"
+#include "ParticleSystem.h"
+#include "ParticleEmitter.h"
+#include "DistanceField.h"
+#include "SceneBVH.h"
+#include "World.h"
+#include "Random.h"
+#include "Snapshot.h"
+#include "Scheduler.h"
+#include "BatchSim.h"
+#include "Audio.h"
+#include "InputSampler.h"
+#include "FrameSubmitter.h"
+#include "LensMask.h"
+#include "MeshStats.h"
+#include "ParticleGovernor.h"
+#include "ParticleImpostors.h"
+#include "AtomSpheres.h"
+#include "SmokePlume.h"
+#include "StartupTimeline.h"
+#include "AssetBench.h"
+#include "Replication.h"
 
 #define __STDC_FORMAT_MACROS 1
 #define LEFT 0
@@ -181,6 +206,7 @@ protected:
 
 public:
 	GlfwApp() {
+		StartupTimeline::Phase phase(startupTimeline(), "glfwInit");
 		// Initialize the GLFW system for creating and positioning windows
 		if (!glfwInit()) {
 			FAIL("Failed to initialize GLFW");
@@ -196,6 +222,7 @@ public:
 	}
 
 	virtual int run() {
+		StartupTimeline::Phase phase(startupTimeline(), "window and GLEW");
 		preCreate();
 
 		window = createRenderingTarget(windowSize, windowPosition);
@@ -206,6 +233,7 @@ public:
 		}
 
 		postCreate();
+		phase.end();
 
 		initGl();
 
@@ -412,6 +440,7 @@ protected:
 
 public:
 	RiftManagerApp() {
+		StartupTimeline::Phase phase(startupTimeline(), "ovr_Create");
 		if (!OVR_SUCCESS(ovr_Create(&_session, &_luid))) {
 			FAIL("Unable to create HMD session");
 		}
@@ -430,7 +459,8 @@ public:
 
 private:
 	GLuint _fbo{ 0 };
-	GLuint _depthBuffer{ 0 };
+	// A texture rather than a renderbuffer, so effects drawn after the scene can read it
+	GLuint _depthTexture{ 0 };
 	ovrTextureSwapChain _eyeTexture;
 
 	GLuint _mirrorFbo{ 0 };
@@ -442,14 +472,29 @@ private:
 
 	ovrLayerEyeFov _sceneLayer;
 	ovrViewScaleDesc _viewScaleDesc;
+	// Keeps the depth test from shading what the lenses don't show, toggled with F5
+	LensMask _lensMask;
 
 	uvec2 _renderTargetSize;
 	uvec2 _mirrorSize;
 
+	// Commit and ovr_SubmitFrame on a thread of their own, toggled with F6. The hidden window's
+	// context shares the eye textures with the main one.
+	GLFWwindow * _submitContext{ nullptr };
+	FrameSubmitter _submitter;
+	bool _asyncSubmit{ false };
+	// Frame time and the part of it the GL thread spent waiting on submission, reported every few
+	// seconds while toggled on with F4
+	bool _reportStats{ false };
+	std::chrono::steady_clock::time_point _statStart;
+	double _blockedSeconds{ 0 };
+	unsigned int _statFrames{ 0 };
+
 public:
 
 	RiftApp() {
 		using namespace ovr;
+		StartupTimeline::Phase phase(startupTimeline(), "eye render descriptions");
 		_viewScaleDesc.HmdSpaceToWorldScaleInMeters = 1.0f;
 
 		memset(&_sceneLayer, 0, sizeof(ovrLayerEyeFov));
@@ -483,6 +528,7 @@ protected:
 
 	void initGl() override {
 		GlfwApp::initGl();
+		StartupTimeline::Phase phase(startupTimeline(), "swap chain and mirror");
 
 		// Disable the v-sync for buffer swap
 		glfwSwapInterval(0);
@@ -520,12 +566,16 @@ protected:
 
 		// Set up the framebuffer object
 		glGenFramebuffers(1, &_fbo);
-		glGenRenderbuffers(1, &_depthBuffer);
+		glGenTextures(1, &_depthTexture);
+		glBindTexture(GL_TEXTURE_2D, _depthTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, _renderTargetSize.x, _renderTargetSize.y, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _fbo);
-		glBindRenderbuffer(GL_RENDERBUFFER, _depthBuffer);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, _renderTargetSize.x, _renderTargetSize.y);
-		glBindRenderbuffer(GL_RENDERBUFFER, 0);
-		glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depthBuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depthTexture, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
 		ovrMirrorTextureDesc mirrorDesc;
@@ -537,6 +587,78 @@ protected:
 			FAIL("Could not create mirror texture");
 		}
 		glGenFramebuffers(1, &_mirrorFbo);
+
+		_lensMask.init(_sceneLayer.Fov);
+		ovr::for_each_eye([&](ovrEyeType eye) {
+			const auto& vp = _sceneLayer.Viewport[eye];
+			std::cout << "Lens mask hides " << _lensMask.hiddenFraction(eye, uvec2(vp.Size.w, vp.Size.h)) * 100.0
+				<< "% of eye " << eye << "'s " << vp.Size.w << "x" << vp.Size.h << " pixels" << std::endl;
+		});
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		_submitContext = glfwCreateWindow(1, 1, "Submit", nullptr, window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		_statStart = std::chrono::steady_clock::now();
+	}
+
+	void shutdownGl() override {
+		_submitter.stop();
+		_lensMask.release();
+		if (_submitContext) {
+			glfwDestroyWindow(_submitContext);
+			_submitContext = nullptr;
+		}
+		GlfwApp::shutdownGl();
+	}
+
+	void setAsyncSubmit(bool async) {
+		if (async == _asyncSubmit || (async && !_submitContext)) return;
+		if (async) {
+			_submitter.start(_session, _eyeTexture, _submitContext);
+		}
+		else {
+			_submitter.stop();
+		}
+		_asyncSubmit = async;
+		std::cout << "Frames are submitted " << (async ? "from the submit thread" : "from the GL thread") << std::endl;
+		_statStart = std::chrono::steady_clock::now();
+		_blockedSeconds = 0;
+		_statFrames = 0;
+		_submitter.takeSubmitSeconds();
+	}
+
+	// Average frame time, how much of it the GL thread was held up by submission and, when
+	// submitting from the thread, how long the compositor held that up instead
+	void reportSubmit(double blocked) {
+		_blockedSeconds += blocked;
+		if (++_statFrames < 450) return;
+		if (!_reportStats) {
+			_statStart = std::chrono::steady_clock::now();
+			_blockedSeconds = 0;
+			_statFrames = 0;
+			_submitter.takeSubmitSeconds();
+			return;
+		}
+		auto now = std::chrono::steady_clock::now();
+		double frameMs = std::chrono::duration<double, std::milli>(now - _statStart).count() / _statFrames;
+		std::cout << (_asyncSubmit ? "Async" : "Sync") << " submit: " << frameMs << " ms per frame, GL thread blocked "
+			<< _blockedSeconds * 1000.0 / _statFrames << " ms";
+		if (_asyncSubmit) {
+			std::cout << ", submit thread in ovr_SubmitFrame " << _submitter.takeSubmitSeconds() * 1000.0 / _statFrames << " ms";
+		}
+		std::cout << std::endl;
+		if (_lensMask.enabled) {
+			// What the GPU counted: the mask's own pixels, which nothing drawn after it shades
+			double hidden = 0.0, total = 0.0;
+			for (int eye = 0; eye < 2; eye++) {
+				hidden += (double)_lensMask.hiddenSamples(eye);
+				total += (double)_sceneLayer.Viewport[eye].Size.w * _sceneLayer.Viewport[eye].Size.h;
+			}
+			std::cout << "Lens mask: " << hidden * 100.0 / total << "% of eye pixels not shaded" << std::endl;
+		}
+		_statStart = now;
+		_blockedSeconds = 0;
+		_statFrames = 0;
 	}
 
 	void onKey(int key, int scancode, int action, int mods) override {
@@ -544,12 +666,28 @@ protected:
 		case GLFW_KEY_R:
 			ovr_RecenterTrackingOrigin(_session);
 			return;
+		case GLFW_KEY_F6:
+			setAsyncSubmit(!_asyncSubmit);
+			return;
+		case GLFW_KEY_F4:
+			_reportStats = !_reportStats;
+			std::cout << "Frame statistics " << (_reportStats ? "on" : "off") << std::endl;
+			return;
+		case GLFW_KEY_F5:
+			_lensMask.enabled = !_lensMask.enabled;
+			std::cout << "Lens mask " << (_lensMask.enabled ? "on" : "off") << std::endl;
+			return;
 		}
 
 		GlfwApp::onKey(key, scancode, action, mods);
 	}
 
 	void draw() final override {
+		double blocked = 0.0;
+		// The chain only moves on to a free texture once the last frame is committed
+		if (_asyncSubmit) {
+			blocked += _submitter.waitForChain();
+		}
 		ovrPosef eyePoses[2];
 		ovr_GetEyePoses(_session, frame, true, _viewScaleDesc.HmdToEyeOffset, eyePoses, &_sceneLayer.SensorSampleTime);
 
@@ -567,14 +705,30 @@ protected:
 		ovr::for_each_eye([&](ovrEyeType eye) {
 			const auto& vp = _sceneLayer.Viewport[eye];
 			glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
+			_lensMask.draw(eye);
 			_sceneLayer.RenderPose[eye] = eyePoses[eye];
 			renderScene(_eyeProjections[eye], ovr::toGlm(eyePoses[eye]), eyepos);
 		});
+		// Effects sample the depth, so it comes off the framebuffer while they draw
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+		ovr::for_each_eye([&](ovrEyeType eye) {
+			const auto& vp = _sceneLayer.Viewport[eye];
+			glViewport(vp.Pos.x, vp.Pos.y, vp.Size.w, vp.Size.h);
+			renderEffects(eye, _eyeProjections[eye], ovr::toGlm(eyePoses[eye]), _depthTexture);
+		});
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, _depthTexture, 0);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		ovr_CommitTextureSwapChain(_session, _eyeTexture);
-		ovrLayerHeader* headerList = &_sceneLayer.Header;
-		ovr_SubmitFrame(_session, frame, &_viewScaleDesc, &headerList, 1);
+		if (_asyncSubmit) {
+			blocked += _submitter.submit(frame, _sceneLayer, _viewScaleDesc);
+		}
+		else {
+			auto submitStart = std::chrono::steady_clock::now();
+			ovr_CommitTextureSwapChain(_session, _eyeTexture);
+			ovrLayerHeader* headerList = &_sceneLayer.Header;
+			ovr_SubmitFrame(_session, frame, &_viewScaleDesc, &headerList, 1);
+			blocked += std::chrono::duration<double>(std::chrono::steady_clock::now() - submitStart).count();
+		}
 
 		GLuint mirrorTextureId;
 		ovr_GetMirrorTextureBufferGL(_session, _mirrorTexture, &mirrorTextureId);
@@ -582,9 +736,12 @@ protected:
 		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirrorTextureId, 0);
 		glBlitFramebuffer(0, 0, _mirrorSize.x, _mirrorSize.y, 0, _mirrorSize.y, _mirrorSize.x, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		reportSubmit(blocked);
 	}
 
 	virtual void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose, glm::vec3 eyepos) = 0;
+	// Drawn over each eye once both have their scene, with the scene's depth in depthTexture
+	virtual void renderEffects(int eye, const glm::mat4 & projection, const glm::mat4 & headPose, GLuint depthTexture) {}
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -639,6 +796,127 @@ struct Particle {
 	glm::vec3 rotation;
 };
 
+// The game's sounds, read from the assets when there and synthesized otherwise
+struct GameSounds {
+	int convert = -1;
+	int spawn = -1;
+	int win = -1;
+	int lose = -1;
+
+	void load(AudioMixer& audio) {
+		convert = load(audio, "convert", AudioClip::tone(880.0f, 1320.0f, 0.15f, AudioMixer::SAMPLE_RATE));
+		spawn = load(audio, "spawn", AudioClip::tone(220.0f, 180.0f, 0.2f, AudioMixer::SAMPLE_RATE));
+		win = load(audio, "win", AudioClip::tone(440.0f, 880.0f, 0.8f, AudioMixer::SAMPLE_RATE));
+		lose = load(audio, "lose", AudioClip::tone(440.0f, 110.0f, 1.0f, AudioMixer::SAMPLE_RATE));
+	}
+
+	static int load(AudioMixer& audio, const string& name, AudioClip fallback) {
+		int clip = audio.loadClip("../Project1-assets/audio/" + name + ".wav");
+		return clip >= 0 ? clip : audio.addClip(fallback);
+	}
+};
+
+// Where the models are, and how the factories are placed around their instance positions
+const std::string ASSETS{ "../Project1-assets" };
+const int FACTORY_COUNT{ 4 };
+// The factory at the chimney, where the game starts
+const int HOME_FACTORY{ 3 };
+const glm::mat4 FACTORY_TRANSFORM{ glm::scale(glm::mat4(1.0f), glm::vec3(0.2f, 0.2f, 0.2f)) };
+// Features of shader.vert and shader.frag, as bits of a ShaderPermutations mask. Each draw
+// asks for as many as it allows, and gets the cheapest program there is for it.
+enum SceneShaderFeature : unsigned {
+	// The material's color with no light, for flat debug draws; nothing in the game asks for it,
+	// so it is only compiled if something does
+	SHADER_UNLIT = 1 << 0,
+	// The model matrix scales evenly, so normals need no inverse of it
+	SHADER_UNIFORM_SCALE = 1 << 1
+};
+const std::vector<std::string> SCENE_SHADER_FEATURES{ "UNLIT", "UNIFORM_SCALE" };
+const std::string CO2_MODEL{ ASSETS + "/co2/co2.obj" };
+const std::string O2_MODEL{ ASSETS + "/o2/o2.obj" };
+const std::string GREEN_LASER_MODEL{ ASSETS + "/cylinder/cylinder_green.obj" };
+const std::string RED_LASER_MODEL{ ASSETS + "/cylinder/cylinder_red.obj" };
+// Time to first frame of past runs
+const std::string STARTUP_HISTORY{ "startup-times.txt" };
+// Cooked with --cook-assets and read only when started with --use-archive, so edits to the
+// loose files show up without cooking again
+const std::string ASSET_ARCHIVE{ "assets.pak" };
+// Shared memory a spectator started with --spectate joins
+const std::string SPECTATOR_LINK{ "Co2SpectatorLink" };
+
+std::string factoryPath(int variant) {
+	std::string name = "factory" + to_string(variant + 1);
+	return ASSETS + "/" + name + "/" + name + ".obj";
+}
+
+// What startup loads, in the order it takes them: the archive is laid out and prefetched this way
+std::vector<std::string> startupAssetPaths() {
+	return { "lens_mask.vert", "lens_mask.frag",
+		"shader.vert", "shader.frag", "lighting.glsl", "atom.vert", "atom.frag", "impostor.vert", "impostor.frag", "smoke.vert", "smoke.frag", "smoke_composite.frag",
+		CO2_MODEL, O2_MODEL, GREEN_LASER_MODEL, RED_LASER_MODEL, factoryPath(HOME_FACTORY) };
+}
+
+// A home factory model with its collision field, parsed ahead of the library it goes to
+struct ParsedFactory {
+	std::unique_ptr<Model> model;
+	DistanceField field;
+};
+
+// Everything the scene reads from disk before its first frame: the shader sources, the
+// molecule and laser models, and the home factory with its distance field. start() puts each
+// on a worker thread first thing in WinMain, so they are read and parsed while LibOVR, the
+// window and the swap chain come up; the GL thread takes each when it gets to it and only
+// waits if it isn't done. Started serial, each runs where it is taken, as startup used to.
+struct StartupAssets {
+	std::future<ShaderSource> shader, atomShader, impostorShader, smokeShader, smokeCompositeShader;
+	std::future<std::unique_ptr<Model>> co2, o2, greenLaser, redLaser;
+	std::future<ParsedFactory> homeFactory;
+
+	void start(bool parallel) {
+		shader = job(parallel, "read shader", [] { return ReadShaderSource("shader.vert", "shader.frag"); });
+		atomShader = job(parallel, "read atom shader", [] { return ReadShaderSource("atom.vert", "atom.frag"); });
+		impostorShader = job(parallel, "read impostor shader", [] { return ReadShaderSource("impostor.vert", "impostor.frag"); });
+		smokeShader = job(parallel, "read smoke shader", [] { return ReadShaderSource("smoke.vert", "smoke.frag"); });
+		smokeCompositeShader = job(parallel, "read smoke composite shader", [] { return ReadShaderSource("smoke.vert", "smoke_composite.frag"); });
+		co2 = job(parallel, "parse co2", [] { return parseModel(CO2_MODEL); });
+		o2 = job(parallel, "parse o2", [] { return parseModel(O2_MODEL); });
+		greenLaser = job(parallel, "parse green laser", [] { return parseModel(GREEN_LASER_MODEL); });
+		redLaser = job(parallel, "parse red laser", [] { return parseModel(RED_LASER_MODEL); });
+		homeFactory = job(parallel, "parse home factory", [] {
+			ParsedFactory factory;
+			FactoryLibrary::parse(factoryPath(HOME_FACTORY), FACTORY_TRANSFORM, factory.model, factory.field);
+			return factory;
+		});
+	}
+
+	// The result of a job, timed as a wait on it
+	template <typename T>
+	static T take(std::future<T>& job, const std::string& name) {
+		StartupTimeline::Phase phase(startupTimeline(), "wait for " + name, name);
+		return job.get();
+	}
+
+	// A parsed model given its GL buffers. GL thread only.
+	static Model* upload(std::future<std::unique_ptr<Model>>& job, const std::string& name) {
+		std::unique_ptr<Model> model = take(job, name);
+		StartupTimeline::Phase phase(startupTimeline(), "upload " + name.substr(name.find(' ') + 1));
+		model->upload();
+		return model.release();
+	}
+
+	static std::unique_ptr<Model> parseModel(const std::string& path) {
+		return std::unique_ptr<Model>(new Model(path, false));
+	}
+
+	template <typename Work>
+	static auto job(bool parallel, const std::string& name, Work work) -> std::future<decltype(work())> {
+		return std::async(parallel ? std::launch::async : std::launch::deferred, [name, work] {
+			StartupTimeline::Phase phase(startupTimeline(), name);
+			return work();
+		});
+	}
+};
+
 // a class for encapsulating building and rendering an RGB cube
 struct ColorCubeScene {
 
@@ -649,7 +927,16 @@ struct ColorCubeScene {
 	GLuint instanceCount;
 	oglplus::Buffer instances;
 
-	Model* factory;
+	// Runs loads off the GL thread and every timer in the game; first in, last out
+	Scheduler scheduler;
+	// Factory models, streamed in as the cells that use them come near
+	FactoryLibrary* factories;
+	// Grid of factories and emitters around the player
+	World world;
+	vector<glm::vec3> spawns, farSpawns;
+	glm::vec3 headPosition;
+	glm::vec3 headRight = glm::vec3(1.0f, 0.0f, 0.0f);
+	glm::vec3 headForward = glm::vec3(0.0f, 0.0f, -1.0f);
 	Model* co2;
 	Model* o2;
 	Model* greenLaser;
@@ -657,16 +944,62 @@ struct ColorCubeScene {
 	int co2Count = 0;
 
 
-	GLuint shaderProg;
-	std::vector<Particle*> particles;
-	Particle factoryParticle;
+	ShaderPermutations* sceneShaders;
+	// The round: molecules that count toward winning and losing, in reach of the player
+	ParticleSystem particles;
+	// Puffed by the far cells' chimneys: pressure on the horizon, drawn as impostors and not counted
+	ParticleSystem farParticles;
+	// The home chimney, which the cells' emitters puff like too, and the smog that ends a round
+	ParticleEmitters emitters;
+	int chimneyEmitter, smogEmitter;
+	// Decides each frame which molecules are drawn as meshes and which as impostors
+	ParticleGovernor governor;
+	ParticleImpostors* impostors;
+	// The rest, each as the spheres of its atoms unless that is switched off
+	AtomSpheres* spheres;
+	// From the home chimney, over everything once both eyes are drawn
+	SmokePlume* smoke;
+	vector<unsigned char> particleDetail;
+	// Work timed this frame, for the governor
+	double simSeconds = 0.0, renderSeconds = 0.0, meshSeconds = 0.0;
+	std::chrono::steady_clock::time_point lastFrame;
+	// Collision radius of a molecule
+	float particleRadius = 0.3f;
+	// Every object the lasers can hit, refit each tick
+	SceneBVH scene;
+	vector<SceneHit> leftHits, rightHits;
+	// Fraction of each beam left after the factory blocks it
+	float beamLength[2] = { 1.0f, 1.0f };
 	Particle leftLaser;
 	Particle rightLaser;
 
-	std::clock_t timer;
-	std::clock_t vibTimer;
+	// Ends the current vibration pulse
+	TimerId vibrationStop = 0;
+	// Mixed on a thread of its own, the frame only queues what to play
+	AudioMixer audio;
+	GameSounds sounds;
 	bool win = false;
 	bool lose = false;
+	// Every random choice the game makes, so a snapshot can carry on the same sequence
+	Random random;
+
+	// Autosaved to disk to resume after a restart, and kept in memory to rewind
+	SnapshotWriter snapshotWriter;
+	Snapshot snapshot;
+	deque<Snapshot> history;
+	TimerId autosaveTimer = 0;
+	// Laser input being recorded for replay in the headless sim
+	vector<ReplayFrame> recording;
+	bool recordingInput = false;
+
+	// Sends the scene each tick to a spectator on the link, while one is hosted
+	ReplicationServer replication;
+	SharedMemoryLink spectatorLink;
+	bool hostingSpectator = false;
+	ReplicatedScene replicated;
+	vector<uint8_t> packet, ack;
+	size_t replicatedBytes = 0;
+	std::chrono::steady_clock::time_point replicationReport;
 
 	glm::mat4 chimney = glm::mat4(1.0f, 0, 0, 0, 0, 1.0f, 0, 0, 0, 0, 1.0f, 0, 0, -1, -15, 1.0f);
 
@@ -677,93 +1010,458 @@ struct ColorCubeScene {
 	bool fingerTriggerPressed[2] = { false, false };
 
 	ovrSession sesh; //Needed for haptic feedback
+	// Controllers polled many times a frame, so the lasers are checked everywhere they went
+	InputSampler input;
+	vector<InputSample> inputSamples;
+	double lastInputTime;
 
 	// VBOs for the cube's vertices and normals
 
 	const unsigned int GRID_SIZE{ 5 };
+	// Bytes of factory geometry uploaded per frame while models stream in, and kept resident
+	const size_t FACTORY_UPLOAD_BUDGET{ 1 << 20 };
+	const size_t FACTORY_GPU_BUDGET{ 64 << 20 };
+	const string SESSION_FILE{ "session.co2snap" };
+	const float AUTOSAVE_INTERVAL{ 5.0f };
+	const size_t HISTORY_LENGTH{ 12 };
+	const string REPLAY_FILE{ "session.co2replay" };
+	const int INPUT_RATE{ 1000 };
 
 public:
-	ColorCubeScene() : cube({ "Position", "Normal" }, oglplus::shapes::Cube()) {
-		shaderProg = LoadShaders("shader.vert", "shader.frag");
-		factory = new Model("../Project1-assets/factory4/factory4.obj");
-		//factory2 = new Model("../Project1-assets/factory2/factory2.obj");
-		co2 = new Model("../Project1-assets/co2/co2.obj");
-		o2 = new Model("../Project1-assets/o2/o2.obj");
-		greenLaser = new Model("../Project1-assets/cylinder/cylinder_green.obj");
-		redLaser = new Model("../Project1-assets/cylinder/cylinder_red.obj");
+	// assets were started on workers at launch; the constructor compiles and uploads them
+	ColorCubeScene(ovrSession session, StartupAssets& assets) : cube({ "Position", "Normal" }, oglplus::shapes::Cube()) {
+		ShaderSource source = StartupAssets::take(assets.shader, "read shader");
+		StartupTimeline::Phase compile(startupTimeline(), "compile shader");
+		sceneShaders = new ShaderPermutations(source, SCENE_SHADER_FEATURES, vertexInputs<Vertex>());
+		// The variants every frame draws with, so the first frame doesn't stop to compile them
+		sceneShaders->get(0);
+		sceneShaders->get(SHADER_UNIFORM_SCALE);
+		compile.end();
+		co2 = StartupAssets::upload(assets.co2, "parse co2");
+		o2 = StartupAssets::upload(assets.o2, "parse o2");
+		greenLaser = StartupAssets::upload(assets.greenLaser, "parse green laser");
+		redLaser = StartupAssets::upload(assets.redLaser, "parse red laser");
 
 
 		//rightLine = new Line();
-		factoryParticle.model = factory;
-		factoryParticle.transform = glm::scale(chimney, glm::vec3(0.2f, 0.2f, 0.2f));
+		vector<string> factoryPaths;
+		for (int i = 0; i < FACTORY_COUNT; i++)
+			factoryPaths.push_back(factoryPath(i));
+		factories = new FactoryLibrary(factoryPaths, FACTORY_TRANSFORM, FACTORY_GPU_BUDGET, scheduler);
+		// The factory at the chimney is where the game starts, the rest of the world streams in around it
+		world.generate(glm::vec3(chimney[3]), 3, 1.0f, factories->count(), 2, random);
+		ParsedFactory home = StartupAssets::take(assets.homeFactory, "parse home factory");
+		StartupTimeline::Phase streaming(startupTimeline(), "upload home factory, stream world");
+		factories->preload(HOME_FACTORY, std::move(home.model), std::move(home.field));
+		world.stream(headPosition, *factories, scheduler);
+		streaming.end();
+		// The round's molecules stay in the player's box, in reach of the beams; the far cells'
+		// have the whole world
+		farParticles.boxMin = world.boundsMin();
+		farParticles.boxMax = world.boundsMax();
 		leftLaser.model = greenLaser;
 		rightLaser.model = greenLaser;
-		for (int i = 0; i < 5; i++) {
-			Particle* p = new Particle();
-			p->model = co2;
-			p->transform = glm::scale(chimney, glm::vec3(0.3f));
-			p->velocity = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.0f), fmod(rand(), 100.0f) - 50)) / 100.0f;
-			p->rotation = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50));
-			particles.push_back(p);
+
+		spheres = new AtomSpheres(StartupAssets::take(assets.atomShader, "read atom shader"));
+		spheres->atoms[PARTICLE_CO2] = AtomSpheres::fitAtoms(*co2);
+		spheres->atoms[PARTICLE_O2] = AtomSpheres::fitAtoms(*o2);
+		cout << "Molecules as spheres: " << spheres->atoms[PARTICLE_CO2].size() << " atoms of CO2, " << spheres->atoms[PARTICLE_O2].size() << " of O2" << endl;
+		impostors = new ParticleImpostors(StartupAssets::take(assets.impostorShader, "read impostor shader"));
+		impostors->colors[PARTICLE_CO2] = averageDiffuse(*co2);
+		impostors->colors[PARTICLE_O2] = averageDiffuse(*o2);
+		impostors->radius = 0.5f * glm::length(co2->boundsMax() - co2->boundsMin()) * particles.scale;
+		smoke = new SmokePlume(StartupAssets::take(assets.smokeShader, "read smoke shader"),
+			StartupAssets::take(assets.smokeCompositeShader, "read smoke composite shader"));
+		smoke->base = glm::vec3(chimney[3]);
+		governor.setFrameSeconds(1.0 / ovr_GetHmdDesc(session).DisplayRefreshRate);
+		lastFrame = std::chrono::steady_clock::now();
+		EmitterDesc puff;
+		puff.center = glm::vec3(chimney[3]);
+		puff.burst = 5;
+		chimneyEmitter = emitters.add(puff);
+		EmitterDesc smog;
+		smog.shape = EMIT_BOX;
+		smog.center = glm::vec3(0.0f, 0.0f, -15.0f);
+		smog.extent = glm::vec3(10.0f);
+		smog.burst = 100;
+		smogEmitter = emitters.add(smog);
+		co2Count = (int)emitters.burst(chimneyEmitter, particles, random);
+
+		StartupTimeline::Phase sound(startupTimeline(), "audio");
+		sounds.load(audio);
+		if (!audio.start(createWaveOutDevice())) {
+			cout << "No audio output, playing without sound" << endl;
+		}
+		sound.end();
+
+		StartupTimeline::Phase controllers(startupTimeline(), "input thread");
+		sesh = session;
+		input.start(session, INPUT_RATE);
+		lastInputTime = ovr_GetTimeInSeconds();
+		controllers.end();
+
+		// Pick up where the last session left off
+		StartupTimeline::Phase resume(startupTimeline(), "resume session");
+		Snapshot saved;
+		if (saved.loadFile(SESSION_FILE) && loadSnapshot(saved)) {
+			cout << "Resumed session from " << SESSION_FILE << endl;
+		}
+		startAutosave();
+	}
+
+	~ColorCubeScene() {
+		delete smoke;
+		delete impostors;
+		delete spheres;
+		delete factories;
+		delete sceneShaders;
+	}
+
+	// The color a molecule's impostor is drawn in
+	static glm::vec3 averageDiffuse(const Model& model) {
+		glm::vec3 sum(0.0f);
+		for (const Mesh& mesh : model.getMeshes())
+			sum += mesh.mtl.diffuse;
+		return model.getMeshes().empty() ? sum : sum / (float)model.getMeshes().size();
+	}
+
+	// Switches the home factory to variant (0 based) as soon as it is resident on the GPU
+	void selectFactory(int variant) {
+		world.cells[world.cellAt(glm::vec3(chimney[3]))].factories[0].variant = variant;
+	}
+
+	// Call once per frame before drawing. Runs due timers and finished loads, then streams
+	// cells and factory models around the head, uploading a little of what is on its way.
+	void beginFrame() {
+		scheduler.update(std::clock());
+		FactoryInstance& home = world.cells[world.cellAt(glm::vec3(chimney[3]))].factories[0];
+		int shown = home.shown;
+		world.stream(headPosition, *factories, scheduler);
+		factories->pump(FACTORY_UPLOAD_BUDGET);
+		if (home.shown != shown)
+			factories->reportMemory(cout);
+
+		// Hand last frame's timings to the governor and let it pick this frame's detail
+		auto now = std::chrono::steady_clock::now();
+		double frameSeconds = std::chrono::duration<double>(now - lastFrame).count();
+		governor.frame(simSeconds, renderSeconds, meshSeconds, frameSeconds);
+		lastFrame = now;
+		smoke->update((float)frameSeconds);
+		simSeconds = renderSeconds = meshSeconds = 0.0;
+		bool limiting = governor.limiting();
+		governor.assign(particles, headPosition, headForward, particleDetail);
+		impostors->update(particles, particleDetail, farParticles);
+		spheres->update(particles, particleDetail);
+		if (governor.limiting() != limiting)
+			governor.report(cout);
+	}
+
+	// Whether particle i is drawn as a full mesh this frame. Ones spawned since the governor
+	// last looked are.
+	bool drawnAsMesh(size_t i) const {
+		return i >= particleDetail.size() || particleDetail[i] == DETAIL_MESH;
+	}
+
+	// Copies the complete game state into a snapshot
+	void saveSnapshot(Snapshot& out) const {
+		std::clock_t now = std::clock();
+		out.begin();
+		out.put(random.state);
+		out.put((int32_t)co2Count);
+		out.put((uint8_t)win);
+		out.put((uint8_t)lose);
+		out.put((uint8_t)(leftLaser.model == redLaser));
+		out.put((uint8_t)(rightLaser.model == redLaser));
+		out.put(beamLength);
+		particles.save(out);
+		farParticles.save(out);
+		world.save(out, now);
+	}
+
+	// Replaces the game state with a snapshot's. Nothing changes if it doesn't fit.
+	bool loadSnapshot(Snapshot& in) {
+		std::clock_t now = std::clock();
+		unsigned state;
+		int32_t count;
+		uint8_t won, lost, leftRed, rightRed;
+		float beams[2];
+		ParticleSystem restored = particles, restoredFar = farParticles;
+		World restoredWorld = world;
+		if (!in.open() || !in.get(state) || !in.get(count) || !in.get(won) || !in.get(lost)
+			|| !in.get(leftRed) || !in.get(rightRed) || !in.get(beams) || !restored.load(in) || !restoredFar.load(in) || !restoredWorld.load(in, now)) {
+			return false;
+		}
+
+		random.state = state;
+		co2Count = count;
+		win = won != 0;
+		lose = lost != 0;
+		leftLaser.model = leftRed ? redLaser : greenLaser;
+		rightLaser.model = rightRed ? redLaser : greenLaser;
+		beamLength[LEFT] = beams[0];
+		beamLength[RIGHT] = beams[1];
+		particles = restored;
+		farParticles = restoredFar;
+		world = restoredWorld;
+		world.restartEmitters(scheduler);
+		glClearColor(0.0f, win ? 0.2f : 0.0f, win ? 0.8f : 0.4f, 0.0f);
+		return true;
+	}
+
+	// Goes back to the last autosave still in memory, dropping it from the history
+	void rewind() {
+		if (history.empty()) return;
+		loadSnapshot(history.back());
+		history.pop_back();
+		startAutosave();
+	}
+
+	// Autosaves every AUTOSAVE_INTERVAL from now: copies the state, the file is written in the background
+	void startAutosave() {
+		scheduler.cancel(autosaveTimer);
+		autosaveTimer = scheduler.every(AUTOSAVE_INTERVAL, [this] {
+			saveSnapshot(snapshot);
+			history.push_back(snapshot);
+			if (history.size() > HISTORY_LENGTH) history.pop_front();
+			snapshotWriter.submit(snapshot, SESSION_FILE);
+		});
+	}
+
+	// Buzzes both controllers for a tenth of a second, restarting any pulse under way
+	void pulseVibration() {
+		ovr_SetControllerVibration(sesh, ovrControllerType_LTouch, 0.0f, 1.0f);
+		ovr_SetControllerVibration(sesh, ovrControllerType_RTouch, 0.0f, 1.0f);
+		scheduler.cancel(vibrationStop);
+		vibrationStop = scheduler.after(0.1f, [this] { stopVibration(); });
+	}
+
+	void stopVibration() {
+		ovr_SetControllerVibration(sesh, ovrControllerType_LTouch, 0.0f, 0.0f);
+		ovr_SetControllerVibration(sesh, ovrControllerType_RTouch, 0.0f, 0.0f);
+	}
+
+	// Starts recording the lasers, or stops and writes the recording out
+	void toggleRecording() {
+		recordingInput = !recordingInput;
+		if (recordingInput) {
+			recording.clear();
+		}
+		else if (ReplayController::save(REPLAY_FILE, recording)) {
+			cout << "Recorded " << recording.size() << " frames to " << REPLAY_FILE << endl;
 		}
-		co2Count = 5;
-		timer = std::clock();
+	}
+
+	// Opens the spectator link, or closes it
+	void toggleSpectator() {
+		hostingSpectator = !hostingSpectator;
+		if (!hostingSpectator) {
+			spectatorLink.close();
+			cout << "Stopped hosting a spectator" << endl;
+		}
+		else if (spectatorLink.host(SPECTATOR_LINK)) {
+			// The spectator starts from nothing, with the sequence running on in case it stayed attached
+			replication.restart();
+			replicatedBytes = 0;
+			replicationReport = std::chrono::steady_clock::now();
+			cout << "Hosting a spectator on " << SPECTATOR_LINK << ", start one with --spectate" << endl;
+		}
+		else {
+			hostingSpectator = false;
+			cout << "Could not open the spectator link" << endl;
+		}
+	}
+
+	// Sends this tick to the spectator, the molecules nearest the player first
+	void replicate() {
+		if (!hostingSpectator)
+			return;
+		while (spectatorLink.receive(ack))
+			replication.acknowledge(ack);
+		glm::mat4 lasers[2] = { leftLaser.transform, rightLaser.transform };
+		bool red[2] = { leftLaser.model == redLaser, rightLaser.model == redLaser };
+		replicated.capture(particles, lasers, beamLength, red, co2Count, win, lose);
+		replication.write(replicated, headPosition, packet);
+		if (spectatorLink.send(packet))
+			replicatedBytes += packet.size();
+
+		auto now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(now - replicationReport).count();
+		if (seconds >= 5.0) {
+			printf("Spectator: %.1f KB/s, %u packets, %d sent and %d waiting last tick\n", replicatedBytes / 1024.0 / seconds,
+				replication.sequence(), (int)replication.sent(), (int)replication.waiting());
+			replicatedBytes = 0;
+			replicationReport = now;
+		}
+	}
+
+	// Prints what each loaded model costs: the molecules, the laser and the resident factories
+	// The drawn models have given their vertices up to the GPU, so the files are read again, on
+	// a worker so the headset doesn't stall, and printed together once all are analyzed
+	void reportMeshStats() {
+		vector<pair<string, string>> models = { { co2->getPath(), "co2" }, { o2->getPath(), "o2" }, { greenLaser->getPath(), "laser" } };
+		for (int v = 0; v < factories->count(); v++) {
+			if (factories->resident(v))
+				models.push_back({ factories->model(v)->getPath(), "factory" + to_string(v + 1) });
+		}
+		auto stats = std::make_shared<vector<ModelStats>>();
+		scheduler.async([models, stats] {
+			for (const pair<string, string>& model : models)
+				stats->push_back(analyzeModel(Model(model.first, false), model.second));
+		}, [stats] {
+			for (const ModelStats& model : *stats)
+				printStats(cout, model);
+		});
+	}
+
+	// CPU and GPU bytes of every model loaded, and the factory pool's
+	void reportMemory() {
+		co2->reportMemory(cout, "co2");
+		o2->reportMemory(cout, "o2");
+		greenLaser->reportMemory(cout, "green laser");
+		redLaser->reportMemory(cout, "red laser");
+		factories->reportMemory(cout);
+	}
+
+	glm::mat4 factoryTransform(const FactoryInstance& factory) const {
+		return glm::translate(glm::mat4(1.0f), factory.position) * factories->transform;
+	}
+
+	void renderSmoke(int eye, const mat4 & projection, const mat4 & modelview, GLuint depthTexture) {
+		auto start = std::chrono::steady_clock::now();
+		smoke->draw(eye, projection, modelview, depthTexture);
+		renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// Near molecules as ray-traced atom spheres or as their meshes
+	void toggleSpheres() {
+		// The next beginFrame refills the instances from detail that matches the particles
+		spheres->enabled = !spheres->enabled;
+		cout << "Molecules drawn as " << (spheres->enabled ? "atom spheres" : "meshes") << endl;
+	}
+
+	// Smoke at half resolution, then quarter, then none
+	void cycleSmoke() {
+		smoke->divisor = smoke->divisor == 2 ? 4 : smoke->divisor == 4 ? 0 : 2;
+		if (smoke->divisor)
+			cout << "Smoke at 1/" << smoke->divisor << " resolution" << endl;
+		else
+			cout << "Smoke off" << endl;
 	}
 
 	void render(const mat4 & projection, const mat4 & modelview, ovrSession session, glm::vec3 eyepos) {
+		auto renderStart = std::chrono::steady_clock::now();
 		getControllerData(session);
-		glUseProgram(shaderProg);
-
-		GLuint uProjection = glGetUniformLocation(shaderProg, "projection");
-		GLuint uModelview = glGetUniformLocation(shaderProg, "view");
+		// The lasers are lit, and stretched along the beam
+		GLuint shaderProg = useSceneShader(0, projection, modelview, eyepos);
 		GLuint uTransMat = glGetUniformLocation(shaderProg, "model");
-		GLuint uEyePos = glGetUniformLocation(shaderProg, "eyepos");
-
-		glUniformMatrix4fv(uProjection, 1, GL_FALSE, (&projection[0][0]));
-		glUniformMatrix4fv(uModelview, 1, GL_FALSE, &(modelview[0][0]));
-		glUniform3f(uEyePos, eyepos.x, eyepos.y, eyepos.z);
+		headPosition = eyepos;
+		headRight = glm::vec3(modelview[0][0], modelview[1][0], modelview[2][0]);
+		headForward = -glm::vec3(modelview[0][2], modelview[1][2], modelview[2][2]);
 
 		//LEFT HAND-----------------------------------------------------------
 		/*float yawy, pitchx, rollz;
 		OVR::Quatf leftori = handPoses[LEFT].Orientation;
 		leftori.GetEulerAngles<OVR::Axis_Y, OVR::Axis_X, OVR::Axis_Z>(&yawy, &pitchx, &rollz);*/
 
-		glm::quat q = ovr::toGlm(handPoses[LEFT].Orientation);
-		glm::mat4 rotmat = glm::toMat4(q);
-
-		glm::mat4 lasertransform;
-		lasertransform = glm::translate(lasertransform, glm::vec3(handPoses[LEFT].Position.x, handPoses[LEFT].Position.y, handPoses[LEFT].Position.z));
-		lasertransform = lasertransform * rotmat;
-		lasertransform = glm::scale(lasertransform, glm::vec3(0.01f, 0.01f, -20.f));
-		glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &lasertransform[0][0]);
+		glm::mat4 lasertransform = laserTransform(handPoses[LEFT]);
 		leftLaser.transform = lasertransform;
+		lasertransform = glm::scale(lasertransform, glm::vec3(1.0f, 1.0f, beamLength[LEFT]));
+		glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &lasertransform[0][0]);
 		leftLaser.model->Draw(shaderProg);
 
 
 		//RIGHT HAND----------------------------------------------------------
-		q = ovr::toGlm(handPoses[RIGHT].Orientation);
-		rotmat = glm::toMat4(q);
-
-		lasertransform = glm::mat4(1.0f);
-		lasertransform = glm::translate(lasertransform, glm::vec3(handPoses[RIGHT].Position.x, handPoses[RIGHT].Position.y, handPoses[RIGHT].Position.z));
-		lasertransform = lasertransform * rotmat;
-		lasertransform = glm::scale(lasertransform, glm::vec3(0.01f, 0.01f, -20.f));
-		glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &lasertransform[0][0]);
+		lasertransform = laserTransform(handPoses[RIGHT]);
 		rightLaser.transform = lasertransform;
+		lasertransform = glm::scale(lasertransform, glm::vec3(1.0f, 1.0f, beamLength[RIGHT]));
+		glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &lasertransform[0][0]);
 		rightLaser.model->Draw(shaderProg);
 
-		glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &factoryParticle.transform[0][0]);
-		factoryParticle.model->Draw(shaderProg);
+		// Factories and molecules are lit, and scaled evenly
+		shaderProg = useSceneShader(SHADER_UNIFORM_SCALE, projection, modelview, eyepos);
+		uTransMat = glGetUniformLocation(shaderProg, "model");
 
-		for (Particle* particle : particles) {
-			glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &(particle->transform[0][0]));
-			particle->model->Draw(shaderProg);
+		for (int c : world.activeCells) {
+			for (const FactoryInstance& factory : world.cells[c].factories) {
+				if (factory.shown < 0) continue;
+				glm::mat4 transform = factoryTransform(factory);
+				glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &transform[0][0]);
+				factories->model(factory.shown)->Draw(shaderProg);
+			}
 		}
-				
+
+		auto meshStart = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < particles.size(); i++) {
+			if (!drawnAsMesh(i)) continue;
+			// The spheres have every molecule the governor assigned; ones spawned since aren't in them
+			if (i < particleDetail.size() && spheres->draws(particles.kind[i])) continue;
+			glm::mat4 transform = particles.transform(i);
+			glUniformMatrix4fv(uTransMat, 1, GL_FALSE, &transform[0][0]);
+			(particles.kind[i] == PARTICLE_CO2 ? co2 : o2)->Draw(shaderProg);
+		}
+		spheres->draw(projection, modelview);
+		auto meshEnd = std::chrono::steady_clock::now();
+		meshSeconds += std::chrono::duration<double>(meshEnd - meshStart).count();
+		impostors->draw(projection, modelview);
+		auto simStart = std::chrono::steady_clock::now();
+		renderSeconds += std::chrono::duration<double>(simStart - renderStart).count();
 
 		update();
+		simSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - simStart).count();
 	} 
 
+	// Binds the variant of the scene shader with features, set up for the eye; returns the program
+	GLuint useSceneShader(unsigned features, const mat4 & projection, const mat4 & modelview, glm::vec3 eyepos) {
+		GLuint program = sceneShaders->get(features);
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, &projection[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, &modelview[0][0]);
+		glUniform3f(glGetUniformLocation(program, "eyepos"), eyepos.x, eyepos.y, eyepos.z);
+		return program;
+	}
+
+	// The laser model's transform for a controller pose: a thin cylinder 20 m down the controller's -z
+	glm::mat4 laserTransform(const ovrPosef& pose) const {
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(pose.Position.x, pose.Position.y, pose.Position.z));
+		transform = transform * glm::toMat4(ovr::toGlm(pose.Orientation));
+		return glm::scale(transform, glm::vec3(0.01f, 0.01f, -20.f));
+	}
+
+	// The beam as a ray segment. The cylinder model runs from z = 0 to 1 and the laser
+	// transform stretches it down the controller's -z axis, so t in [0, 1] covers the beam.
+	Ray laserRay(const glm::mat4& laserTransform) const {
+		Ray ray;
+		ray.origin = glm::vec3(laserTransform[3]);
+		ray.direction = glm::vec3(laserTransform[2]);
+		ray.tMax = 1.0f;
+		return ray;
+	}
+
+	// Stops both beams where they hit the factory
+	void blockBeams(Ray beams[2]) {
+		for (int hand = LEFT; hand <= RIGHT; hand++) {
+			SceneHit hit;
+			beams[hand].tMax = scene.intersect(beams[hand], INSTANCE_STATIC, hit) ? hit.t : 1.0f;
+		}
+	}
+
+	// Turns every CO2 molecule both beams pass through into O2
+	void convertHits(const Ray beams[2]) {
+		scene.intersectAll(beams[LEFT], INSTANCE_CO2, leftHits);
+		scene.intersectAll(beams[RIGHT], INSTANCE_CO2, rightHits);
+		for (const SceneHit& l : leftHits) {
+			for (const SceneHit& r : rightHits) {
+				int i = scene.instances[l.instance].id;
+				if (l.instance != r.instance || particles.kind[i] != PARTICLE_CO2) continue;
+
+				particles.kind[i] = PARTICLE_O2;
+				pulseVibration();
+				audio.play(sounds.convert, particles.position(i));
+				co2Count--;
+			}
+		}
+	}
+
 	void getControllerData(ovrSession session) {
 		
 		// Position + Orientation
@@ -796,63 +1494,80 @@ public:
 
 	void update() {
 
-		//Haptic feedback check
-		if (!fingerTriggerPressed[LEFT] || !fingerTriggerPressed[RIGHT] || (1000.0f * (std::clock() - vibTimer)) / CLOCKS_PER_SEC > 100.0f) {
-			ovr_SetControllerVibration(sesh, ovrControllerType_LTouch, 0.0f, 0.0f);
-			ovr_SetControllerVibration(sesh, ovrControllerType_RTouch, 0.0f, 0.0f);
+		audio.setListener(headPosition, headRight);
+
+		//Letting go of a trigger cuts a vibration pulse short
+		if (!fingerTriggerPressed[LEFT] || !fingerTriggerPressed[RIGHT]) {
+			stopVibration();
 		}
 
-		for (Particle* particle : particles) {
-			//Update position
-			particle->transform[3] += glm::vec4(particle->velocity.x, particle->velocity.y, particle->velocity.z , 0.0f);
-			particle->transform = glm::rotate(particle->transform, 0.05f, glm::vec3(particle->rotation.x, particle->rotation.y, particle->rotation.z));
-			//cout << particle->transform[3].z << endl;
-			//Check walls
-			if (particle->transform[3][0] < -10 || particle->transform[3][0] > 10) {
-				particle->velocity.x *= -1;
-			}
-			if (particle->transform[3][1] < -10 || particle->transform[3][1] > 10) {
-				particle->velocity.y *= -1;
-			}
-			if (particle->transform[3][2] < -25 || particle->transform[3][2] > -5) {
-				particle->velocity.z *= -1;
+		//Update positions, check walls and bounce off the factory
+		particles.integrate();
+		farParticles.integrate();
+		size_t factoryCount = 0;
+		for (int c : world.activeCells) {
+			for (const FactoryInstance& factory : world.cells[c].factories) {
+				if (factory.shown < 0) continue;
+				factories->field(factory.shown).collide(particles, particleRadius, factory.position);
+				factories->field(factory.shown).collide(farParticles, particleRadius, factory.position);
+				factoryCount++;
 			}
+		}
 
-			//If CO2 and intersected, change model to O2
-			if (particle->model == co2 && leftLaser.model == redLaser && rightLaser.model == redLaser) {
-				bool left = false;
-				bool right = false;
-
-				//Check left intersection
-				//Get two points on the line
-				glm::vec3 start = glm::vec3(leftLaser.transform[3].x, leftLaser.transform[3].y, leftLaser.transform[3].z);
-				glm::vec4 endToTrans = glm::vec4(0, 0, -1, 1);
-				endToTrans = leftLaser.transform * endToTrans;
-				glm::vec3 endPt = glm::vec3(endToTrans.x, endToTrans.y, endToTrans.z);
-				glm::vec3 particleCenter = glm::vec3(particle->transform[3]);
-				//Point-line dist
-				float dist = glm::length(glm::cross(endPt - start, start - particleCenter)) / glm::length(endPt - start);
-				if (dist <= 0.3f) left = true;
-
-				//Check right intersection
-				//Get two points on the line
-				start = glm::vec3(rightLaser.transform[3].x, rightLaser.transform[3].y, rightLaser.transform[3].z);
-				endToTrans = glm::vec4(0, 0, -1, 1);
-				endToTrans = rightLaser.transform * endToTrans;
-				endPt = glm::vec3(endToTrans.x, endToTrans.y, endToTrans.z);
-				//Point-line dist
-				dist = glm::length(glm::cross(endPt - start, start - particleCenter)) / glm::length(endPt - start);
-				if (dist <= 0.3f) right = true;
-
-				if (left && right) {
-					particle->model = o2;
-					ovr_SetControllerVibration(sesh, ovrControllerType_LTouch, 0.0f, 1.0f);
-					ovr_SetControllerVibration(sesh, ovrControllerType_RTouch, 0.0f, 1.0f);
-					vibTimer = std::clock();
-					co2Count--;
+		//Place the factories and every molecule the lasers can act on in the scene hierarchy.
+		//O2 not drawn as a mesh stays out, nothing traces it.
+		size_t tracedCount = 0;
+		for (size_t i = 0; i < particles.size(); i++) {
+			if (particles.kind[i] == PARTICLE_CO2 || drawnAsMesh(i)) tracedCount++;
+		}
+		scene.resize(factoryCount + tracedCount);
+		size_t instance = 0;
+		for (int c : world.activeCells) {
+			for (const FactoryInstance& factory : world.cells[c].factories) {
+				if (factory.shown < 0) continue;
+				scene.setInstance(instance++, factories->model(factory.shown), factoryTransform(factory), INSTANCE_STATIC, -1);
+			}
+		}
+		for (size_t i = 0; i < particles.size(); i++) {
+			bool isCo2 = particles.kind[i] == PARTICLE_CO2;
+			if (!isCo2 && !drawnAsMesh(i)) continue;
+			scene.setInstance(instance++, isCo2 ? co2 : o2, particles.transform(i), isCo2 ? INSTANCE_CO2 : INSTANCE_O2, (int)i);
+		}
+		scene.update();
+
+		//Stop the beams where they hit the factory
+		Ray beams[2] = { laserRay(leftLaser.transform), laserRay(rightLaser.transform) };
+		if (recordingInput) {
+			ReplayFrame frame;
+			for (int hand = LEFT; hand <= RIGHT; hand++) {
+				for (int a = 0; a < 3; a++) {
+					frame.origin[hand][a] = beams[hand].origin[a];
+					frame.direction[hand][a] = beams[hand].direction[a];
 				}
 			}
+			frame.trigger[LEFT] = leftLaser.model == redLaser;
+			frame.trigger[RIGHT] = rightLaser.model == redLaser;
+			recording.push_back(frame);
 		}
+		blockBeams(beams);
+		beamLength[LEFT] = beams[LEFT].tMax;
+		beamLength[RIGHT] = beams[RIGHT].tMax;
+
+		//If CO2 and hit by both lasers, change model to O2
+		if (leftLaser.model == redLaser && rightLaser.model == redLaser) {
+			convertHits(beams);
+		}
+
+		//Same for wherever the lasers were between frames, so a fast sweep doesn't skip molecules
+		inputSamples.clear();
+		input.since(lastInputTime, inputSamples);
+		for (const InputSample& sample : inputSamples) {
+			if (sample.indexTrigger[ovrHand_Left] <= 0.5f || sample.indexTrigger[ovrHand_Right] <= 0.5f) continue;
+			Ray swept[2] = { laserRay(laserTransform(sample.hands[ovrHand_Left])), laserRay(laserTransform(sample.hands[ovrHand_Right])) };
+			blockBeams(swept);
+			convertHits(swept);
+		}
+		if (!inputSamples.empty()) lastInputTime = inputSamples.back().time;
 
 		//If index trigger pressed, red laser
 		if (inputstate.IndexTrigger[ovrHand_Left] > 0.5f) {
@@ -869,39 +1584,29 @@ public:
 			rightLaser.model = greenLaser;
 		}
 		
-		//Add particles if haven't won and a second has passed
+		//Add particles from the emitters of nearby cells if haven't won
+		world.emit(spawns, farSpawns);
 		if (!win) {
-			std::clock_t currentTime = std::clock();
-			if ((currentTime - timer) / CLOCKS_PER_SEC >= 1) {
-				Particle* p = new Particle();
-				p->model = co2;
-				p->transform = glm::scale(chimney, glm::vec3(0.3f));
-				p->velocity = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.0f), fmod(rand(), 100.0f) - 50)) / 100.0f;
-				p->rotation = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50));
-				particles.push_back(p);
-
-				co2Count++;
-				timer = currentTime;
+			co2Count += (int)emitters.emitAt(chimneyEmitter, spawns, particles, random);
+			emitters.emitAt(chimneyEmitter, farSpawns, farParticles, random);
+			for (const glm::vec3& position : spawns) {
+				audio.play(sounds.spawn, position, 0.5f);
+			}
+			for (const glm::vec3& position : farSpawns) {
+				audio.play(sounds.spawn, position, 0.5f);
 			}
 		}
 
 		//Loss case
 		if (co2Count > 10 && !lose) {
-			for (int i = 0; i < 100; i++) {
-				Particle* p = new Particle();
-				p->model = co2;
-				p->transform = glm::translate(glm::vec3(fmod(rand(), 20) - 10, fmod(rand(), 20) - 10, fmod(rand(), 20) - 25));
-				p->transform = glm::scale(p->transform, glm::vec3(0.3f));
-				p->velocity = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.0f), fmod(rand(), 100.0f) - 50)) / 100.0f;
-				p->rotation = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50));
-				particles.push_back(p);
-			}
-
+			emitters.burst(smogEmitter, particles, random);
+			audio.play(sounds.lose);
 			lose = true;
 		}
 
 		//Win case
 		if (co2Count == 0 && !lose) {
+			if (!win) audio.play(sounds.win);
 			glClearColor(0.0f, 0.2f, 0.8f, 0.0f);
 			win = true;
 		}
@@ -910,19 +1615,15 @@ public:
 		if ((win || lose) && inputstate.Buttons != 0) {
 			win = false;
 			lose = false;
-			particles = std::vector<Particle*>();
-			for (int i = 0; i < 5; i++) {
-			Particle* p = new Particle();
-			p->model = co2;
-			p->transform = glm::scale(chimney, glm::vec3(0.3f));
-			p->velocity = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.0f), fmod(rand(), 100.0f) - 50)) / 100.0f;
-			p->rotation = glm::normalize(glm::vec3(fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50, fmod(rand(), 100.f) - 50));
-			particles.push_back(p);
-			}
-			co2Count = 5;
+			particles.clear();
+			farParticles.clear();
+			co2Count = (int)emitters.burst(chimneyEmitter, particles, random);
+			world.resetBudgets();
 
 			glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 		}
+
+		replicate();
 	}
 };
 
@@ -930,9 +1631,12 @@ public:
 // An example application that renders a simple cube
 class ExampleApp : public RiftApp {
 	std::shared_ptr<ColorCubeScene> cubeScene;
+	StartupAssets& assets;
+	// Open from the first update until that frame is out
+	std::unique_ptr<StartupTimeline::Phase> firstFrame;
 
 public:
-	ExampleApp() { }
+	ExampleApp(StartupAssets& assets) : assets(assets) { }
 
 protected:
 	void initGl() override {
@@ -940,30 +1644,557 @@ protected:
 		glClearColor(0.0f, 0.0f, 0.4f, 0.0f);
 		glEnable(GL_DEPTH_TEST);
 		ovr_RecenterTrackingOrigin(_session);
-		cubeScene = std::shared_ptr<ColorCubeScene>(new ColorCubeScene());
+		cubeScene = std::shared_ptr<ColorCubeScene>(new ColorCubeScene(_session, assets));
+	}
+
+	void finishFrame() override {
+		RiftApp::finishFrame();
+		if (firstFrame) {
+			firstFrame.reset();
+			startupTimeline().finish(std::cout, STARTUP_HISTORY);
+		}
 	}
 
 	void shutdownGl() override {
 		cubeScene.reset();
+		RiftApp::shutdownGl();
+	}
+
+	void onKey(int key, int scancode, int action, int mods) override {
+		// 1-4 pick the factory
+		if (GLFW_PRESS == action && key >= GLFW_KEY_1 && key <= GLFW_KEY_4) {
+			cubeScene->selectFactory(key - GLFW_KEY_1);
+			return;
+		}
+		// F8 starts and stops recording input for the headless sim
+		if (GLFW_PRESS == action && key == GLFW_KEY_F8) {
+			cubeScene->toggleRecording();
+			return;
+		}
+		// F7 prints the mesh statistics of the loaded models
+		if (GLFW_PRESS == action && key == GLFW_KEY_F7) {
+			cubeScene->reportMeshStats();
+			return;
+		}
+		// F9 prints the memory each model takes
+		if (GLFW_PRESS == action && key == GLFW_KEY_F9) {
+			cubeScene->reportMemory();
+			return;
+		}
+		// F11 steps the smoke through half resolution, quarter and off
+		if (GLFW_PRESS == action && key == GLFW_KEY_F11) {
+			cubeScene->cycleSmoke();
+			return;
+		}
+		// F12 switches near molecules between atom spheres and meshes
+		if (GLFW_PRESS == action && key == GLFW_KEY_F12) {
+			cubeScene->toggleSpheres();
+			return;
+		}
+		// F10 starts and stops hosting a spectator
+		if (GLFW_PRESS == action && key == GLFW_KEY_F10) {
+			cubeScene->toggleSpectator();
+			return;
+		}
+		// Backspace rewinds to the previous autosave
+		if (GLFW_PRESS == action && key == GLFW_KEY_BACKSPACE) {
+			cubeScene->rewind();
+			return;
+		}
+		RiftApp::onKey(key, scancode, action, mods);
+	}
+
+	void update() override {
+		if (frame == 1) {
+			firstFrame.reset(new StartupTimeline::Phase(startupTimeline(), "first frame"));
+		}
+		cubeScene->beginFrame();
 	}
 
 	void renderScene(const glm::mat4 & projection, const glm::mat4 & headPose, glm::vec3 eyepos) override {
 		cubeScene->render(projection, glm::inverse(headPose), _session, eyepos);
 	}
+
+	void renderEffects(int eye, const glm::mat4 & projection, const glm::mat4 & headPose, GLuint depthTexture) override {
+		cubeScene->renderSmoke(eye, projection, glm::inverse(headPose), depthTexture);
+	}
 };
 
+// Steps many games at once without a headset or window and reports how fast and how they went.
+// Arguments: [environments] [steps] [threads] [replay file]; without a replay the lasers are scripted.
+int runHeadless(const char* args) {
+	int environments = 256;
+	unsigned long long steps = BatchSim::TICK_RATE * 60;
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+	char replay[260] = "";
+	sscanf(args, "%d %llu %d %259s", &environments, &steps, &threads, replay);
+
+	ScriptedController scripted;
+	ReplayController replayed;
+	SimController* controller = &scripted;
+	if (replay[0]) {
+		if (!replayed.load(replay)) {
+			FAIL("Could not load replay");
+		}
+		controller = &replayed;
+	}
+
+	BatchSim sim(environments, threads, *controller);
+	sim.init("../Project1-assets");
+	sim.run(steps);
+
+	SimStats stats = sim.stats();
+	printf("%d environments x %llu steps on %d threads: %.2f s, %.0f steps/s\n", environments, steps, threads, stats.seconds, stats.steps / stats.seconds);
+	printf("%llu rounds, %llu won, %llu lost, %.1f s average round\n", (unsigned long long)stats.rounds, (unsigned long long)stats.wins, (unsigned long long)stats.losses,
+		stats.rounds ? double(stats.roundSteps) / stats.rounds / BatchSim::TICK_RATE : 0.0);
+	return 0;
+}
+
+// Plays the game's sounds around a listener standing still into a WAV file, without a headset or
+// sound card. Arguments: [output file] [seconds]
+int runAudioTest(const char* args) {
+	char path[260] = "audio-test.wav";
+	float seconds = 5.0f;
+	sscanf(args, "%259s %f", path, &seconds);
+
+	AudioMixer audio;
+	GameSounds sounds;
+	sounds.load(audio);
+	if (!audio.start(std::unique_ptr<AudioDevice>(new FileAudioDevice(path)))) {
+		FAIL("Could not open the audio output file");
+	}
+	audio.setListener(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+
+	// Spawns circling the head four times a second, conversions walking away from it, then a win
+	auto start = std::chrono::steady_clock::now();
+	int beats = (int)(seconds * 4);
+	for (int beat = 0; beat < beats; beat++) {
+		float angle = beat * 0.5f;
+		audio.play(sounds.spawn, glm::vec3(sinf(angle), 0.0f, -cosf(angle)) * 3.0f, 0.5f);
+		if (beat % 2 == 0)
+			audio.play(sounds.convert, glm::vec3(0.0f, 0.0f, -1.0f - (beat % 16)));
+		std::this_thread::sleep_until(start + std::chrono::milliseconds(250 * (beat + 1)));
+	}
+	audio.play(sounds.win);
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+
+	printf("Wrote %.1f s of audio to %s, %u commands dropped\n", seconds + 1.0f, path, audio.dropped());
+	audio.stop();
+	return 0;
+}
+
+// Finds every model under a directory
+static void findModels(const std::string& directory, std::vector<std::string>& paths) {
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((directory + "/*").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+		return;
+	do {
+		std::string name = found.cFileName;
+		if (name == "." || name == "..")
+			continue;
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			findModels(directory + "/" + name, paths);
+		else if (name.size() > 4 && name.compare(name.size() - 4, 4, ".obj") == 0)
+			paths.push_back(directory + "/" + name);
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+}
+
+// Prints the statistics of every model in the assets, without a headset or window, and fails if
+// any goes over the triangle budget. Arguments: [assets directory] [triangle budget]
+int runMeshStats(const char* args) {
+	char directory[260] = "../Project1-assets";
+	unsigned long long budget = MODEL_TRIANGLE_BUDGET;
+	sscanf(args, "%259s %llu", directory, &budget);
+
+	std::vector<std::string> paths;
+	findModels(directory, paths);
+	std::sort(paths.begin(), paths.end());
+	if (paths.empty()) {
+		FAIL("No models found");
+	}
+
+	int over = 0;
+	for (const std::string& path : paths) {
+		Model model(path, false);
+		if (printStats(std::cout, analyzeModel(model, path), (size_t)budget))
+			over++;
+	}
+	printf("%d models, %d over the budget of %llu triangles\n", (int)paths.size(), over, budget);
+	return over ? 1 : 0;
+}
+
+// Packs every model under the assets directory and the shaders into one archive, startup
+// assets first. Arguments: [assets directory] [archive] [compress, 1 or 0]
+int runCookAssets(const char* args) {
+	char directory[260] = "../Project1-assets";
+	char archivePath[260] = "assets.pak";
+	int compress = 1;
+	sscanf(args, "%259s %259s %d", directory, archivePath, &compress);
+
+	// Named by the paths the game loads them from, wherever they were cooked from
+	std::vector<std::string> paths;
+	findModels(directory, paths);
+	std::map<std::string, std::string> models;
+	for (const std::string& path : paths)
+		models[ASSETS + path.substr(strlen(directory))] = path;
+	if (models.empty()) {
+		FAIL("No models found");
+	}
+
+	ArchiveWriter writer;
+	auto cook = [&writer](const std::string& name, const std::string& path) {
+		Model model(path, false);
+		if (model.getMeshes().empty()) {
+			FAIL("Could not load " + path);
+		}
+		writer.add(name, model.cook());
+	};
+	for (const std::string& name : startupAssetPaths()) {
+		auto model = models.find(name);
+		if (model != models.end()) {
+			cook(name, model->second);
+			models.erase(model);
+		}
+		else if (name.compare(0, ASSETS.size(), ASSETS) == 0) {
+			FAIL("No model " + name + " under " + directory);
+		}
+		else if (!writer.addFile(name, name)) {
+			FAIL("Could not read " + name);
+		}
+	}
+	for (const auto& model : models)
+		cook(model.first, model.second);
+
+	if (!writer.write(archivePath, compress != 0)) {
+		FAIL(std::string("Could not write ") + archivePath);
+	}
+	std::ifstream written(archivePath, std::ios::binary | std::ios::ate);
+	printf("Cooked %d models and shaders, %.1f KB into %.1f KB%s\n", (int)writer.count(), writer.rawBytes() / 1024.0,
+		(double)written.tellg() / 1024.0, compress ? " with LZ4" : "");
+	return 0;
+}
+
+// Times reading and parsing the startup assets, serial and then on workers as the game
+// starts them, without a headset or window. Nothing is uploaded. Arguments: [runs] [--use-archive]
+int runStartupBench(const char* args) {
+	int runs = 5;
+	sscanf(args, "%d", &runs);
+	runs = std::max(1, runs);
+	AssetArchive archive;
+	if (strstr(args, "--use-archive") && archive.open(ASSET_ARCHIVE)) {
+		AssetArchive::mount(&archive);
+		printf("Reading from %s\n", ASSET_ARCHIVE.c_str());
+	}
+
+	auto median = [runs](bool parallel) {
+		std::vector<double> times;
+		for (int i = 0; i < runs; i++) {
+			auto start = std::chrono::steady_clock::now();
+			StartupAssets assets;
+			assets.start(parallel);
+			assets.shader.get();
+			assets.atomShader.get();
+			assets.impostorShader.get();
+			assets.smokeShader.get();
+			assets.smokeCompositeShader.get();
+			assets.co2.get();
+			assets.o2.get();
+			assets.greenLaser.get();
+			assets.redLaser.get();
+			assets.homeFactory.get();
+			times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	};
+	double serial = median(false);
+	double parallel = median(true);
+	printf("Startup assets, median of %d runs: %.1f ms serial, %.1f ms on workers\n", runs, serial, parallel);
+	return 0;
+}
+
+// Times every stage of loading each model in the assets, and two synthetic big ones, from
+// the files and from cooked archives, and writes the results as CSV. Uploads go to a hidden
+// window's context; without one they are left out. Arguments: [assets directory] [runs] [results file]
+int runAssetBench(const char* args) {
+	char directory[260] = "../Project1-assets";
+	int runs = 3;
+	char resultsPath[260] = "asset-bench.csv";
+	sscanf(args, "%259s %d %259s", directory, &runs, resultsPath);
+	runs = std::max(1, runs);
+
+	std::vector<std::string> paths;
+	findModels(directory, paths);
+	std::sort(paths.begin(), paths.end());
+	const size_t synthetic[] = { 100000, 1000000 };
+	std::vector<std::string> generated;
+	for (size_t triangles : synthetic) {
+		std::string path = "asset-bench-grid-" + to_string(triangles / 1000) + "k.obj";
+		if (writeSyntheticModel(path, triangles))
+			generated.push_back(path);
+	}
+	paths.insert(paths.end(), generated.begin(), generated.end());
+
+	GLFWwindow* window = nullptr;
+	if (glfwInit()) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		window = glfwCreateWindow(1, 1, "Asset benchmark", nullptr, nullptr);
+	}
+	if (window) {
+		glfwMakeContextCurrent(window);
+		glewExperimental = GL_TRUE;
+		if (0 != glewInit()) {
+			glfwDestroyWindow(window);
+			window = nullptr;
+		}
+		glGetError();
+	}
+	if (!window) {
+		std::cout << "No OpenGL context, uploads are not timed" << std::endl;
+	}
+
+	printf("Loading %d models %d times each from files and archives\n", (int)paths.size(), runs);
+	std::vector<AssetBenchResult> results = benchmarkAssets(paths, runs, window != nullptr);
+	printAssetBench(std::cout, results);
+	bool written = writeAssetBench(resultsPath, results);
+	if (written) {
+		printf("Results written to %s\n", resultsPath);
+	}
+
+	if (window) {
+		glfwDestroyWindow(window);
+	}
+	glfwTerminate();
+	for (const std::string& path : generated)
+		remove(path.c_str());
+	if (!written) {
+		FAIL(std::string("Could not write ") + resultsPath);
+	}
+	return 0;
+}
+
+// Frame times submitting from the GL thread and from the submit thread, as F6 switches between,
+// against a stand-in compositor that blocks each submit for a set time, without a headset.
+// Rendering is a clear of a hidden window. Arguments: [frames] [submit ms] [render ms] [other ms]
+int runSubmitBench(const char* args) {
+	int frames = 450;
+	float submitMs = 11.0f, renderMs = 5.0f, otherMs = 3.0f;
+	sscanf(args, "%d %f %f %f", &frames, &submitMs, &renderMs, &otherMs);
+	frames = std::max(1, frames);
+
+	if (!glfwInit()) {
+		FAIL("Failed to initialize GLFW");
+	}
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow* window = glfwCreateWindow(1, 1, "Submit benchmark", nullptr, nullptr);
+	GLFWwindow* shared = window ? glfwCreateWindow(1, 1, "Submit", nullptr, window) : nullptr;
+	if (shared) {
+		glfwMakeContextCurrent(window);
+		glewExperimental = GL_TRUE;
+		if (0 != glewInit()) {
+			glfwDestroyWindow(shared);
+			shared = nullptr;
+		}
+		glGetError();
+	}
+	if (!shared) {
+		if (window)
+			glfwDestroyWindow(window);
+		glfwTerminate();
+		FAIL("No OpenGL context");
+	}
+
+	printf("%d frames, submit blocks %.1f ms, render %.1f ms, other work %.1f ms\n", frames, submitMs, renderMs, otherMs);
+	printf("%8s %12s %12s\n", "submit", "frame ms", "blocked ms");
+	for (bool async : { false, true }) {
+		SubmitBenchResult r = benchmarkSubmit(shared, async, frames, submitMs, renderMs, otherMs);
+		printf("%8s %12.2f %12.2f\n", async ? "async" : "sync", r.frameMs, r.blockedMs);
+	}
+
+	glfwDestroyWindow(shared);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
+
+// Mirrors a game hosting a spectator (F10 there) without a headset or window, printing what
+// arrives each second. Arguments: [seconds], 0 to run until the host goes away
+int runSpectator(const char* args) {
+	float seconds = 0.0f;
+	sscanf(args, "%f", &seconds);
+
+	SharedMemoryLink link;
+	if (!link.join(SPECTATOR_LINK)) {
+		FAIL("No game is hosting a spectator; press F10 in one first");
+	}
+	ReplicationClient client;
+	std::vector<uint8_t> packet, ack;
+	size_t bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto report = start;
+	auto heard = start;
+	while (seconds <= 0.0f || std::chrono::steady_clock::now() - start < std::chrono::duration<float>(seconds)) {
+		while (link.receive(packet)) {
+			bytes += packet.size();
+			heard = std::chrono::steady_clock::now();
+			if (client.receive(packet, ack))
+				link.send(ack);
+		}
+		auto now = std::chrono::steady_clock::now();
+		if (now - heard > std::chrono::seconds(5)) {
+			printf("Nothing from the host for 5 s, stopping\n");
+			break;
+		}
+		if (now - report >= std::chrono::seconds(1)) {
+			const ReplicatedScene& scene = client.scene();
+			size_t known = 0;
+			for (size_t i = 0; i < scene.particles.size(); i++)
+				known += client.known(i);
+			printf("Packet %u: %d of %d molecules, %d CO2%s, %.1f KB/s\n", client.sequence(), (int)known, (int)scene.particles.size(),
+				scene.co2Count, scene.win ? ", won" : scene.lose ? ", lost" : "", bytes / 1024.0 / std::chrono::duration<double>(now - report).count());
+			bytes = 0;
+			report = now;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+	return 0;
+}
+
+// Bytes a tick it takes to keep a spectator in sync with 1k, 10k and 100k molecules, and how
+// far behind the budget leaves it. Arguments: [ticks] [budget bytes] [loss percent]
+int runReplicationBench(const char* args) {
+	int ticks = 600;
+	int budget = 8 * 1024;
+	float loss = 0.0f;
+	sscanf(args, "%d %d %f", &ticks, &budget, &loss);
+
+	printf("%d ticks, %d byte budget, %.0f%% loss\n", ticks, budget, loss);
+	printf("%10s %12s %12s %12s %12s %10s %10s\n", "molecules", "full bytes", "quantized", "bytes/tick", "sent/tick", "mean err", "max err");
+	const size_t sizes[] = { 1000, 10000, 100000 };
+	for (size_t particles : sizes) {
+		ReplicationBenchResult r = benchmarkReplication(particles, std::max(1, ticks), (size_t)std::max(64, budget), loss / 100.0f);
+		printf("%10d %12d %12d %12.0f %12.0f %10.3f %10.3f\n", (int)r.particles, (int)r.fullBytes, (int)r.quantizedBytes,
+			r.bytesPerTick, r.particlesPerTick, r.meanError, r.maxError);
+	}
+	return 0;
+}
+
 // Execute our example class
 int __stdcall WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
+	// Starts the clock for the startup timeline
+	startupTimeline();
 	AllocConsole();
 	freopen("conin$", "r", stdin);
 	freopen("conout$", "w", stdout);
 	freopen("conout$", "w", stderr);
 	int result = -1;
+	if (strncmp(lpCmdLine, "--headless", 10) == 0) {
+		try {
+			result = runHeadless(lpCmdLine + 10);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--audio-test", 12) == 0) {
+		try {
+			result = runAudioTest(lpCmdLine + 12);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--mesh-stats", 12) == 0) {
+		try {
+			result = runMeshStats(lpCmdLine + 12);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--cook-assets", 13) == 0) {
+		try {
+			result = runCookAssets(lpCmdLine + 13);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--asset-bench", 13) == 0) {
+		try {
+			result = runAssetBench(lpCmdLine + 13);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--startup-bench", 15) == 0) {
+		try {
+			result = runStartupBench(lpCmdLine + 15);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--submit-bench", 14) == 0) {
+		try {
+			result = runSubmitBench(lpCmdLine + 14);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--spectate", 10) == 0) {
+		try {
+			result = runSpectator(lpCmdLine + 10);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
+	if (strncmp(lpCmdLine, "--replication-bench", 19) == 0) {
+		try {
+			result = runReplicationBench(lpCmdLine + 19);
+		}
+		catch (std::exception & error) {
+			std::cerr << error.what() << std::endl;
+		}
+		return result;
+	}
 	try {
+		// The assets load on workers while LibOVR, the window and the swap chain come up here;
+		// those stay on the main thread, which owns the GL context and the session
+		StartupTimeline::Phase mapping(startupTimeline(), "map asset archive");
+		AssetArchive archive;
+		if (strstr(lpCmdLine, "--use-archive") && archive.open(ASSET_ARCHIVE)) {
+			AssetArchive::mount(&archive);
+			archive.prefetch(startupAssetPaths());
+		}
+		mapping.end();
+		StartupAssets assets;
+		assets.start(!strstr(lpCmdLine, "--serial-startup"));
+		StartupTimeline::Phase phase(startupTimeline(), "ovr_Initialize");
 		if (!OVR_SUCCESS(ovr_Initialize(nullptr))) {
 			FAIL("Failed to initialize the Oculus SDK");
 		}
-		result = ExampleApp().run();
+		phase.end();
+		result = ExampleApp(assets).run();
 	}
 	catch (std::exception & error) {
 		OutputDebugStringA(error.what());
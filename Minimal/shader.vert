@@ -6,9 +6,10 @@
 // called when the vertex shader gets run.
 // The vertex shader gets called once per vertex.
 
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
-layout (location = 2) in vec2 texCoords;
+// The vertex inputs (position, normal, texCoords) are declared by LoadShaders from VertexLayout<Vertex>.
+// Which of the features below are defined depends on the draw; see SceneShaderFeature in main.cpp.
+//   UNLIT          the material's color as it is, so no normal is passed on
+//   UNIFORM_SCALE  model scales the same along every axis, so it turns normals as it is
 
 // Uniform variables can be updated by fetching their location and passing values to that location
 uniform mat4 projection;
@@ -18,14 +19,21 @@ uniform mat4 model;
 // Outputs of the vertex shader are the inputs of the same name of the fragment shader.
 // The default output, gl_Position, should be assigned something. You can define as many
 // extra outputs as you need.
+#ifndef UNLIT
 out vec3 mynormal;
-out vec4 myvertex;
+out vec3 myvertex;
+#endif
 
 void main(){
-	mat4 modelview = view * model;
-
-    // OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
-    gl_Position = projection * modelview * vec4(position.x, position.y, position.z, 1.0);
-    myvertex = model * vec4(position, 1.0f);
+	vec4 world = model * vec4(position, 1.0);
+	// OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
+	gl_Position = projection * view * world;
+#ifndef UNLIT
+	myvertex = world.xyz;
+#ifdef UNIFORM_SCALE
+	mynormal = mat3(model) * normal;
+#else
 	mynormal = mat3(transpose(inverse(model))) * normal;
+#endif
+#endif
 }
@@ -0,0 +1,100 @@
+#version 330 core
+// Marches the chimney's plume for one pixel of the low resolution smoke target, stopping at
+// the scene, then blends in where that smoke was in last frame's target.
+
+in vec2 uv;
+
+out vec4 color;
+
+// Depth of the whole render target, and this eye's part of it in texels
+uniform sampler2D sceneDepth;
+uniform vec4 eyeRect;
+// Tiling noise the plume's density comes from, and last frame's smoke for this eye
+uniform sampler3D noise;
+uniform sampler2D history;
+
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform vec3 eye;
+
+// The plume: a cone widening up from base, inside the box
+uniform vec3 base;
+uniform float height;
+uniform float radius;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+uniform float density;
+uniform float noiseScale;
+// How far the noise has risen
+uniform float rise;
+uniform vec3 smokeColor;
+uniform vec3 lightDir;
+
+uniform int steps;
+// Where in each step this frame samples, so the history averages over the whole step
+uniform float jitter;
+// Share of the result taken from the history, 0 when there is none
+uniform float historyWeight;
+
+float plumeDensity(vec3 p) {
+	float h = (p.y - base.y) / height;
+	if (h < 0.0 || h > 1.0) return 0.0;
+	float r = radius * (0.25 + 0.75 * h);
+	float envelope = (1.0 - smoothstep(0.5 * r, r, length(p.xz - base.xz))) * (1.0 - h) * smoothstep(0.0, 0.05, h);
+	float n = texture(noise, (p - vec3(0.0, rise, 0.0)) * noiseScale).r;
+	return density * envelope * max(n * 1.6 - 0.4, 0.0);
+}
+
+void main(){
+	// The scene point behind this pixel; nothing drawn there puts it on the far plane
+	float depth = texelFetch(sceneDepth, ivec2(eyeRect.xy + uv * eyeRect.zw), 0).r;
+	vec4 scene = inverseViewProjection * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 ray = scene.xyz / scene.w - eye;
+	float sceneDistance = length(ray);
+	ray /= sceneDistance;
+
+	// Only the stretch of the ray inside the plume's box, in front of the scene, is marched
+	vec3 inverseRay = 1.0 / ray;
+	vec3 t0 = (boxMin - eye) * inverseRay;
+	vec3 t1 = (boxMax - eye) * inverseRay;
+	vec3 tNear = min(t0, t1);
+	vec3 tFar = max(t0, t1);
+	float enter = max(max(max(tNear.x, tNear.y), tNear.z), 0.0);
+	float exit = min(min(min(tFar.x, tFar.y), tFar.z), sceneDistance);
+
+	vec4 result = vec4(0.0);
+	vec3 centroid = eye + ray * sceneDistance;
+	if (exit > enter) {
+		// Neighbouring pixels start at different points of the step as well, by interleaved gradient noise
+		float offset = fract(jitter + fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715)))));
+		float dt = (exit - enter) / float(steps);
+		float transmittance = 1.0;
+		vec3 light = vec3(0.0);
+		vec3 weighted = vec3(0.0);
+		float weight = 0.0;
+		for (int i = 0; i < steps; i++) {
+			vec3 p = eye + ray * (enter + (float(i) + offset) * dt);
+			float sigma = plumeDensity(p);
+			if (sigma <= 0.0) continue;
+			// One sample toward the light stands in for the smoke shadowing itself
+			float shadow = exp(-0.5 * plumeDensity(p + lightDir * 0.5));
+			float absorbed = (1.0 - exp(-sigma * dt)) * transmittance;
+			light += absorbed * smokeColor * (0.35 + 0.65 * shadow);
+			weighted += absorbed * p;
+			weight += absorbed;
+			transmittance -= absorbed;
+			if (transmittance < 0.01) break;
+		}
+		result = vec4(light, 1.0 - transmittance);
+		centroid = weight > 0.0 ? weighted / weight : eye + ray * (0.5 * (enter + exit));
+	}
+
+	// Last frame saw the smoke's middle at another place on screen, since the head moved
+	if (historyWeight > 0.0) {
+		vec4 previous = previousViewProjection * vec4(centroid, 1.0);
+		vec2 previousUv = previous.xy / previous.w * 0.5 + 0.5;
+		if (previous.w > 0.0 && all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0))))
+			result = mix(result, texture(history, previousUv), historyWeight);
+	}
+	color = result;
+}
\ No newline at end of file
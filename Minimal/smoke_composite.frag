@@ -0,0 +1,44 @@
+#version 330 core
+// Blends the low resolution smoke over one eye. Each pixel takes the four smoke pixels around
+// it weighted by distance as usual, and also by how close the scene depth each was marched
+// against is to its own, so smoke stops at a molecule's edge instead of bleeding over it.
+
+in vec2 uv;
+
+out vec4 color;
+
+uniform sampler2D sceneDepth;
+uniform vec4 eyeRect;
+uniform sampler2D smoke;
+uniform vec2 smokeSize;
+// projection[3][2] and projection[2][2], which turn a depth back into distance from the eye
+uniform vec2 linearize;
+// Depth difference, as a fraction of the pixel's own distance, that halves a smoke pixel's weight
+uniform float depthTolerance;
+
+float distanceAt(vec2 at) {
+	float depth = texelFetch(sceneDepth, ivec2(eyeRect.xy + at * eyeRect.zw), 0).r;
+	return linearize.x / (depth * 2.0 - 1.0 + linearize.y);
+}
+
+void main(){
+	float own = distanceAt(uv);
+	vec2 position = uv * smokeSize - 0.5;
+	ivec2 corner = ivec2(floor(position));
+	vec2 f = position - vec2(corner);
+
+	vec4 sum = vec4(0.0);
+	float total = 0.0;
+	for (int k = 0; k < 4; k++) {
+		ivec2 offset = ivec2(k & 1, k >> 1);
+		ivec2 texel = clamp(corner + offset, ivec2(0), ivec2(smokeSize) - 1);
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		// The same scene sample the march stopped at for that smoke pixel
+		float marched = distanceAt((vec2(texel) + 0.5) / smokeSize);
+		float w = bilinear.x * bilinear.y * depthTolerance / (depthTolerance + abs(marched - own) / own) + 1e-4;
+		sum += w * texelFetch(smoke, texel, 0);
+		total += w;
+	}
+	// Premultiplied, for blending with ONE, ONE_MINUS_SRC_ALPHA
+	color = sum / total;
+}
\ No newline at end of file